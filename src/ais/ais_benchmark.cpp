@@ -0,0 +1,94 @@
+#include "ais_benchmark.h"
+#include "ais_manager.h"
+#include "ais_traffic_generator.h"
+#include "backgroundraster.h"
+#include "projectview.h"
+#include <QCoreApplication>
+#include <QTimer>
+#include <fstream>
+#include <unistd.h>
+
+AISBenchmark::AISBenchmark(AISManager* manager, ProjectView* view, int vessel_count, double seconds, QObject* parent):
+  QObject(parent), m_manager(manager), m_view(view), m_vessel_count(vessel_count), m_seconds(seconds)
+{
+  m_step_timer = new QTimer(this);
+  connect(m_step_timer, &QTimer::timeout, this, &AISBenchmark::step);
+  m_report_timer = new QTimer(this);
+  connect(m_report_timer, &QTimer::timeout, this, &AISBenchmark::report);
+}
+
+AISBenchmark::~AISBenchmark()
+{
+}
+
+void AISBenchmark::updateBackground(BackgroundRaster* bg)
+{
+  if(m_generator || !bg || !bg->valid())
+    return;
+
+  m_center = bg->pixelToGeo(bg->boundingRect().center());
+  m_radius = 0.4*std::min(bg->width(), bg->height())*bg->pixelSize();
+
+  ROS_INFO_STREAM("AIS benchmark: " << m_vessel_count << " vessels within " << m_radius << " m of " << m_center.latitude() << ", " << m_center.longitude() << " for " << m_seconds << " s");
+
+  m_manager->takeStatistics();
+  m_start_memory = residentMemory();
+  m_generator.reset(new AISTrafficGenerator(m_manager, m_vessel_count, m_center, m_radius));
+  m_generator->start();
+
+  m_elapsed.start();
+  m_report_elapsed.start();
+  m_step_timer->start(100);
+  m_report_timer->start(5000);
+}
+
+void AISBenchmark::step()
+{
+  double t = m_elapsed.elapsed()/1000.0;
+
+  // Circle the area once a minute at half its radius.
+  double angle = 2.0*M_PI*t/60.0;
+  m_view->centerMap(m_center.atDistanceAndAzimuth(m_radius/2.0, angle*180.0/M_PI));
+
+  // Zoom in four steps then back out, one step every two seconds.
+  int zoom_step = int(t/2.0);
+  while(m_zoom_step < zoom_step)
+  {
+    m_zoom_step++;
+    m_view->zoom((m_zoom_step/4)%2 ? 0.8 : 1.25);
+  }
+}
+
+void AISBenchmark::report()
+{
+  auto statistics = m_manager->takeStatistics();
+  double period = m_report_elapsed.restart()/1000.0;
+  uint64_t memory = residentMemory();
+
+  ROS_INFO_STREAM("AIS benchmark: " << statistics.reports/period << " reports/s, "
+    << m_generator->droppedCount() << " dropped in total, "
+    << statistics.contacts << " contacts, " << statistics.visible_contacts << " visible, "
+    << "ingest " << statistics.ingest_time/1.0e6/period << " ms/s, "
+    << "update " << statistics.update_time/1.0e6/period << " ms/s, "
+    << "projection " << statistics.projection_time/1.0e6/period << " ms/s and shapes " << statistics.shape_time/1.0e6/period << " ms/s, "
+    << "paint " << statistics.paint_time/1.0e6/period << " ms/s, "
+    << "memory " << memory/1048576.0 << " MB (" << (int64_t(memory)-int64_t(m_start_memory))/1048576.0 << " MB since start)");
+
+  if(m_elapsed.elapsed()/1000.0 >= m_seconds)
+  {
+    m_step_timer->stop();
+    m_report_timer->stop();
+    m_generator->stop();
+    ROS_INFO_STREAM("AIS benchmark done: " << m_generator->reportCount() << " reports generated, " << m_generator->droppedCount() << " dropped");
+    QCoreApplication::quit();
+  }
+}
+
+uint64_t AISBenchmark::residentMemory()
+{
+  std::ifstream statm("/proc/self/statm");
+  uint64_t size = 0, resident = 0;
+  if(statm >> size >> resident)
+    return resident*sysconf(_SC_PAGESIZE);
+  return 0;
+}
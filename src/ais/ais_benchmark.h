@@ -0,0 +1,57 @@
+#ifndef CAMP_AIS_BENCHMARK_H
+#define CAMP_AIS_BENCHMARK_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QGeoCoordinate>
+#include <memory>
+
+class AISManager;
+class AISTrafficGenerator;
+class BackgroundRaster;
+class ProjectView;
+class QTimer;
+
+// Drives AISManager with synthetic traffic while panning and zooming
+// the view, logging the time spent in each stage and the memory use
+// every few seconds. Starts once a background is loaded and quits the
+// application when done, so it can be run unattended, for example with
+// QT_QPA_PLATFORM=offscreen.
+class AISBenchmark: public QObject
+{
+  Q_OBJECT
+
+public:
+  AISBenchmark(AISManager* manager, ProjectView* view, int vessel_count, double seconds, QObject* parent = nullptr);
+  ~AISBenchmark();
+
+public slots:
+  void updateBackground(BackgroundRaster* bg);
+
+private slots:
+  // Moves the view along the scripted path.
+  void step();
+  void report();
+
+private:
+  // Resident set size in bytes.
+  static uint64_t residentMemory();
+
+  AISManager* m_manager;
+  ProjectView* m_view;
+  int m_vessel_count;
+  double m_seconds;
+
+  std::unique_ptr<AISTrafficGenerator> m_generator;
+  QGeoCoordinate m_center;
+  double m_radius = 0.0;
+
+  QTimer* m_step_timer;
+  QTimer* m_report_timer;
+  QElapsedTimer m_elapsed;
+  QElapsedTimer m_report_elapsed;
+  int m_zoom_step = 0;
+  uint64_t m_start_memory = 0;
+};
+
+#endif
@@ -1,47 +1,34 @@
 #include "ais_contact.h"
 #include "backgroundraster.h"
 #include <QPainter>
+#include <QElapsedTimer>
+#include <cmath>
+#include <cstring>
 #include <tf2/LinearMath/Quaternion.h>
 #include <tf2/LinearMath/Vector3.h>
 #include <tf2_geometry_msgs/tf2_geometry_msgs.h>
 #include <tf2/utils.h>
 
-AISContactDetails::AISContactDetails()
+AISContact::StageTimes AISContact::m_stage_times;
+
+AISReport::AISReport()
 {
 
 }
 
-AISContactDetails::AISContactDetails(const project11_msgs::Contact::ConstPtr& message)
+AISReport::AISReport(const project11_msgs::Contact::ConstPtr& message)
 {
   mmsi = message->mmsi;
-  name = message->name;
+  strncpy(name, message->name.c_str(), sizeof(name)-1);
+  name[sizeof(name)-1] = 0;
   dimension_to_bow = message->dimension_to_bow;
   dimension_to_port = message->dimension_to_port;
   dimension_to_stbd = message->dimension_to_stbd;
   dimension_to_stern = message->dimension_to_stern;
-}
-
-AISContactDetails::AISContactDetails(const marine_ais_msgs::AISContact::ConstPtr& message)
-{
-  mmsi = message->id;
-  name = message->static_info.name;
-  dimension_to_bow = message->static_info.reference_to_bow_distance;
-  dimension_to_port = message->static_info.reference_to_port_distance;
-  dimension_to_stbd = message->static_info.reference_to_starboard_distance;
-  dimension_to_stern = message->static_info.reference_to_stern_distance;
-}
-
-
-AISContactState::AISContactState()
-{
-
-}
 
-AISContactState::AISContactState(const project11_msgs::Contact::ConstPtr& message)
-{
   timestamp = message->header.stamp;
-  location.location.setLatitude(message->position.latitude);
-  location.location.setLongitude(message->position.longitude);
+  latitude = message->position.latitude;
+  longitude = message->position.longitude;
   if(message->heading < 0)
     if(message->sog > 0.25)
       heading = message->cog*180.0/M_PI;
@@ -51,17 +38,27 @@ AISContactState::AISContactState(const project11_msgs::Contact::ConstPtr& messag
     heading = message->heading*180.0/M_PI;
   cog = message->cog*180.0/M_PI;
   sog = message->sog;
+  synthetic = false;
 }
 
-AISContactState::AISContactState(const marine_ais_msgs::AISContact::ConstPtr& message)
+AISReport::AISReport(const marine_ais_msgs::AISContact::ConstPtr& message)
 {
+  mmsi = message->id;
+  strncpy(name, message->static_info.name.c_str(), sizeof(name)-1);
+  name[sizeof(name)-1] = 0;
+  dimension_to_bow = message->static_info.reference_to_bow_distance;
+  dimension_to_port = message->static_info.reference_to_port_distance;
+  dimension_to_stbd = message->static_info.reference_to_starboard_distance;
+  dimension_to_stern = message->static_info.reference_to_stern_distance;
+
   timestamp = message->header.stamp;
-  location.location.setLatitude(message->pose.position.latitude);
-  location.location.setLongitude(message->pose.position.longitude);
+  latitude = message->pose.position.latitude;
+  longitude = message->pose.position.longitude;
 
   tf2::Vector3 motion;
   tf2::fromMsg(message->twist.twist.linear, motion);
   sog = motion.length();
+  cog = 0.0;
   if (motion.length() > 0.0)
   {
     cog = -motion.angle(tf2::Vector3(0.0, 1.0, 0.0))*180/M_PI;
@@ -84,39 +81,50 @@ AISContactState::AISContactState(const marine_ais_msgs::AISContact::ConstPtr& me
     else
       heading = std::nan("");
   }
+  synthetic = false;
 }
 
-AISReport::AISReport(QObject *parent):QObject(parent)
+AISContactDetails::AISContactDetails()
 {
 
 }
 
-AISReport::AISReport(const project11_msgs::Contact::ConstPtr& message, QObject *parent):
-  QObject(parent),
-  AISContactDetails(message),
-  AISContactState(message)
+AISContactDetails::AISContactDetails(const AISReport& report)
 {
-
+  mmsi = report.mmsi;
+  name = report.name;
+  dimension_to_bow = report.dimension_to_bow;
+  dimension_to_port = report.dimension_to_port;
+  dimension_to_stbd = report.dimension_to_stbd;
+  dimension_to_stern = report.dimension_to_stern;
 }
 
-AISReport::AISReport(const marine_ais_msgs::AISContact::ConstPtr& message, QObject *parent):
-  QObject(parent),
-  AISContactDetails(message),
-  AISContactState(message)
+AISContactState::AISContactState()
 {
 
 }
 
+AISContactState::AISContactState(const AISReport& report)
+{
+  timestamp = report.timestamp;
+  location.location.setLatitude(report.latitude);
+  location.location.setLongitude(report.longitude);
+  heading = report.heading;
+  cog = report.cog;
+  sog = report.sog;
+}
+
 
-AISContact::AISContact(QObject *parent, QGraphicsItem *parentItem):QObject(parent), ShipTrack(parentItem)
+AISContact::AISContact(QObject *parent, QGraphicsItem *parentItem):QObject(parent), ShipTrack(parentItem), m_states(1000)
 {
   setAcceptHoverEvents(true);
 }
 
-AISContact::AISContact(AISReport* report, QObject *parent, QGraphicsItem *parentItem):
+AISContact::AISContact(const AISReport& report, QObject *parent, QGraphicsItem *parentItem):
   QObject(parent),
   ShipTrack(parentItem),
-  AISContactDetails(*report)
+  AISContactDetails(report),
+  m_states(1000)
 {
   setAcceptHoverEvents(true);
 }
@@ -126,44 +134,152 @@ AISContact::~AISContact()
 
 }
 
+void AISContact::setHistoryRetention(double seconds, std::size_t max_reports)
+{
+  m_history_seconds = seconds;
+  if(max_reports != m_states.capacity())
+  {
+    m_states.setCapacity(max_reports);
+    rebuildTrackPath();
+  }
+}
+
 void AISContact::updateView()
 {
+  if(m_replay)
+    return;
   prepareGeometryChange();
   m_displayTime = ros::Time::now();
+
+  ros::Time history_start = m_displayTime - ros::Duration(std::min(m_history_seconds, m_displayTime.toSec()));
+  while(!m_states.empty() && m_states.front().timestamp < history_start)
+  {
+    m_states.pop_front();
+    m_stale_track_points++;
+  }
+  if(m_stale_track_points > m_states.size()/4)
+    rebuildTrackPath();
+
+  QElapsedTimer timer;
+  timer.start();
+  updateShapes();
+  m_stage_times.shapes += timer.nsecsElapsed();
   update();
 }
 
-void AISContact::newReport(AISReport *report)
+void AISContact::newReport(const AISReport& report)
 {
-  mmsi = report->mmsi;
-  if (!report->name.empty())
-    name = report->name;
+  mmsi = report.mmsi;
+  if (report.name[0] != 0)
+    name = report.name;
+
+  if(dimension_to_bow != report.dimension_to_bow || dimension_to_port != report.dimension_to_port || dimension_to_stbd != report.dimension_to_stbd || dimension_to_stern != report.dimension_to_stern)
+    m_ship_shape_valid = false;
+  dimension_to_bow = report.dimension_to_bow;
+  dimension_to_port = report.dimension_to_port;
+  dimension_to_stbd = report.dimension_to_stbd;
+  dimension_to_stern = report.dimension_to_stern;
+
+  // History is kept in time order, so repeated reports replace the
+  // latest. Late ones, for example from a receiver relaying slower
+  // than another, only change the track.
+  if(!m_states.empty() && report.timestamp < m_states.back().timestamp)
+  {
+    insertLateReport(report);
+    return;
+  }
+  bool replace = !m_states.empty() && report.timestamp == m_states.back().timestamp;
+  if(replace)
+    m_states.back() = report;
+  else
+  {
+    if(m_states.full())
+      m_stale_track_points++;
+    m_states.push_back(report);
+  }
+  m_ship_shape_valid = false;
 
-  dimension_to_bow = report->dimension_to_bow;
-  dimension_to_port = report->dimension_to_port;
-  dimension_to_stbd = report->dimension_to_stbd;
-  dimension_to_stern = report->dimension_to_stern;
-  m_states[report->timestamp] = *report;
+  AISContactState& state = m_states.back();
   BackgroundRaster* bg = findParentBackgroundRaster();
   if(bg)
   {
-    m_states[report->timestamp].location.pos = geoToPixel(report->location.location, bg);
-    setLabelPosition(m_states[report->timestamp].location.pos);
+    QElapsedTimer timer;
+    timer.start();
+    state.location.pos = geoToPixel(state.location.location, bg);
+    m_stage_times.projection += timer.nsecsElapsed();
+    // The label follows the replayed track until back to live.
+    if(!m_replay)
+      setLabelPosition(state.location.pos);
+    if(replace)
+      rebuildTrackPath();
+    else if(m_track_path.elementCount() == 0)
+      m_track_path.moveTo(state.location.pos);
+    else
+      m_track_path.lineTo(state.location.pos);
   }
 }
 
-void AISContact::updateLabel()
+void AISContact::insertLateReport(const AISReport& report)
 {
-  QString label;
-  if(!name.empty())
-    label = name.c_str();
+  // Late reports are usually only a little late, so search from the
+  // newest.
+  std::size_t i = m_states.size()-1;
+  while(i > 0 && m_states[i-1].timestamp >= report.timestamp)
+    i--;
+  AISContactState state(report);
+  BackgroundRaster* bg = findParentBackgroundRaster();
+  if(bg)
+  {
+    QElapsedTimer timer;
+    timer.start();
+    state.location.pos = geoToPixel(state.location.location, bg);
+    m_stage_times.projection += timer.nsecsElapsed();
+  }
+  if(m_states[i].timestamp == report.timestamp)
+    m_states[i] = state;
   else
-    label = QString::number(mmsi);
+    m_states.insert(i, state);
+  rebuildTrackPath();
+}
+
+QPointF AISContact::position() const
+{
+  if(m_states.empty())
+    return QPointF();
+  return m_states.back().location.pos;
+}
+
+const AISContactState* AISContact::latestState() const
+{
+  if(m_states.empty())
+    return nullptr;
+  return &m_states.back();
+}
+
+QString AISContact::displayName() const
+{
+  if(!name.empty())
+    return name.c_str();
+  return QString::number(mmsi);
+}
+
+void AISContact::setCollisionRisk(bool risk)
+{
+  if(risk != m_collision_risk)
+  {
+    m_collision_risk = risk;
+    update();
+  }
+}
+
+void AISContact::updateLabel()
+{
+  QString label = displayName();
 
   if(!m_states.empty())
   {
-    label += "\nsog: " + QString::number(int(m_states.rbegin()->second.sog*10)/10.0) + " m/s";
-    label += "\ncog: " + QString::number(int(m_states.rbegin()->second.cog));
+    label += "\nsog: " + QString::number(int(m_states.back().sog*10)/10.0) + " m/s";
+    label += "\ncog: " + QString::number(int(m_states.back().cog));
   }
   setLabel(label);
 }
@@ -173,19 +289,155 @@ void AISContact::updateLabel()
 void AISContact::updateProjectedPoints()
 {
   BackgroundRaster* bg = dynamic_cast<BackgroundRaster*>(parentItem());
-  for (auto& s: m_states)
-    s.second.location.pos = geoToPixel(s.second.location.location, bg);
+  QElapsedTimer timer;
+  timer.start();
+  for (std::size_t i = 0; i < m_states.size(); i++)
+    m_states[i].location.pos = geoToPixel(m_states[i].location.location, bg);
+  m_stage_times.projection += timer.nsecsElapsed();
   if (!m_states.empty())
-    setLabelPosition(m_states.rbegin()->second.location.pos);
+    setLabelPosition(m_states.back().location.pos);
+  rebuildTrackPath();
+  m_ship_shape_valid = false;
+}
+
+void AISContact::rebuildTrackPath()
+{
+  m_track_path = QPainterPath();
+  m_stale_track_points = 0;
+  if(!findParentBackgroundRaster())
+    return;
+  QElapsedTimer timer;
+  timer.start();
+  for(std::size_t i = 0; i < m_states.size(); i++)
+    if(i == 0)
+      m_track_path.moveTo(m_states[i].location.pos);
+    else
+      m_track_path.lineTo(m_states[i].location.pos);
+  m_stage_times.shapes += timer.nsecsElapsed();
+}
+
+void AISContact::drawShip(QPainterPath &path, BackgroundRaster* bg, QTransform const &frame, double heading) const
+{
+  bool forceTriangle = false;
+  if (dimension_to_bow + dimension_to_stern == 0 || dimension_to_port + dimension_to_stbd == 0)
+    forceTriangle = true;
+  float max_size = std::max(dimension_to_bow + dimension_to_stern, dimension_to_port + dimension_to_stbd);
+  qreal pixel_size = bg->scaledPixelSize();
+  if(pixel_size > max_size/10.0 || forceTriangle)
+    drawTriangle(path, frame, heading, pixel_size);
+  else
+    drawShipOutline(path, frame, heading, dimension_to_bow, dimension_to_port, dimension_to_stbd, dimension_to_stern);
+}
+
+void AISContact::updateShapes()
+{
+  m_shape = QPainterPath();
+  m_prediction_shape = QPainterPath();
+  BackgroundRaster* bg = findParentBackgroundRaster();
+  if(m_displayTime.isZero() || m_states.empty() || !bg)
+  {
+    m_bounding_rect = QRectF();
+    return;
+  }
+
+  const AISContactState& state = m_states.back();
+  QTransform frame = localFrame(bg, state.location.location, state.location.pos);
+
+  if(!m_ship_shape_valid || m_ship_shape_pixel_size != bg->scaledPixelSize())
+  {
+    m_ship_shape = QPainterPath();
+    drawShip(m_ship_shape, bg, frame, state.heading);
+    m_ship_shape_pixel_size = bg->scaledPixelSize();
+    m_ship_shape_valid = true;
+  }
+  m_shape = m_track_path;
+  m_shape.addPath(m_ship_shape);
+
+  // Dead reckoned in meters east and north of the report.
+  QPointF velocity;
+  if(!std::isnan(state.sog) && !std::isnan(state.cog))
+    velocity = QPointF(state.sog*sin(state.cog*M_PI/180.0), state.sog*cos(state.cog*M_PI/180.0));
+  m_prediction_shape.moveTo(state.location.pos);
+  m_prediction_shape.lineTo(frame.map(velocity*300));
+  ros::Duration timeSinceReport = m_displayTime - state.timestamp;
+  QPointF predicatedLocation = velocity*timeSinceReport.toSec();
+  QTransform predicted_frame = frame;
+  predicted_frame.translate(predicatedLocation.x(), predicatedLocation.y());
+  drawShip(m_prediction_shape, bg, predicted_frame, state.heading);
+
+  m_bounding_rect = (m_shape.boundingRect()|m_prediction_shape.boundingRect()).marginsAdded(QMargins(2,2,2,2));
+}
+
+void AISContact::showHistory(const std::vector<HistoryStore::State>& track)
+{
+  prepareGeometryChange();
+  m_replay = true;
+  m_shape = QPainterPath();
+  m_prediction_shape = QPainterPath();
+  m_bounding_rect = QRectF();
+
+  BackgroundRaster* bg = findParentBackgroundRaster();
+  if(!track.empty() && bg)
+  {
+    // The whole track is projected in one call, latitudes in x and
+    // longitudes in y. Only used on the GUI thread, so the arrays are
+    // shared by all contacts.
+    static std::vector<double> x, y;
+    x.resize(track.size());
+    y.resize(track.size());
+    for(std::size_t i = 0; i < track.size(); i++)
+    {
+      x[i] = track[i].latitude;
+      y[i] = track[i].longitude;
+    }
+    QElapsedTimer timer;
+    timer.start();
+    bg->geoToPixel(track.size(), x.data(), y.data());
+    m_stage_times.projection += timer.nsecsElapsed();
+    QPointF offset = parentItem() ? parentItem()->scenePos() : QPointF();
+
+    QPointF position;
+    for(std::size_t i = 0; i < track.size(); i++)
+    {
+      position = QPointF(x[i], y[i]) - offset;
+      if(i == 0)
+        m_shape.moveTo(position);
+      else
+        m_shape.lineTo(position);
+    }
+    const auto& state = track.back();
+    drawShip(m_shape, bg, localFrame(bg, QGeoCoordinate(state.latitude, state.longitude), position), state.heading);
+    m_bounding_rect = m_shape.boundingRect().marginsAdded(QMargins(2,2,2,2));
+    setLabelPosition(position);
+  }
+  update();
+}
+
+void AISContact::showLive()
+{
+  if(!m_replay)
+    return;
+  m_replay = false;
+  m_ship_shape_valid = false;
+  if(!m_states.empty())
+    setLabelPosition(m_states.back().location.pos);
+  updateView();
+}
+
+const RingBuffer<AISContactState>& AISContact::states() const
+{
+  return m_states;
 }
 
 QRectF AISContact::boundingRect() const
 {
-  return (shape().boundingRect()|predictionShape().boundingRect()).marginsAdded(QMargins(2,2,2,2));
+  return m_bounding_rect;
 }
 
 void AISContact::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget)
 {
+  QElapsedTimer timer;
+  timer.start();
   painter->save();
 
   QPen p;
@@ -193,95 +445,38 @@ void AISContact::paint(QPainter* painter, const QStyleOptionGraphicsItem* option
   //p.setColor(Qt::blue);
   p.setColor(QColor(.2*255,.2*255,255,.7*255));
   p.setWidth(2);
+  if(m_collision_risk)
+  {
+    p.setColor(QColor(255,0,0,230));
+    p.setWidth(4);
+  }
   painter->setPen(p);
-  painter->drawPath(shape());
+  painter->drawPath(m_shape);
 
   p.setColor(QColor(128, 128, 128, 128));
   
   painter->setPen(p);
-  painter->drawPath(predictionShape());
+  painter->drawPath(m_prediction_shape);
 
   painter->restore();
+  m_stage_times.paint += timer.nsecsElapsed();
 }
 
-QPainterPath AISContact::shape() const
+AISContact::StageTimes AISContact::takeStageTimes()
 {
-  QPainterPath ret;
-  // History length should be configurable and displayTime could be set
-  // somwhere else to support rewinding time
-  if(!m_displayTime.isZero())
-  {
-    ros::Time historyStartTime = m_displayTime - ros::Duration(300);
-
-    auto state = m_states.lower_bound(historyStartTime);
-    if(state != m_states.end() && state->first <= m_displayTime)
-    {
-      ret.moveTo(state->second.location.pos);
-      auto nextState = state;
-      nextState++;
-      while(nextState != m_states.end())
-      {
-        if(nextState->first <= m_displayTime)
-        {
-          state = nextState;
-          nextState++;
-          ret.lineTo(state->second.location.pos);
-        }
-        else
-          break;
-      }
-
-      BackgroundRaster* bg = findParentBackgroundRaster();
-      if(bg)
-      {
-        bool forceTriangle = false;
-        if (dimension_to_bow + dimension_to_stern == 0 || dimension_to_port + dimension_to_stbd == 0)
-          forceTriangle = true;
-        float max_size = std::max(dimension_to_bow + dimension_to_stern, dimension_to_port + dimension_to_stbd);
-        qreal pixel_size = bg->scaledPixelSize();
-        if(pixel_size > max_size/10.0 || forceTriangle)
-          drawTriangle(ret, bg, state->second.location.location, state->second.heading, pixel_size);
-        else
-          drawShipOutline(ret, bg, state->second.location.location, state->second.heading, dimension_to_bow, dimension_to_port, dimension_to_stbd, dimension_to_stern);      
-      }
-
-    }
-  }
+  StageTimes ret = m_stage_times;
+  m_stage_times = StageTimes();
   return ret;
 }
 
+QPainterPath AISContact::shape() const
+{
+  return m_shape;
+}
+
 QPainterPath AISContact::predictionShape() const
 {
-  QPainterPath ret;
-  if(!m_displayTime.isZero())
-  {
-    auto state = m_states.rbegin();
-    while(state != m_states.rend() && state->first > m_displayTime)
-      state++;
-    if(state != m_states.rend())
-    {
-      ret.moveTo(state->second.location.pos);
-      QGeoCoordinate futureLocation = state->second.location.location.atDistanceAndAzimuth(state->second.sog*300, state->second.cog);
-      ros::Duration timeSinceReport = m_displayTime - state->first;
-      QGeoCoordinate predicatedLocation = state->second.location.location.atDistanceAndAzimuth(state->second.sog*timeSinceReport.toSec(), state->second.cog);
-      BackgroundRaster* bg = findParentBackgroundRaster();
-      if(bg)
-      {
-        ret.lineTo(geoToPixel(futureLocation, bg));
-
-        bool forceTriangle = false;
-        if (dimension_to_bow + dimension_to_stern == 0 || dimension_to_port + dimension_to_stbd == 0)
-          forceTriangle = true;
-        float max_size = std::max(dimension_to_bow + dimension_to_stern, dimension_to_port + dimension_to_stbd);
-        qreal pixel_size = bg->scaledPixelSize();
-        if(pixel_size > max_size/10.0 || forceTriangle)
-          drawTriangle(ret, bg, predicatedLocation, state->second.heading, pixel_size);
-        else
-          drawShipOutline(ret, bg, predicatedLocation, state->second.heading, dimension_to_bow, dimension_to_port, dimension_to_stbd, dimension_to_stern);      
-      }
-    }
-  }
-  return ret;
+  return m_prediction_shape;
 }
 
 void AISContact::hoverEnterEvent(QGraphicsSceneHoverEvent* event)
@@ -6,12 +6,38 @@
 #include "project11_msgs/Contact.h"
 #include "marine_ais_msgs/AISContact.h"
 #include "locationposition.h"
+#include "ring_buffer.h"
+#include "history_store.h"
+
+// Compact copy of an incoming report. Trivially copyable so ROS
+// callbacks can queue it for the GUI thread without allocating.
+struct AISReport
+{
+  AISReport();
+  AISReport(const project11_msgs::Contact::ConstPtr& message);
+  AISReport(const marine_ais_msgs::AISContact::ConstPtr& message);
+  uint32_t mmsi;
+  // AIS names are at most 20 characters.
+  char name[21];
+  float dimension_to_stbd;
+  float dimension_to_port;
+  float dimension_to_bow;
+  float dimension_to_stern;
+  ros::Time timestamp;
+  double latitude;
+  double longitude;
+  double heading;
+  float cog;
+  float sog;
+  // Made up by AISTrafficGenerator, so kept out of anything that
+  // outlives the run.
+  bool synthetic;
+};
 
 struct AISContactDetails
 {
   AISContactDetails();
-  AISContactDetails(const project11_msgs::Contact::ConstPtr& message);
-  AISContactDetails(const marine_ais_msgs::AISContact::ConstPtr& message);
+  AISContactDetails(const AISReport& report);
   uint32_t mmsi;
   std::string name;
   float dimension_to_stbd; 
@@ -23,8 +49,7 @@ struct AISContactDetails
 struct AISContactState
 {
   AISContactState();
-  AISContactState(const project11_msgs::Contact::ConstPtr& message);
-  AISContactState(const marine_ais_msgs::AISContact::ConstPtr& message);
+  AISContactState(const AISReport& report);
   ros::Time timestamp;
   LocationPosition location;
   double heading;
@@ -32,15 +57,6 @@ struct AISContactState
   float sog;
 };
 
-struct AISReport: public QObject, AISContactDetails, AISContactState
-{
-  Q_OBJECT
-public:
-  AISReport(QObject *parent = nullptr);
-  AISReport(const project11_msgs::Contact::ConstPtr& message, QObject *parent = nullptr);
-  AISReport(const marine_ais_msgs::AISContact::ConstPtr& message, QObject *parent = nullptr);
-};
-
 
 class AISContact: public QObject, public ShipTrack, AISContactDetails
 {
@@ -48,7 +64,7 @@ class AISContact: public QObject, public ShipTrack, AISContactDetails
 
 public:
   AISContact(QObject* parent = nullptr, QGraphicsItem *parentItem = nullptr);
-  AISContact(AISReport* report, QObject* parent = nullptr, QGraphicsItem *parentItem = nullptr);
+  AISContact(const AISReport& report, QObject* parent = nullptr, QGraphicsItem *parentItem = nullptr);
   ~AISContact();
 
   int type() const override {return AISContactType;}
@@ -58,7 +74,44 @@ public:
   QPainterPath shape() const override;
   QPainterPath predictionShape() const;
 
-  void newReport(AISReport* report);
+  void newReport(const AISReport& report);
+
+  // Projected position of the latest report.
+  QPointF position() const;
+
+  // Latest report, or nullptr if there are none.
+  const AISContactState* latestState() const;
+
+  // Name if known, otherwise the MMSI.
+  QString displayName() const;
+
+  // Highlights the contact when it's a collision risk.
+  void setCollisionRisk(bool risk);
+
+  // Reports older than seconds before the display time, or beyond
+  // max_reports, are dropped.
+  void setHistoryRetention(double seconds, std::size_t max_reports);
+
+  // Shows the contact at the last state of track, with the track
+  // leading up to it, instead of its live history. An empty track
+  // hides the contact.
+  void showHistory(const std::vector<HistoryStore::State>& track);
+  // Returns to showing the live history.
+  void showLive();
+
+  const RingBuffer<AISContactState>& states() const;
+
+  // Nanoseconds all contacts have spent on each stage since the last
+  // call.
+  struct StageTimes
+  {
+    // Converting positions to background pixels.
+    int64_t projection = 0;
+    // Building the track, ship and prediction paths.
+    int64_t shapes = 0;
+    int64_t paint = 0;
+  };
+  static StageTimes takeStageTimes();
 
 public slots:
   void updateProjectedPoints();
@@ -70,9 +123,40 @@ protected:
 
 private:
   void updateLabel();
+  // Puts a report older than the latest in its place in the history.
+  void insertLateReport(const AISReport& report);
+  void rebuildTrackPath();
+  void updateShapes();
+  // Draws the ship at the frame's origin using the current dimensions.
+  void drawShip(QPainterPath &path, BackgroundRaster* bg, QTransform const &frame, double heading) const;
   
-  std::map<ros::Time, AISContactState> m_states;
+  RingBuffer<AISContactState> m_states;
+  double m_history_seconds = 300.0;
   ros::Time m_displayTime;
+
+  // Line through the retained reports, extended as reports arrive.
+  // Points dropped from the history stay in it until enough accumulate
+  // to make rebuilding it worthwhile.
+  QPainterPath m_track_path;
+  std::size_t m_stale_track_points = 0;
+
+  // Ship drawn at the latest report, redrawn when a report arrives
+  // or the scale changes.
+  QPainterPath m_ship_shape;
+  qreal m_ship_shape_pixel_size = 0.0;
+  bool m_ship_shape_valid = false;
+
+  // Built by updateView and reused by paint, shape and boundingRect.
+  QPainterPath m_shape;
+  QPainterPath m_prediction_shape;
+  QRectF m_bounding_rect;
+
+  bool m_collision_risk = false;
+
+  // Showing a track from the history store rather than m_states.
+  bool m_replay = false;
+
+  static StageTimes m_stage_times;
 };
 
 #endif
\ No newline at end of file
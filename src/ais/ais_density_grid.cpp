@@ -0,0 +1,269 @@
+#include "ais_density_grid.h"
+#include "ros/ros.h"
+#include <QDataStream>
+#include <QFile>
+#include <QSaveFile>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+
+const quint32 file_magic = 0x4344454e; // "CDEN"
+const quint32 file_version = 1;
+
+// Web Mercator stops short of the poles.
+const double max_latitude = 85.0511287798;
+
+const int cell_count = AISDensityGrid::tile_size*AISDensityGrid::tile_size;
+
+} // namespace
+
+const int AISDensityGrid::tile_size;
+
+AISDensityGrid::AISDensityGrid(int max_level)
+{
+  m_max_level = std::max(0, std::min(max_level, 20));
+  m_levels.resize(m_max_level+1);
+  m_max_counts.resize(m_max_level+1, 0);
+}
+
+AISDensityGrid::AISDensityGrid(const AISDensityGrid& other)
+{
+  *this = other;
+}
+
+AISDensityGrid& AISDensityGrid::operator=(const AISDensityGrid& other)
+{
+  m_max_level = other.m_max_level;
+  m_levels = other.m_levels;
+  m_max_counts = other.m_max_counts;
+  m_dirty = other.m_dirty;
+  m_report_count = other.m_report_count;
+  // Points into other's tiles.
+  m_last_tile = nullptr;
+  return *this;
+}
+
+int AISDensityGrid::maxLevel() const
+{
+  return m_max_level;
+}
+
+uint64_t AISDensityGrid::key(int x, int y)
+{
+  return (uint64_t(uint32_t(x)) << 32) | uint32_t(y);
+}
+
+int AISDensityGrid::keyX(uint64_t key)
+{
+  return int(key >> 32);
+}
+
+int AISDensityGrid::keyY(uint64_t key)
+{
+  return int(key & 0xffffffff);
+}
+
+QPointF AISDensityGrid::mercator(double latitude, double longitude)
+{
+  double phi = std::max(-max_latitude, std::min(max_latitude, latitude))*M_PI/180.0;
+  double x = (longitude + 180.0)/360.0;
+  double y = (1.0 - std::log(std::tan(phi) + 1.0/std::cos(phi))/M_PI)/2.0;
+  return QPointF(x - std::floor(x), std::max(0.0, std::min(y, 1.0)));
+}
+
+QGeoCoordinate AISDensityGrid::unmercator(QPointF point)
+{
+  double latitude = std::atan(std::sinh(M_PI*(1.0 - 2.0*point.y())))*180.0/M_PI;
+  return QGeoCoordinate(latitude, point.x()*360.0 - 180.0);
+}
+
+void AISDensityGrid::add(double latitude, double longitude)
+{
+  if(std::isnan(latitude) || std::isnan(longitude) || std::fabs(latitude) > 90.0 || std::fabs(longitude) > 180.0)
+    return;
+
+  QPointF p = mercator(latitude, longitude);
+  int64_t cells = int64_t(tile_size) << m_max_level;
+  int64_t column = std::min(int64_t(p.x()*cells), cells-1);
+  int64_t row = std::min(int64_t(p.y()*cells), cells-1);
+
+  uint64_t k = key(column/tile_size, row/tile_size);
+  if(!m_last_tile || k != m_last_key)
+  {
+    m_last_tile = &m_levels[m_max_level][k];
+    m_last_key = k;
+    if(m_last_tile->counts.empty())
+      m_last_tile->counts.fill(0, cell_count);
+  }
+
+  uint32_t& count = m_last_tile->counts[(row%tile_size)*tile_size + column%tile_size];
+  count++;
+  m_last_tile->max_count = std::max(m_last_tile->max_count, count);
+  m_last_tile->version++;
+  m_max_counts[m_max_level] = std::max(m_max_counts[m_max_level], count);
+  m_dirty.insert(k);
+  m_report_count++;
+}
+
+void AISDensityGrid::clear()
+{
+  for(auto& level: m_levels)
+    level.clear();
+  std::fill(m_max_counts.begin(), m_max_counts.end(), 0);
+  m_dirty.clear();
+  m_report_count = 0;
+  m_last_tile = nullptr;
+}
+
+bool AISDensityGrid::updatePyramid()
+{
+  if(m_dirty.empty())
+    return false;
+
+  std::unordered_set<uint64_t> dirty;
+  dirty.swap(m_dirty);
+  for(int level = m_max_level-1; level >= 0; level--)
+  {
+    std::unordered_set<uint64_t> parents;
+    for(auto k: dirty)
+      parents.insert(key(keyX(k)/2, keyY(k)/2));
+    for(auto k: parents)
+      rebuild(level, keyX(k), keyY(k));
+    dirty.swap(parents);
+  }
+  return true;
+}
+
+bool AISDensityGrid::changed() const
+{
+  return !m_dirty.empty();
+}
+
+AISDensityGrid AISDensityGrid::takeSnapshot()
+{
+  AISDensityGrid snapshot(*this);
+  m_dirty.clear();
+  return snapshot;
+}
+
+void AISDensityGrid::takePyramid(AISDensityGrid snapshot)
+{
+  if(snapshot.m_max_level != m_max_level)
+    return;
+  for(int level = 0; level < m_max_level; level++)
+  {
+    m_levels[level].swap(snapshot.m_levels[level]);
+    m_max_counts[level] = snapshot.m_max_counts[level];
+  }
+}
+
+void AISDensityGrid::rebuild(int level, int x, int y)
+{
+  Tile& parent = m_levels[level][key(x, y)];
+  parent.counts.fill(0, cell_count);
+  const int half = tile_size/2;
+  for(int dy = 0; dy < 2; dy++)
+    for(int dx = 0; dx < 2; dx++)
+    {
+      const Tile* child = tile(level+1, 2*x+dx, 2*y+dy);
+      if(!child)
+        continue;
+      for(int row = 0; row < tile_size; row++)
+      {
+        const uint32_t* in = &child->counts[row*tile_size];
+        uint32_t* out = &parent.counts[(dy*half + row/2)*tile_size + dx*half];
+        for(int column = 0; column < half; column++)
+          out[column] += in[2*column] + in[2*column+1];
+      }
+    }
+  parent.max_count = *std::max_element(parent.counts.constBegin(), parent.counts.constEnd());
+  parent.version++;
+  m_max_counts[level] = std::max(m_max_counts[level], parent.max_count);
+}
+
+const AISDensityGrid::Tile* AISDensityGrid::tile(int level, int x, int y) const
+{
+  if(level < 0 || level > m_max_level)
+    return nullptr;
+  auto t = m_levels[level].find(key(x, y));
+  if(t == m_levels[level].end())
+    return nullptr;
+  return &t->second;
+}
+
+uint32_t AISDensityGrid::maxCount(int level) const
+{
+  if(level < 0 || level > m_max_level)
+    return 0;
+  return m_max_counts[level];
+}
+
+uint64_t AISDensityGrid::reportCount() const
+{
+  return m_report_count;
+}
+
+bool AISDensityGrid::save(QString path) const
+{
+  QSaveFile file(path);
+  if(!file.open(QIODevice::WriteOnly))
+  {
+    ROS_WARN_STREAM("Unable to save AIS density grid " << path.toStdString() << ": " << file.errorString().toStdString());
+    return false;
+  }
+
+  QDataStream out(&file);
+  const auto& tiles = m_levels[m_max_level];
+  out << file_magic << file_version << quint32(m_max_level) << quint64(m_report_count) << quint32(tiles.size());
+  for(const auto& t: tiles)
+  {
+    // Counts are stored in host byte order.
+    QByteArray counts = qCompress(reinterpret_cast<const uchar*>(t.second.counts.data()), cell_count*sizeof(uint32_t));
+    out << quint32(keyX(t.first)) << quint32(keyY(t.first)) << counts;
+  }
+  return file.commit();
+}
+
+bool AISDensityGrid::load(QString path)
+{
+  QFile file(path);
+  if(!file.open(QIODevice::ReadOnly))
+    return false;
+
+  QDataStream in(&file);
+  quint32 magic = 0;
+  quint32 version = 0;
+  quint32 max_level = 0;
+  quint64 report_count = 0;
+  quint32 tile_count = 0;
+  in >> magic >> version >> max_level >> report_count >> tile_count;
+  if(magic != file_magic || version != file_version || max_level > 20)
+  {
+    ROS_WARN_STREAM(path.toStdString() << " is not an AIS density grid");
+    return false;
+  }
+
+  *this = AISDensityGrid(max_level);
+  for(quint32 i = 0; i < tile_count && in.status() == QDataStream::Ok; i++)
+  {
+    quint32 x, y;
+    QByteArray counts;
+    in >> x >> y >> counts;
+    counts = qUncompress(counts);
+    if(counts.size() != int(cell_count*sizeof(uint32_t)))
+      continue;
+    Tile& t = m_levels[m_max_level][key(x, y)];
+    t.counts.resize(cell_count);
+    memcpy(t.counts.data(), counts.constData(), counts.size());
+    t.max_count = *std::max_element(t.counts.constBegin(), t.counts.constEnd());
+    t.version = 1;
+    m_max_counts[m_max_level] = std::max(m_max_counts[m_max_level], t.max_count);
+    m_dirty.insert(key(x, y));
+  }
+  m_report_count = report_count;
+  updatePyramid();
+  return in.status() == QDataStream::Ok;
+}
@@ -0,0 +1,100 @@
+#ifndef CAMP_AIS_DENSITY_GRID_H
+#define CAMP_AIS_DENSITY_GRID_H
+
+#include <QGeoCoordinate>
+#include <QPointF>
+#include <QString>
+#include <QVector>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Counts AIS reports per cell of a Web Mercator grid, to show where
+// traffic goes without keeping the reports themselves.
+//
+// Cells are laid out like slippy map tiles: at level n the world is
+// 2^n by 2^n tiles of tile_size by tile_size cells. Reports are only
+// binned into the finest level, which costs a hash lookup and an
+// increment. The coarser levels of the pyramid are rebuilt from the
+// tiles that changed when updatePyramid() is called.
+//
+// Tile counts are implicitly shared, so copies are cheap and only the
+// tiles one side then changes get copied. That lets the pyramid be
+// rebuilt and the grid saved from a snapshot on another thread while
+// reports keep being added to the original.
+class AISDensityGrid
+{
+public:
+  static const int tile_size = 256;
+
+  struct Tile
+  {
+    QVector<uint32_t> counts;
+    // Bumped each time the counts change.
+    uint32_t version = 0;
+    uint32_t max_count = 0;
+  };
+
+  explicit AISDensityGrid(int max_level = 12);
+  AISDensityGrid(const AISDensityGrid& other);
+  AISDensityGrid& operator=(const AISDensityGrid& other);
+
+  // Level of the finest tiles.
+  int maxLevel() const;
+
+  void add(double latitude, double longitude);
+  void clear();
+
+  // Rebuilds the coarser tiles covering finest tiles changed since the
+  // last call. Returns false if none changed.
+  bool updatePyramid();
+
+  // True if tiles changed since the pyramid was last updated.
+  bool changed() const;
+
+  // Copy that takes over the tiles changed so far. Once its pyramid
+  // is updated, takePyramid brings the result back. Only the finest
+  // level may change in between.
+  AISDensityGrid takeSnapshot();
+  void takePyramid(AISDensityGrid snapshot);
+
+  // Returns nullptr where no reports were binned.
+  const Tile* tile(int level, int x, int y) const;
+
+  // Highest cell count in the level.
+  uint32_t maxCount(int level) const;
+
+  uint64_t reportCount() const;
+
+  // Saves the finest level, the pyramid is rebuilt on load. If the
+  // file was saved with a different finest level, that level is used.
+  bool save(QString path) const;
+  bool load(QString path);
+
+  // Position in the world as a fraction from the north west corner.
+  static QPointF mercator(double latitude, double longitude);
+  static QGeoCoordinate unmercator(QPointF point);
+
+private:
+  static uint64_t key(int x, int y);
+  static int keyX(uint64_t key);
+  static int keyY(uint64_t key);
+
+  // Sums the four child tiles into a tile of level.
+  void rebuild(int level, int x, int y);
+
+  int m_max_level;
+  // Tiles by key for each level.
+  std::vector<std::unordered_map<uint64_t, Tile> > m_levels;
+  std::vector<uint32_t> m_max_counts;
+  // Finest tiles changed since the last pyramid update.
+  std::unordered_set<uint64_t> m_dirty;
+  uint64_t m_report_count = 0;
+
+  // Consecutive reports usually land in the same tile. Elements of an
+  // unordered_map stay put when it grows.
+  Tile* m_last_tile = nullptr;
+  uint64_t m_last_key = 0;
+};
+
+#endif
@@ -0,0 +1,152 @@
+#include "ais_density_layer.h"
+#include "backgroundraster.h"
+#include "geographicsitem.h"
+#include <QPainter>
+#include <QStyleOptionGraphicsItem>
+#include <cmath>
+
+namespace
+{
+
+// Color stops for the lookup table, from the quietest cells to the
+// busiest.
+const QColor color_stops[] = {QColor(0, 0, 255, 64), QColor(0, 255, 255, 128), QColor(255, 255, 0, 192), QColor(255, 0, 0, 224)};
+
+// Tiles drawn per side before giving up, in case the view is far
+// larger than the background.
+const int max_tiles_per_side = 32;
+
+// Tile images kept, 64 kB each.
+const std::size_t max_cached_tiles = 256;
+
+// Color table entries. Index 0 is for empty cells.
+const int color_count = 256;
+
+} // namespace
+
+AISDensityLayer::AISDensityLayer(const AISDensityGrid* grid, BackgroundRaster* background):
+  QGraphicsItem(background), m_grid(grid), m_background(background)
+{
+  setFlag(QGraphicsItem::ItemUsesExtendedStyleOption);
+  // Under the contacts.
+  setZValue(-1);
+
+  const int stop_count = sizeof(color_stops)/sizeof(color_stops[0]);
+  m_color_table.append(qRgba(0, 0, 0, 0));
+  for(int i = 1; i < color_count; i++)
+  {
+    double position = (i-1)*(stop_count-1)/double(color_count-2);
+    int stop = std::min(int(position), stop_count-2);
+    double t = position - stop;
+    const QColor& a = color_stops[stop];
+    const QColor& b = color_stops[stop+1];
+    m_color_table.append(qRgba(a.red()+(b.red()-a.red())*t, a.green()+(b.green()-a.green())*t, a.blue()+(b.blue()-a.blue())*t, a.alpha()+(b.alpha()-a.alpha())*t));
+  }
+}
+
+int AISDensityLayer::type() const
+{
+  return GeoGraphicsItem::AISDensityType;
+}
+
+void AISDensityLayer::setBackground(BackgroundRaster* background)
+{
+  prepareGeometryChange();
+  m_background = background;
+  setParentItem(background);
+}
+
+QRectF AISDensityLayer::boundingRect() const
+{
+  if(!m_background)
+    return QRectF();
+  return m_background->boundingRect();
+}
+
+bool AISDensityLayer::tileTransform(int level, int x, int y, QTransform& transform) const
+{
+  double tile_count = std::ldexp(1.0, level);
+  QPolygonF corners;
+  for(auto corner: {QPointF(x, y), QPointF(x+1, y), QPointF(x+1, y+1), QPointF(x, y+1)})
+    corners << m_background->geoToPixel(AISDensityGrid::unmercator(corner/tile_count));
+  int size = AISDensityGrid::tile_size;
+  return QTransform::quadToQuad(QPolygonF(QRectF(0, 0, size, size)), corners, transform);
+}
+
+const QImage& AISDensityLayer::tileImage(int level, int x, int y, const AISDensityGrid::Tile& tile)
+{
+  uint32_t max_count = m_grid->maxCount(level);
+  auto& cached = m_cache[std::make_tuple(level, x, y)];
+  if(!cached.image.isNull() && cached.version == tile.version && cached.max_count == max_count)
+    return cached.image;
+
+  int size = AISDensityGrid::tile_size;
+  if(cached.image.isNull())
+  {
+    cached.image = QImage(size, size, QImage::Format_Indexed8);
+    cached.image.setColorTable(m_color_table);
+  }
+  double scale = (color_count-2)/std::log1p(double(std::max<uint32_t>(max_count, 1)));
+  for(int row = 0; row < size; row++)
+  {
+    uchar* line = cached.image.scanLine(row);
+    const uint32_t* counts = &tile.counts[row*size];
+    for(int column = 0; column < size; column++)
+      line[column] = counts[column] ? 1 + int(std::log1p(double(counts[column]))*scale) : 0;
+  }
+  cached.version = tile.version;
+  cached.max_count = max_count;
+  return cached.image;
+}
+
+void AISDensityLayer::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget)
+{
+  if(!m_background)
+    return;
+
+  // Extent of the exposed area in the grid.
+  QRectF exposed = option->exposedRect.intersected(boundingRect());
+  if(exposed.isEmpty())
+    return;
+  QRectF area;
+  for(auto corner: {exposed.topLeft(), exposed.topRight(), exposed.bottomLeft(), exposed.bottomRight(), exposed.center()})
+  {
+    QGeoCoordinate position = m_background->pixelToGeo(corner);
+    QPointF p = AISDensityGrid::mercator(position.latitude(), position.longitude());
+    area = area.isNull() ? QRectF(p, QSizeF()) : area.united(QRectF(p, QSizeF()));
+  }
+
+  // Cells about two screen pixels wide.
+  double scale = std::sqrt(std::fabs(painter->worldTransform().determinant()));
+  double screen_width = exposed.width()*scale;
+  int level = m_grid->maxLevel();
+  if(area.width() > 0.0)
+    level = std::floor(std::log2(screen_width/(2.0*AISDensityGrid::tile_size*area.width())));
+  level = std::max(0, std::min(level, m_grid->maxLevel()));
+
+  int tile_count = 1 << level;
+  int left = std::max(0, int(area.left()*tile_count));
+  int right = std::min(tile_count-1, int(area.right()*tile_count));
+  int top = std::max(0, int(area.top()*tile_count));
+  int bottom = std::min(tile_count-1, int(area.bottom()*tile_count));
+  if(right-left >= max_tiles_per_side || bottom-top >= max_tiles_per_side)
+    return;
+
+  // Drop the images that aren't used when panning leaves them behind.
+  if(m_cache.size() > max_cached_tiles)
+    m_cache.clear();
+
+  painter->save();
+  QTransform base = painter->transform();
+  for(int y = top; y <= bottom; y++)
+    for(int x = left; x <= right; x++)
+    {
+      auto tile = m_grid->tile(level, x, y);
+      QTransform transform;
+      if(!tile || !tileTransform(level, x, y, transform))
+        continue;
+      painter->setTransform(transform*base);
+      painter->drawImage(0, 0, tileImage(level, x, y, *tile));
+    }
+  painter->restore();
+}
@@ -0,0 +1,48 @@
+#ifndef CAMP_AIS_DENSITY_LAYER_H
+#define CAMP_AIS_DENSITY_LAYER_H
+
+#include <QGraphicsItem>
+#include <QImage>
+#include <map>
+#include <tuple>
+#include "ais_density_grid.h"
+
+class BackgroundRaster;
+
+// Draws an AISDensityGrid over the background, picking the pyramid
+// level whose cells are about two screen pixels wide. Counts are shown
+// on a log scale relative to the busiest cell of the level and
+// colorized through a lookup table into indexed tile images, which are
+// cached until the tile or the level's maximum changes.
+class AISDensityLayer: public QGraphicsItem
+{
+public:
+  AISDensityLayer(const AISDensityGrid* grid, BackgroundRaster* background);
+
+  int type() const override;
+
+  QRectF boundingRect() const override;
+  void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget) override;
+
+  void setBackground(BackgroundRaster* background);
+
+private:
+  struct CachedTile
+  {
+    uint32_t version = 0;
+    uint32_t max_count = 0;
+    QImage image;
+  };
+
+  const QImage& tileImage(int level, int x, int y, const AISDensityGrid::Tile& tile);
+
+  // Maps a tile image's pixels onto the background.
+  bool tileTransform(int level, int x, int y, QTransform& transform) const;
+
+  const AISDensityGrid* m_grid;
+  BackgroundRaster* m_background = nullptr;
+  QVector<QRgb> m_color_table;
+  std::map<std::tuple<int, int, int>, CachedTile> m_cache;
+};
+
+#endif
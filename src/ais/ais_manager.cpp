@@ -1,26 +1,76 @@
 #include "ais_manager.h"
 #include "ui_ais_manager.h"
+#include "ais_density_layer.h"
+#include "geofence.h"
+#include <QDir>
+#include <QFileInfo>
+#include <QStandardPaths>
 #include <QTimer>
+#include <QtConcurrent>
+#include <algorithm>
 #include "backgroundraster.h"
+#include "platform_manager/platform_manager.h"
+#include "platform_manager/platform.h"
+#include <QElapsedTimer>
+#include <cstring>
 
 AISManager::AISManager(QWidget* parent):
   QWidget(parent),
-  m_ui(new Ui::AISManager)
+  m_ui(new Ui::AISManager),
+  m_report_queue(16384),
+  m_journal(65536),
+  m_display_time(std::nan("")),
+  m_density(ros::param::param<int>("~ais_density_max_level", 12))
 {
   m_ui->setupUi(this);
+  m_report_batch.reserve(m_report_queue.capacity());
 
-  connect(this, &AISManager::newAisReport, this, &AISManager::addAisReport, Qt::QueuedConnection);
+  m_history_seconds = ros::param::param<double>("~ais_history_seconds", 300.0);
+  m_history_max_reports = ros::param::param<int>("~ais_history_max_reports", 1000);
+  openJournal();
 
   m_scan_timer = new QTimer(this);
   connect(m_scan_timer, &QTimer::timeout, this, &AISManager::scanForSources);
   m_scan_timer->start(1000);
 
   m_update_timer = new QTimer(this);
+  connect(m_update_timer, &QTimer::timeout, this, &AISManager::updateVisibleContacts);
   m_update_timer->start(200);
+
+  // Reports are applied in one batch per display frame.
+  m_process_timer = new QTimer(this);
+  connect(m_process_timer, &QTimer::timeout, this, &AISManager::processReports);
+  m_process_timer->start(50);
+
+  m_replay_timer = new QTimer(this);
+  m_replay_timer->setSingleShot(true);
+  m_replay_timer->setInterval(100);
+  connect(m_replay_timer, &QTimer::timeout, this, &AISManager::updateReplay);
+
+  m_collision_risk_engine.setThresholds(ros::param::param<double>("~collision_cpa_meters", 500.0), ros::param::param<double>("~collision_tcpa_seconds", 600.0));
+  m_collision_timer = new QTimer(this);
+  connect(m_collision_timer, &QTimer::timeout, this, &AISManager::updateCollisionRisk);
+  m_collision_timer->start(1000);
+
+  m_density_path = ros::param::param<std::string>("~ais_density_file", (QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)+"/ais_density.grid").toStdString()).c_str();
+  if(!m_density_path.isEmpty() && m_density.load(m_density_path))
+    ROS_INFO_STREAM("Loaded AIS density of " << m_density.reportCount() << " reports from " << m_density_path.toStdString());
+  m_density_save_timer.start();
+  m_density_timer = new QTimer(this);
+  connect(m_density_timer, &QTimer::timeout, this, &AISManager::updateDensity);
+  connect(&m_density_watcher, &QFutureWatcher<AISDensityGrid>::finished, this, &AISManager::densityUpdated);
+  m_density_timer->start(1000);
+  connect(m_ui->densityCheckBox, &QCheckBox::toggled, this, &AISManager::showDensity);
 }
 
 AISManager::~AISManager()
 {
+  m_density_watcher.waitForFinished();
+  if(!m_density_path.isEmpty())
+  {
+    QDir().mkpath(QFileInfo(m_density_path).path());
+    m_density.save(m_density_path);
+  }
   delete m_ui;
 }
 
@@ -36,9 +86,9 @@ void AISManager::scanForSources()
       if (m_sources.find(t.name) == m_sources.end())
       {
         if(t.datatype == "project11_msgs/Contact")
-          m_sources[t.name] = nh.subscribe(t.name, 10, &AISManager::contactCallback, this);
+          m_sources[t.name] = nh.subscribe(t.name, 1000, &AISManager::contactCallback, this);
         else
-          m_sources[t.name] = nh.subscribe(t.name, 10, &AISManager::aisContactCallback, this);
+          m_sources[t.name] = nh.subscribe(t.name, 1000, &AISManager::aisContactCallback, this);
         m_ui->sourcesListWidget->addItem(t.name.c_str());
       }
 
@@ -49,9 +99,7 @@ void AISManager::contactCallback(const project11_msgs::Contact::ConstPtr& messag
     if(message->position.latitude > 90 || message->position.longitude > 180)
         return;
 
-    AISReport* r = new AISReport(message);
-    emit newAisReport(r);
-    r->deleteLater();
+    queueReport(AISReport(message));
 }
 
 void AISManager::aisContactCallback(const marine_ais_msgs::AISContact::ConstPtr& message)
@@ -59,30 +107,402 @@ void AISManager::aisContactCallback(const marine_ais_msgs::AISContact::ConstPtr&
   if(isnan(message->pose.position.latitude) || isnan(message->pose.position.longitude))
     return;
 
-  AISReport* r = new AISReport(message);
-    emit newAisReport(r);
-    r->deleteLater();
+  queueReport(AISReport(message));
+}
+
+bool AISManager::queueReport(const AISReport& report)
+{
+  if(m_report_queue.push(report))
+    return true;
+  m_dropped_reports++;
+  ROS_WARN_STREAM_THROTTLE(5.0, "AIS report queue full, " << m_dropped_reports << " reports dropped");
+  return false;
+}
+
+
+void AISManager::processReports()
+{
+  QElapsedTimer timer;
+  timer.start();
+
+  m_report_batch.clear();
+  AISReport report;
+  while(m_report_batch.size() < m_report_queue.capacity() && m_report_queue.pop(report))
+    m_report_batch.push_back(report);
+  if(m_report_batch.empty())
+    return;
+
+  // Generated traffic would come back as real contacts on the next
+  // start.
+  if(m_journal.isOpen())
+    for(const auto& r: m_report_batch)
+    {
+      if(r.synthetic)
+        continue;
+      track_journal::Record record;
+      record.stamp_ns = r.timestamp.toNSec();
+      record.latitude = r.latitude;
+      record.longitude = r.longitude;
+      record.id = r.mmsi;
+      record.heading = r.heading;
+      record.cog = r.cog;
+      record.sog = r.sog;
+      m_journal.append(record);
+    }
+
+  // Only live reports are binned, reloaded ones already were.
+  for(const auto& r: m_report_batch)
+    if(!r.synthetic)
+      m_density.add(r.latitude, r.longitude);
+
+  applyReports();
+
+  m_statistics.reports += m_report_batch.size();
+  m_statistics.ingest_time += timer.nsecsElapsed();
+}
+
+void AISManager::applyReports()
+{
+  // Stable so each contact's reports stay in arrival order.
+  std::stable_sort(m_report_batch.begin(), m_report_batch.end(), [](const AISReport& a, const AISReport& b){return a.mmsi < b.mmsi;});
+
+  auto group = m_report_batch.begin();
+  while(group != m_report_batch.end())
+  {
+    auto group_end = group;
+    while(group_end != m_report_batch.end() && group_end->mmsi == group->mmsi)
+      group_end++;
+
+    auto& contact = m_contacts[group->mmsi];
+    if(!contact)
+    {
+      contact = new AISContact(*group, this, m_background);
+      contact->setHistoryRetention(m_history_seconds, m_history_max_reports);
+      m_ui->contactListWidget->addItem(QString::number(group->mmsi));
+    }
+    int entity = m_history_store ? historyEntity(group->mmsi) : -1;
+    for(auto r = group; r != group_end; r++)
+    {
+      contact->newReport(*r);
+      if(m_history_store)
+        m_history_store->add(entity, {r->timestamp.toSec(), r->latitude, r->longitude, float(r->heading), r->cog, r->sog});
+    }
+    m_spatial_index.update(contact, contact->position());
+    if(m_geofence_monitor)
+    {
+      // The latest report stands for the batch.
+      auto last = group_end-1;
+      // The name can change, or be shared, the MMSI can't.
+      m_geofence_monitor->update("ais/"+QString::number(group->mmsi), contact->displayName(), QGeoCoordinate(last->latitude, last->longitude), last->cog, last->sog);
+    }
+
+    group = group_end;
+  }
+}
+
+void AISManager::openJournal()
+{
+  QString path = track_journal::path("ais");
+  if(path.isEmpty())
+    return;
+
+  // Contacts only keep their recent history so there's no point
+  // reloading more.
+  double reload = std::min(track_journal::reloadSeconds(), m_history_seconds);
+  TrackJournalReader reader;
+  if(reader.open(path))
+  {
+    QElapsedTimer timer;
+    timer.start();
+    // Records carry the header stamps, so this uses ROS time too, which
+    // may be simulated.
+    int64_t since = ros::Time::now().toNSec() - int64_t(reload*1.0e9);
+    m_report_batch.clear();
+    for(std::size_t i = reader.seek(since); i < reader.size(); i++)
+    {
+      const auto& record = reader.records()[i];
+      if(record.stamp_ns < since || !track_journal::valid(record))
+        continue;
+      // Names and dimensions aren't journaled, they come back with
+      // the next live report.
+      AISReport report;
+      memset(&report, 0, sizeof(report));
+      report.mmsi = record.id;
+      report.timestamp.fromNSec(record.stamp_ns);
+      report.latitude = record.latitude;
+      report.longitude = record.longitude;
+      report.heading = record.heading;
+      report.cog = record.cog;
+      report.sog = record.sog;
+      m_report_batch.push_back(report);
+    }
+    applyReports();
+    ROS_INFO_STREAM("Reloaded " << m_report_batch.size() << " AIS reports for " << m_contacts.size() << " contacts from " << path.toStdString() << " in " << timer.elapsed() << " ms");
+    m_report_batch.clear();
+  }
+  m_journal.open(path, std::max(track_journal::reloadSeconds(), m_history_seconds));
+}
+
+AISManager::Statistics AISManager::takeStatistics()
+{
+  Statistics ret = m_statistics;
+  m_statistics = Statistics();
+  ret.dropped_reports = m_dropped_reports.exchange(0);
+  ret.contacts = m_contacts.size();
+  ret.visible_contacts = m_viewport.isValid() ? m_visible_contacts.size() : m_contacts.size();
+  auto stage_times = AISContact::takeStageTimes();
+  ret.paint_time = stage_times.paint;
+  ret.projection_time = stage_times.projection;
+  ret.shape_time = stage_times.shapes;
+  return ret;
+}
+
+void AISManager::setHistoryRetention(double seconds, std::size_t max_reports)
+{
+  m_history_seconds = seconds;
+  m_history_max_reports = max_reports;
+  for(auto c: m_contacts)
+    c.second->setHistoryRetention(seconds, max_reports);
+}
+
+void AISManager::setPlatformManager(PlatformManager* platform_manager)
+{
+  m_platform_manager = platform_manager;
+}
+
+void AISManager::setGeofenceMonitor(GeofenceMonitor* monitor)
+{
+  m_geofence_monitor = monitor;
+}
+
+void AISManager::updateCollisionRisk()
+{
+  if(!m_platform_manager)
+    return;
+
+  QElapsedTimer timer;
+  timer.start();
+
+  m_collision_risk_engine.clear();
+  for(auto platform: m_platform_manager->platforms())
+  {
+    QGeoCoordinate position;
+    double heading, sog;
+    if(platform->navigationState(position, heading, sog))
+    {
+      // Without a heading, assume the platform is holding position.
+      if(std::isnan(heading))
+        m_collision_risk_engine.addPlatform(position.latitude(), position.longitude(), 0.0, 0.0);
+      else
+        m_collision_risk_engine.addPlatform(position.latitude(), position.longitude(), heading, sog);
+    }
+  }
+
+  ros::Time now = ros::Time::now();
+  for(auto c: m_contacts)
+  {
+    auto state = c.second->latestState();
+    if(!state)
+      continue;
+    double age = std::max(0.0, (now - state->timestamp).toSec());
+    // Contacts not heard from in a while can't be dead reckoned reliably.
+    if(age > 600.0)
+      continue;
+    m_collision_risk_engine.addContact(c.first, state->location.location.latitude(), state->location.location.longitude(), state->cog, state->sog, age);
+  }
+
+  std::set<uint32_t> risks;
+  for(const auto& risk: m_collision_risk_engine.compute())
+  {
+    // A contact on top of a platform is most likely its own AIS.
+    if(risk.range < 25.0 || risks.count(risk.mmsi))
+      continue;
+    risks.insert(risk.mmsi);
+    auto contact = m_contacts.find(risk.mmsi);
+    if(contact == m_contacts.end())
+      continue;
+    contact->second->setCollisionRisk(true);
+    if(!m_collision_risks.count(risk.mmsi))
+      emit collisionRisk(risk.mmsi, contact->second->displayName(), risk.cpa, risk.tcpa);
+  }
+  for(auto mmsi: m_collision_risks)
+    if(!risks.count(mmsi))
+    {
+      auto contact = m_contacts.find(mmsi);
+      if(contact != m_contacts.end())
+        contact->second->setCollisionRisk(false);
+    }
+  m_collision_risks.swap(risks);
+
+  ROS_DEBUG_STREAM_THROTTLE(10.0, "Collision risk: " << m_collision_risk_engine.contactCount() << " contacts, " << m_collision_risks.size() << " at risk, " << timer.nsecsElapsed()/1.0e6 << " ms");
+}
+
+void AISManager::setHistoryStore(HistoryStore* store)
+{
+  if(m_history_store)
+    disconnect(m_history_store, nullptr, this, nullptr);
+  m_history_store = store;
+  m_history_entities.clear();
+  if(!store)
+    return;
+  // Contacts not heard from within the retention time are removed.
+  connect(store, &HistoryStore::entityRemoved, this, [this](int entity, QString name)
+  {
+    if(name.startsWith("ais/"))
+      m_history_entities.erase(name.mid(4).toUInt());
+  });
+  for(auto c: m_contacts)
+  {
+    int entity = historyEntity(c.first);
+    const auto& states = c.second->states();
+    for(std::size_t i = 0; i < states.size(); i++)
+    {
+      const auto& state = states[i];
+      store->add(entity, {state.timestamp.toSec(), state.location.location.latitude(), state.location.location.longitude(), float(state.heading), float(state.cog), float(state.sog)});
+    }
+  }
+}
+
+int AISManager::historyEntity(uint32_t mmsi)
+{
+  auto i = m_history_entities.find(mmsi);
+  if(i != m_history_entities.end())
+    return i->second;
+  int entity = m_history_store->entity("ais/"+QString::number(mmsi));
+  m_history_entities[mmsi] = entity;
+  return entity;
+}
+
+void AISManager::setDisplayTime(double time)
+{
+  m_display_time = time;
+  if(std::isnan(time) || !m_history_store)
+  {
+    m_replay_timer->stop();
+    for(auto c: m_contacts)
+      c.second->showLive();
+    return;
+  }
+  // The slider moves many times a second while dragged. The first
+  // move redraws after the interval, using the time by then.
+  if(!m_replay_timer->isActive())
+    m_replay_timer->start();
+}
+
+void AISManager::updateReplay()
+{
+  if(std::isnan(m_display_time) || !m_history_store)
+    return;
+
+  QElapsedTimer timer;
+  timer.start();
+
+  for(auto c: m_contacts)
+  {
+    m_replay_track.clear();
+    // Contacts without history, or not heard from in a while at that
+    // time, are hidden.
+    auto entity = m_history_entities.find(c.first);
+    HistoryStore::State state;
+    if(entity != m_history_entities.end() && m_history_store->stateAt(entity->second, m_display_time, state))
+    {
+      m_history_store->segment(entity->second, m_display_time - m_history_seconds, m_display_time, m_replay_track);
+      if(m_replay_track.empty() || m_replay_track.back().time < m_display_time)
+        m_replay_track.push_back(state);
+    }
+    c.second->showHistory(m_replay_track);
+  }
+
+  ROS_DEBUG_STREAM("AIS replay of " << m_contacts.size() << " contacts took " << timer.nsecsElapsed()/1.0e6 << " ms");
 }
 
+void AISManager::updateVisibleContacts()
+{
+  QElapsedTimer timer;
+  timer.start();
+
+  // The view is frozen while looking back in time.
+  if(!std::isnan(m_display_time))
+    return;
+
+  if(!m_background || !m_viewport.isValid())
+  {
+    for(auto c: m_contacts)
+      c.second->updateView();
+    m_statistics.update_time += timer.nsecsElapsed();
+    return;
+  }
+
+  // Tracks and predictions reach past a contact's position, so
+  // contacts just outside the view are refreshed as well. The others
+  // catch up once they scroll into view.
+  QRectF area = m_background->mapRectFromScene(m_viewport);
+  area.adjust(-area.width()/2.0, -area.height()/2.0, area.width()/2.0, area.height()/2.0);
+  m_visible_contacts.clear();
+  m_spatial_index.query(area, m_visible_contacts);
+  for(auto c: m_visible_contacts)
+    c->updateView();
+  m_statistics.update_time += timer.nsecsElapsed();
+}
 
-void AISManager::addAisReport(AISReport* report)
+void AISManager::updateDensity()
 {
-  if(m_contacts.find(report->mmsi) == m_contacts.end())
+  if(m_density_watcher.isRunning())
+    return;
+
+  QString save_path;
+  if(!m_density_path.isEmpty() && m_density_save_timer.elapsed() > 300000)
   {
-    m_contacts[report->mmsi] = new AISContact(report, this, m_background);
-    connect(m_update_timer, &QTimer::timeout, m_contacts[report->mmsi], &AISContact::updateView);
-    m_ui->contactListWidget->addItem(QString::number(report->mmsi));
+    m_density_save_timer.start();
+    save_path = m_density_path;
   }
-  m_contacts[report->mmsi]->newReport(report);
+  if(!m_density.changed() && save_path.isEmpty())
+    return;
+
+  // The snapshot shares the counts, reports keep being added to
+  // m_density meanwhile.
+  AISDensityGrid snapshot = m_density.takeSnapshot();
+  m_density_watcher.setFuture(QtConcurrent::run([snapshot, save_path]() mutable
+  {
+    snapshot.updatePyramid();
+    if(!save_path.isEmpty())
+    {
+      QDir().mkpath(QFileInfo(save_path).path());
+      snapshot.save(save_path);
+    }
+    return snapshot;
+  }));
+}
+
+void AISManager::densityUpdated()
+{
+  m_density.takePyramid(m_density_watcher.result());
+  if(m_density_layer && m_density_layer->isVisible())
+    m_density_layer->update();
+}
+
+void AISManager::showDensity(bool show)
+{
+  if(m_density_layer)
+    m_density_layer->setVisible(show);
 }
 
 void AISManager::updateBackground(BackgroundRaster * bg)
 {
   m_background = bg;
+  if(!m_density_layer)
+  {
+    m_density_layer = new AISDensityLayer(&m_density, bg);
+    m_density_layer->setVisible(m_ui->densityCheckBox->isChecked());
+  }
+  else
+    m_density_layer->setBackground(bg);
+  m_spatial_index.clear();
   for(auto c: m_contacts)
   {
     c.second->setParentItem(bg);
     c.second->updateProjectedPoints();
+    m_spatial_index.update(c.second, c.second->position());
   }
 
 }
@@ -90,4 +510,6 @@ void AISManager::updateBackground(BackgroundRaster * bg)
 void AISManager::updateViewport(QPointF ll, QPointF ur)
 {
   //ROS_INFO_STREAM( "viewport: " << ll.x() << ", " << ll.y() << " - " << ur.x() << ", " << ur.y());
+  m_viewport = QRectF(ll, ur).normalized();
+  updateVisibleContacts();
 }
@@ -2,17 +2,30 @@
 #define CAMP_AIS_MANAGER_H
 
 #include <QWidget>
+#include <QElapsedTimer>
+#include <QFutureWatcher>
 #include "ros/ros.h"
 #include "project11_msgs/Contact.h"
 #include "marine_ais_msgs/AISContact.h"
 #include "ais_contact.h"
+#include "ais_spatial_index.h"
+#include "mpsc_ring_buffer.h"
+#include "collision_risk.h"
+#include "ais_density_grid.h"
+#include "track_journal.h"
+#include "history_store.h"
+#include <set>
+#include <atomic>
 
 namespace Ui
 {
 class AISManager;
 }
 
+class AISDensityLayer;
+class GeofenceMonitor;
 class BackgroundRaster;
+class PlatformManager;
 
 class AISManager: public QWidget
 {
@@ -22,18 +35,84 @@ public:
   explicit AISManager(QWidget *parent =0);
   ~AISManager();
 
+  // Queues a report for the next batch. Safe to call from any thread.
+  // Returns false if the queue is full and the report was dropped.
+  bool queueReport(const AISReport& report);
+
+  // How much track history each contact keeps, applied to current and
+  // future contacts.
+  void setHistoryRetention(double seconds, std::size_t max_reports);
+
+  // Platforms checked against the contacts for collision risk.
+  void setPlatformManager(PlatformManager* platform_manager);
+
+  // Records every report in store, including those already received,
+  // for looking back in time.
+  void setHistoryStore(HistoryStore* store);
+
+  // Checks every contact's reports against the avoid areas.
+  void setGeofenceMonitor(GeofenceMonitor* monitor);
+
+  // Work done by each stage of the display pipeline.
+  struct Statistics
+  {
+    uint64_t reports = 0;
+    uint64_t dropped_reports = 0;
+    std::size_t contacts = 0;
+    std::size_t visible_contacts = 0;
+    // Nanoseconds spent applying reports, refreshing contacts and
+    // painting them.
+    int64_t ingest_time = 0;
+    int64_t update_time = 0;
+    int64_t paint_time = 0;
+    // Spent projecting positions and building the contacts' paths,
+    // mostly while ingesting and updating so also counted there.
+    int64_t projection_time = 0;
+    int64_t shape_time = 0;
+  };
+
+  // Returns the counts accumulated since the last call and resets
+  // them. contacts and visible_contacts are current values.
+  Statistics takeStatistics();
+
 signals:
-  void newAisReport(AISReport *report);
+  // Emitted when a contact becomes a collision risk, with the CPA in
+  // meters and the TCPA in seconds.
+  void collisionRisk(uint32_t mmsi, QString name, double cpa, double tcpa);
 
 public slots:
   void updateBackground(BackgroundRaster * bg);
   void updateViewport(QPointF ll, QPointF ur);
 
+  // Shows the contacts as they were at time, from the history store,
+  // or live if time is NaN.
+  void setDisplayTime(double time);
+
 private slots:
   void scanForSources();
-  void addAisReport(AISReport *report);
+  // Drains the report queue and applies the reports grouped by contact.
+  void processReports();
+
+  // Refreshes the contacts near the viewport.
+  void updateVisibleContacts();
+
+  void updateCollisionRisk();
+
+  // Rebuilds the density pyramid and saves it now and then, on a
+  // worker thread.
+  void updateDensity();
+  void densityUpdated();
+  void showDensity(bool show);
 
 private:
+  // Applies m_report_batch, grouped by contact.
+  void applyReports();
+  // Reloads recent reports from the journal and starts journaling.
+  void openJournal();
+  int historyEntity(uint32_t mmsi);
+  // Redraws the contacts at m_display_time.
+  void updateReplay();
+
   void contactCallback(const project11_msgs::Contact::ConstPtr& message);
   void aisContactCallback(const marine_ais_msgs::AISContact::ConstPtr& message);
 
@@ -41,8 +120,49 @@ private:
   std::map<std::string, ros::Subscriber> m_sources;
   QTimer* m_scan_timer;
   QTimer* m_update_timer;
+  QTimer* m_process_timer;
+  // Limits replay updates while the time slider is dragged.
+  QTimer* m_replay_timer;
+
+  MPSCRingBuffer<AISReport> m_report_queue;
+  std::atomic<uint64_t> m_dropped_reports {0};
+  Statistics m_statistics;
+  // Reused between batches to avoid allocating.
+  std::vector<AISReport> m_report_batch;
   std::map<uint32_t, AISContact*> m_contacts;
 
+  AISSpatialIndex m_spatial_index;
+  // Scene rectangle last reported by the view, invalid until then.
+  QRectF m_viewport;
+  std::vector<AISContact*> m_visible_contacts;
+
+  PlatformManager* m_platform_manager = nullptr;
+  GeofenceMonitor* m_geofence_monitor = nullptr;
+  QTimer* m_collision_timer;
+  CollisionRiskEngine m_collision_risk_engine;
+  std::set<uint32_t> m_collision_risks;
+
+  double m_history_seconds;
+  std::size_t m_history_max_reports;
+
+  TrackJournalWriter m_journal;
+
+  HistoryStore* m_history_store = nullptr;
+  std::map<uint32_t, int> m_history_entities;
+  // NaN when live.
+  double m_display_time;
+  // Reused between contacts.
+  std::vector<HistoryStore::State> m_replay_track;
+
+  // Every live report binned by position, kept across runs. Reports
+  // from the traffic generator are left out.
+  AISDensityGrid m_density;
+  QFutureWatcher<AISDensityGrid> m_density_watcher;
+  AISDensityLayer* m_density_layer = nullptr;
+  QString m_density_path;
+  QTimer* m_density_timer;
+  QElapsedTimer m_density_save_timer;
+
   BackgroundRaster* m_background = nullptr;
 };
 
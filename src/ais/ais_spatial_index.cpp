@@ -0,0 +1,90 @@
+#include "ais_spatial_index.h"
+#include <algorithm>
+#include <cmath>
+
+AISSpatialIndex::AISSpatialIndex(double cell_size):m_cell_size(cell_size)
+{
+}
+
+quint64 AISSpatialIndex::cellKey(int x, int y) const
+{
+  return (quint64(quint32(x)) << 32) | quint32(y);
+}
+
+quint64 AISSpatialIndex::cellKey(QPointF position) const
+{
+  return cellKey(std::floor(position.x()/m_cell_size), std::floor(position.y()/m_cell_size));
+}
+
+void AISSpatialIndex::update(AISContact* contact, QPointF position)
+{
+  quint64 key = cellKey(position);
+  auto current = m_contact_cells.find(contact);
+  if(current != m_contact_cells.end())
+  {
+    if(current.value() == key)
+      return;
+    auto& cell = m_cells[current.value()];
+    cell.erase(std::remove(cell.begin(), cell.end(), contact), cell.end());
+    if(cell.empty())
+      m_cells.remove(current.value());
+    current.value() = key;
+  }
+  else
+    m_contact_cells[contact] = key;
+  m_cells[key].push_back(contact);
+}
+
+void AISSpatialIndex::remove(AISContact* contact)
+{
+  auto current = m_contact_cells.find(contact);
+  if(current == m_contact_cells.end())
+    return;
+  auto& cell = m_cells[current.value()];
+  cell.erase(std::remove(cell.begin(), cell.end(), contact), cell.end());
+  if(cell.empty())
+    m_cells.remove(current.value());
+  m_contact_cells.erase(current);
+}
+
+void AISSpatialIndex::clear()
+{
+  m_cells.clear();
+  m_contact_cells.clear();
+}
+
+void AISSpatialIndex::query(const QRectF& rect, std::vector<AISContact*>& contacts) const
+{
+  QRectF r = rect.normalized();
+  int x1 = std::floor(r.left()/m_cell_size);
+  int x2 = std::floor(r.right()/m_cell_size);
+  int y1 = std::floor(r.top()/m_cell_size);
+  int y2 = std::floor(r.bottom()/m_cell_size);
+
+  // Zoomed far out, walking the occupied cells is cheaper than
+  // walking the covered ones.
+  if(qint64(x2-x1+1)*(y2-y1+1) > m_cells.size())
+  {
+    for(auto cell = m_cells.begin(); cell != m_cells.end(); cell++)
+    {
+      int x = qint32(cell.key() >> 32);
+      int y = qint32(cell.key() & 0xffffffff);
+      if(x >= x1 && x <= x2 && y >= y1 && y <= y2)
+        contacts.insert(contacts.end(), cell.value().begin(), cell.value().end());
+    }
+    return;
+  }
+
+  for(int x = x1; x <= x2; x++)
+    for(int y = y1; y <= y2; y++)
+    {
+      auto cell = m_cells.find(cellKey(x, y));
+      if(cell != m_cells.end())
+        contacts.insert(contacts.end(), cell.value().begin(), cell.value().end());
+    }
+}
+
+int AISSpatialIndex::size() const
+{
+  return m_contact_cells.size();
+}
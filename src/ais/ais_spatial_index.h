@@ -0,0 +1,38 @@
+#ifndef CAMP_AIS_SPATIAL_INDEX_H
+#define CAMP_AIS_SPATIAL_INDEX_H
+
+#include <QHash>
+#include <QPointF>
+#include <QRectF>
+#include <vector>
+
+class AISContact;
+
+// Uniform grid of contacts by projected position, so only the
+// contacts near the viewport need to be visited.
+class AISSpatialIndex
+{
+public:
+  // cell_size is in the background's pixels.
+  AISSpatialIndex(double cell_size = 500.0);
+
+  // Adds the contact or moves it to the cell containing position.
+  void update(AISContact* contact, QPointF position);
+  void remove(AISContact* contact);
+  void clear();
+
+  // Appends the contacts in cells overlapping rect to contacts.
+  void query(const QRectF& rect, std::vector<AISContact*>& contacts) const;
+
+  int size() const;
+
+private:
+  quint64 cellKey(int x, int y) const;
+  quint64 cellKey(QPointF position) const;
+
+  double m_cell_size;
+  QHash<quint64, std::vector<AISContact*> > m_cells;
+  QHash<AISContact*, quint64> m_contact_cells;
+};
+
+#endif
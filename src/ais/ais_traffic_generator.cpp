@@ -0,0 +1,164 @@
+#include "ais_traffic_generator.h"
+#include "ais_manager.h"
+#include <QElapsedTimer>
+#include <QThread>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+
+namespace
+{
+
+const double meters_per_degree = 111320.0;
+
+// Class A reporting intervals in seconds.
+double classAInterval(double sog, bool turning)
+{
+  double knots = sog*1.9438;
+  if(knots < 0.5)
+    return 180.0;
+  if(knots < 14.0)
+    return turning ? 3.3 : 10.0;
+  if(knots < 23.0)
+    return turning ? 2.0 : 6.0;
+  return 2.0;
+}
+
+} // namespace
+
+AISTrafficGenerator::AISTrafficGenerator(AISManager* manager, int vessel_count, QGeoCoordinate center, double radius, unsigned seed):
+  m_manager(manager), m_center(center), m_radius(radius), m_random(seed)
+{
+  std::uniform_real_distribution<double> unit(0.0, 1.0);
+  std::uniform_real_distribution<double> course(0.0, 360.0);
+  m_vessels.resize(vessel_count);
+  for(int i = 0; i < vessel_count; i++)
+  {
+    Vessel& v = m_vessels[i];
+    v.mmsi = 990000000 + i;
+    double r = radius*std::sqrt(unit(m_random));
+    double a = course(m_random)*M_PI/180.0;
+    v.x = r*sin(a);
+    v.y = r*cos(a);
+    v.cog = course(m_random);
+    // A quarter at anchor or moored, the rest up to 20 knots.
+    v.sog = unit(m_random) < 0.25 ? 0.0 : unit(m_random)*10.0;
+    v.rate_of_turn = 0.0;
+    v.length = 10.0 + unit(m_random)*290.0;
+    v.beam = v.length*(0.12 + unit(m_random)*0.08);
+    // Spread the first reports over the first interval.
+    v.next_report = unit(m_random)*reportInterval(v);
+  }
+}
+
+AISTrafficGenerator::~AISTrafficGenerator()
+{
+  stop();
+}
+
+void AISTrafficGenerator::start()
+{
+  stop();
+  m_report_count = 0;
+  m_dropped_count = 0;
+  // Reports are stamped with ros::Time, which may not be running
+  // when there is no ROS master.
+  if(!ros::Time::isValid())
+    ros::Time::init();
+  m_thread = QThread::create(std::bind(&AISTrafficGenerator::run, this));
+  m_thread->start();
+}
+
+void AISTrafficGenerator::stop()
+{
+  if(m_thread)
+  {
+    m_thread->requestInterruption();
+    m_thread->wait();
+    delete m_thread;
+    m_thread = nullptr;
+  }
+}
+
+uint64_t AISTrafficGenerator::reportCount() const
+{
+  return m_report_count;
+}
+
+uint64_t AISTrafficGenerator::droppedCount() const
+{
+  return m_dropped_count;
+}
+
+double AISTrafficGenerator::reportInterval(const Vessel& vessel) const
+{
+  return classAInterval(vessel.sog, vessel.rate_of_turn != 0.0);
+}
+
+void AISTrafficGenerator::advance(Vessel& vessel, double dt)
+{
+  std::uniform_real_distribution<double> unit(0.0, 1.0);
+
+  // Occasionally start or stop turning and change speed a little.
+  if(vessel.sog > 0.0 && unit(m_random) < 0.05*dt)
+    vessel.rate_of_turn = unit(m_random) < 0.5 ? 0.0 : (unit(m_random)-0.5)*6.0;
+  if(vessel.sog > 0.0 && unit(m_random) < 0.02*dt)
+    vessel.sog = std::max(0.5, vessel.sog + (unit(m_random)-0.5)*2.0);
+
+  vessel.cog = std::fmod(vessel.cog + vessel.rate_of_turn*dt + 360.0, 360.0);
+  vessel.x += vessel.sog*sin(vessel.cog*M_PI/180.0)*dt;
+  vessel.y += vessel.sog*cos(vessel.cog*M_PI/180.0)*dt;
+
+  // Keep the traffic in the area by heading back to the center.
+  if(vessel.x*vessel.x + vessel.y*vessel.y > m_radius*m_radius)
+  {
+    vessel.cog = std::fmod(atan2(-vessel.x, -vessel.y)*180.0/M_PI + 360.0, 360.0);
+    vessel.rate_of_turn = 0.0;
+  }
+}
+
+void AISTrafficGenerator::run()
+{
+  QElapsedTimer timer;
+  timer.start();
+  double last = 0.0;
+  double cos_latitude = cos(m_center.latitude()*M_PI/180.0);
+
+  while(!QThread::currentThread()->isInterruptionRequested())
+  {
+    double now = timer.elapsed()/1000.0;
+    double dt = now - last;
+    last = now;
+    ros::Time stamp = ros::Time::now();
+
+    for(auto& v: m_vessels)
+    {
+      advance(v, dt);
+      if(now < v.next_report)
+        continue;
+      v.next_report = now + reportInterval(v);
+
+      AISReport report;
+      memset(&report, 0, sizeof(report));
+      report.mmsi = v.mmsi;
+      snprintf(report.name, sizeof(report.name), "SIM %u", v.mmsi);
+      report.dimension_to_bow = v.length*0.6;
+      report.dimension_to_stern = v.length*0.4;
+      report.dimension_to_port = v.beam/2.0;
+      report.dimension_to_stbd = v.beam/2.0;
+      report.timestamp = stamp;
+      report.latitude = m_center.latitude() + v.y/meters_per_degree;
+      report.longitude = m_center.longitude() + v.x/(meters_per_degree*cos_latitude);
+      report.heading = v.sog > 0.0 ? v.cog : std::nan("");
+      report.cog = v.cog;
+      report.sog = v.sog;
+      report.synthetic = true;
+
+      m_report_count++;
+      if(!m_manager->queueReport(report))
+        m_dropped_count++;
+    }
+    QThread::msleep(20);
+  }
+}
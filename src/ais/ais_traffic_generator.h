@@ -0,0 +1,65 @@
+#ifndef CAMP_AIS_TRAFFIC_GENERATOR_H
+#define CAMP_AIS_TRAFFIC_GENERATOR_H
+
+#include <QGeoCoordinate>
+#include <atomic>
+#include <random>
+#include <vector>
+
+class AISManager;
+class QThread;
+
+// Simulates AIS traffic and feeds it straight into AISManager's report
+// queue, so the ingestion and display path can be exercised without a
+// ROS master or a real feed.
+//
+// Vessels start at random positions within radius of center and wander
+// with slowly changing course and speed. Each reports at the class A
+// rate for its speed and whether it's turning. The same seed gives the
+// same traffic.
+class AISTrafficGenerator
+{
+public:
+  AISTrafficGenerator(AISManager* manager, int vessel_count, QGeoCoordinate center, double radius, unsigned seed = 1);
+  ~AISTrafficGenerator();
+
+  void start();
+  void stop();
+
+  // Reports produced and reports the queue dropped since start.
+  uint64_t reportCount() const;
+  uint64_t droppedCount() const;
+
+private:
+  struct Vessel
+  {
+    uint32_t mmsi;
+    // Meters east and north of center.
+    double x;
+    double y;
+    // Degrees clockwise from north and m/s.
+    double cog;
+    double sog;
+    // Degrees per second.
+    double rate_of_turn;
+    double next_report;
+    float length;
+    float beam;
+  };
+
+  void run();
+  void advance(Vessel& vessel, double dt);
+  double reportInterval(const Vessel& vessel) const;
+
+  AISManager* m_manager;
+  QGeoCoordinate m_center;
+  double m_radius;
+  std::mt19937 m_random;
+  std::vector<Vessel> m_vessels;
+
+  QThread* m_thread = nullptr;
+  std::atomic<uint64_t> m_report_count {0};
+  std::atomic<uint64_t> m_dropped_count {0};
+};
+
+#endif
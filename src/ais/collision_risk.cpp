@@ -0,0 +1,229 @@
+#include "collision_risk.h"
+#include <algorithm>
+#include <cmath>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+
+// Speeds above this don't grow the search cells, so one bogus report
+// doesn't defeat the pruning. Anything faster skips the cells instead.
+const float max_plausible_speed = 30.0;
+
+// Below this squared relative speed in (m/s)^2 the vessels are
+// considered to be moving together and the CPA is the current range.
+const float min_relative_speed_squared = 1.0e-6;
+
+} // namespace
+
+void CollisionRiskEngine::setThresholds(double cpa_meters, double tcpa_seconds)
+{
+  m_cpa_threshold = cpa_meters;
+  m_tcpa_threshold = tcpa_seconds;
+}
+
+void CollisionRiskEngine::clear()
+{
+  m_platform_x.clear();
+  m_platform_y.clear();
+  m_platform_vx.clear();
+  m_platform_vy.clear();
+  m_platform_fast.clear();
+  m_max_platform_speed = 0.0;
+  m_mmsi.clear();
+  m_x.clear();
+  m_y.clear();
+  m_vx.clear();
+  m_vy.clear();
+  m_max_contact_speed = 0.0;
+  m_fast_contacts.clear();
+}
+
+void CollisionRiskEngine::project(double latitude, double longitude, float& x, float& y) const
+{
+  x = (longitude - m_origin_longitude)*m_meters_per_degree_longitude;
+  y = (latitude - m_origin_latitude)*m_meters_per_degree_latitude;
+}
+
+void CollisionRiskEngine::addPlatform(double latitude, double longitude, double cog, double sog)
+{
+  if(m_platform_x.empty())
+  {
+    m_origin_latitude = latitude;
+    m_origin_longitude = longitude;
+    // Spherical approximation, plenty for the ranges involved.
+    m_meters_per_degree_latitude = 6371000.0*M_PI/180.0;
+    m_meters_per_degree_longitude = m_meters_per_degree_latitude*cos(latitude*M_PI/180.0);
+  }
+  float x, y;
+  project(latitude, longitude, x, y);
+  m_platform_x.push_back(x);
+  m_platform_y.push_back(y);
+  m_platform_vx.push_back(sog*sin(cog*M_PI/180.0));
+  m_platform_vy.push_back(sog*cos(cog*M_PI/180.0));
+  m_platform_fast.push_back(sog > max_plausible_speed);
+  m_max_platform_speed = std::max<float>(m_max_platform_speed, std::min<float>(sog, max_plausible_speed));
+}
+
+void CollisionRiskEngine::addContact(uint32_t mmsi, double latitude, double longitude, double cog, double sog, double age)
+{
+  if(m_platform_x.empty())
+    return;
+  float x, y;
+  project(latitude, longitude, x, y);
+  float vx = sog*sin(cog*M_PI/180.0);
+  float vy = sog*cos(cog*M_PI/180.0);
+  m_mmsi.push_back(mmsi);
+  m_x.push_back(x + vx*age);
+  m_y.push_back(y + vy*age);
+  m_vx.push_back(vx);
+  m_vy.push_back(vy);
+  if(sog > max_plausible_speed)
+    m_fast_contacts.push_back(m_mmsi.size()-1);
+  m_max_contact_speed = std::max<float>(m_max_contact_speed, std::min<float>(sog, max_plausible_speed));
+}
+
+int CollisionRiskEngine::contactCount() const
+{
+  return m_mmsi.size();
+}
+
+uint64_t CollisionRiskEngine::cellKey(int x, int y) const
+{
+  return (uint64_t(uint32_t(x)) << 32) | uint32_t(y);
+}
+
+const std::vector<CollisionRisk>& CollisionRiskEngine::compute()
+{
+  m_risks.clear();
+  if(m_platform_x.empty() || m_mmsi.empty())
+    return m_risks;
+
+  // Anything further than this can't get within the CPA threshold
+  // before the TCPA threshold.
+  double reach = m_cpa_threshold + (m_max_contact_speed + m_max_platform_speed)*m_tcpa_threshold;
+  double cell_size = std::max(reach, 100.0);
+
+  // Fast contacts are left out of the cells, every platform checks
+  // them anyway. m_fast_contacts is in the order added.
+  m_cells.clear();
+  auto fast = m_fast_contacts.begin();
+  for(std::size_t i = 0; i < m_mmsi.size(); i++)
+  {
+    if(fast != m_fast_contacts.end() && *fast == i)
+    {
+      fast++;
+      continue;
+    }
+    m_cells.push_back(std::make_pair(cellKey(std::floor(m_x[i]/cell_size), std::floor(m_y[i]/cell_size)), uint32_t(i)));
+  }
+  std::sort(m_cells.begin(), m_cells.end());
+
+  float cpa_threshold_squared = m_cpa_threshold*m_cpa_threshold;
+
+  for(std::size_t p = 0; p < m_platform_x.size(); p++)
+  {
+    m_candidates.clear();
+    if(m_platform_fast[p])
+    {
+      // The cells don't cover how far this platform could go.
+      for(std::size_t i = 0; i < m_mmsi.size(); i++)
+        m_candidates.push_back(i);
+    }
+    else
+    {
+      int cell_x = std::floor(m_platform_x[p]/cell_size);
+      int cell_y = std::floor(m_platform_y[p]/cell_size);
+      for(int x = cell_x-1; x <= cell_x+1; x++)
+        for(int y = cell_y-1; y <= cell_y+1; y++)
+        {
+          auto key = cellKey(x, y);
+          auto first = std::lower_bound(m_cells.begin(), m_cells.end(), std::make_pair(key, uint32_t(0)));
+          for(auto c = first; c != m_cells.end() && c->first == key; c++)
+            m_candidates.push_back(c->second);
+        }
+      // Fast contacts may close from beyond the neighboring cells.
+      m_candidates.insert(m_candidates.end(), m_fast_contacts.begin(), m_fast_contacts.end());
+    }
+
+    std::size_t count = m_candidates.size();
+    // Padded to a multiple of four for the vector loop.
+    std::size_t padded = (count+3) & ~std::size_t(3);
+    m_dx.resize(padded);
+    m_dy.resize(padded);
+    m_dvx.resize(padded);
+    m_dvy.resize(padded);
+    m_tcpa.resize(padded);
+    m_cpa_squared.resize(padded);
+    for(std::size_t i = 0; i < padded; i++)
+    {
+      if(i < count)
+      {
+        auto c = m_candidates[i];
+        m_dx[i] = m_x[c] - m_platform_x[p];
+        m_dy[i] = m_y[c] - m_platform_y[p];
+        m_dvx[i] = m_vx[c] - m_platform_vx[p];
+        m_dvy[i] = m_vy[c] - m_platform_vy[p];
+      }
+      else
+        m_dx[i] = m_dy[i] = m_dvx[i] = m_dvy[i] = 0.0;
+    }
+
+    solve(padded);
+
+    for(std::size_t i = 0; i < count; i++)
+      if(m_tcpa[i] <= m_tcpa_threshold && m_cpa_squared[i] <= cpa_threshold_squared)
+      {
+        CollisionRisk risk;
+        risk.mmsi = m_mmsi[m_candidates[i]];
+        risk.platform = p;
+        risk.cpa = std::sqrt(m_cpa_squared[i]);
+        risk.tcpa = m_tcpa[i];
+        risk.range = std::sqrt(m_dx[i]*m_dx[i] + m_dy[i]*m_dy[i]);
+        m_risks.push_back(risk);
+      }
+  }
+
+  std::sort(m_risks.begin(), m_risks.end(), [](const CollisionRisk& a, const CollisionRisk& b){return a.cpa < b.cpa;});
+  return m_risks;
+}
+
+void CollisionRiskEngine::solve(std::size_t count)
+{
+  // tcpa = -(d.dv)/|dv|^2, clamped to now for vessels already past
+  // their closest point, and cpa = |d + dv*tcpa|.
+  std::size_t i = 0;
+#ifdef __SSE2__
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 min_speed = _mm_set1_ps(min_relative_speed_squared);
+  for(; i + 4 <= count; i += 4)
+  {
+    __m128 dx = _mm_loadu_ps(&m_dx[i]);
+    __m128 dy = _mm_loadu_ps(&m_dy[i]);
+    __m128 dvx = _mm_loadu_ps(&m_dvx[i]);
+    __m128 dvy = _mm_loadu_ps(&m_dvy[i]);
+    __m128 dot = _mm_add_ps(_mm_mul_ps(dx, dvx), _mm_mul_ps(dy, dvy));
+    __m128 speed_squared = _mm_add_ps(_mm_mul_ps(dvx, dvx), _mm_mul_ps(dvy, dvy));
+    __m128 moving = _mm_cmpgt_ps(speed_squared, min_speed);
+    __m128 t = _mm_div_ps(_mm_sub_ps(zero, dot), _mm_max_ps(speed_squared, min_speed));
+    t = _mm_and_ps(_mm_max_ps(t, zero), moving);
+    __m128 cx = _mm_add_ps(dx, _mm_mul_ps(dvx, t));
+    __m128 cy = _mm_add_ps(dy, _mm_mul_ps(dvy, t));
+    _mm_storeu_ps(&m_tcpa[i], t);
+    _mm_storeu_ps(&m_cpa_squared[i], _mm_add_ps(_mm_mul_ps(cx, cx), _mm_mul_ps(cy, cy)));
+  }
+#endif
+  for(; i < count; i++)
+  {
+    float speed_squared = m_dvx[i]*m_dvx[i] + m_dvy[i]*m_dvy[i];
+    float t = 0.0;
+    if(speed_squared > min_relative_speed_squared)
+      t = std::max(0.0f, -(m_dx[i]*m_dvx[i] + m_dy[i]*m_dvy[i])/speed_squared);
+    float cx = m_dx[i] + m_dvx[i]*t;
+    float cy = m_dy[i] + m_dvy[i]*t;
+    m_tcpa[i] = t;
+    m_cpa_squared[i] = cx*cx + cy*cy;
+  }
+}
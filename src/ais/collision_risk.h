@@ -0,0 +1,92 @@
+#ifndef CAMP_COLLISION_RISK_H
+#define CAMP_COLLISION_RISK_H
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// A contact predicted to pass within the CPA threshold of one of
+// our platforms within the TCPA threshold.
+struct CollisionRisk
+{
+  uint32_t mmsi;
+  // Index of the platform in the order they were added.
+  int platform;
+  // Meters and seconds.
+  float cpa;
+  float tcpa;
+  float range;
+};
+
+// Computes closest point of approach between AIS contacts and our own
+// platforms, assuming both hold their course and speed.
+//
+// Everything is projected onto a local east-north plane centered on
+// the first platform, which is accurate enough at the distances that
+// matter. Contacts are hashed into cells as wide as the distance a
+// contact could close in the TCPA threshold, so each platform only
+// checks the cells around it. Contacts too fast for the cells are
+// checked against every platform, and platforms too fast for them
+// check every contact. Candidates are gathered into contiguous
+// arrays and solved four at a time with SSE2 where available.
+class CollisionRiskEngine
+{
+public:
+  void setThresholds(double cpa_meters, double tcpa_seconds);
+
+  // Clears the platforms and contacts for a new cycle.
+  void clear();
+
+  // Positions in degrees, course in degrees clockwise from north and
+  // speed in m/s. Platforms must be added before contacts.
+  void addPlatform(double latitude, double longitude, double cog, double sog);
+  // age is the time in seconds since the contact's report, used to
+  // dead reckon it to now.
+  void addContact(uint32_t mmsi, double latitude, double longitude, double cog, double sog, double age = 0.0);
+
+  // Returns the contacts at risk, closest first.
+  const std::vector<CollisionRisk>& compute();
+
+  int contactCount() const;
+
+private:
+  void project(double latitude, double longitude, float& x, float& y) const;
+
+  // Returns cell coordinates packed in a key.
+  uint64_t cellKey(int x, int y) const;
+
+  // Solves the gathered candidates.
+  void solve(std::size_t count);
+
+  double m_cpa_threshold = 500.0;
+  double m_tcpa_threshold = 600.0;
+
+  double m_origin_latitude = 0.0;
+  double m_origin_longitude = 0.0;
+  double m_meters_per_degree_latitude = 0.0;
+  double m_meters_per_degree_longitude = 0.0;
+
+  // Platforms, kept in the order added.
+  std::vector<float> m_platform_x, m_platform_y, m_platform_vx, m_platform_vy;
+  std::vector<bool> m_platform_fast;
+  float m_max_platform_speed = 0.0;
+
+  // Contacts as structure of arrays.
+  std::vector<uint32_t> m_mmsi;
+  std::vector<float> m_x, m_y, m_vx, m_vy;
+  float m_max_contact_speed = 0.0;
+
+  // Contacts faster than the cells are sized for.
+  std::vector<uint32_t> m_fast_contacts;
+
+  // Contact indices sorted by cell.
+  std::vector<std::pair<uint64_t, uint32_t> > m_cells;
+
+  // Candidates gathered for one platform.
+  std::vector<uint32_t> m_candidates;
+  std::vector<float> m_dx, m_dy, m_dvx, m_dvy, m_tcpa, m_cpa_squared;
+
+  std::vector<CollisionRisk> m_risks;
+};
+
+#endif
@@ -106,6 +106,7 @@ void AutonomousVehicleProject::open(const QString &fname)
         QJsonDocument loadDoc(QJsonDocument::fromJson(loadData));
         m_root->read(loadDoc.object());
         emit layoutChanged();
+        emit avoidAreasChanged();
     }
 }
 
@@ -513,6 +514,18 @@ void AutonomousVehicleProject::sendToROS(const QModelIndex& index)
         gmi->lock();
 }
 
+QList<AvoidArea*> AutonomousVehicleProject::avoidAreas() const
+{
+    QList<AvoidArea*> ret;
+    for(auto mission_item: m_root->childMissionItems())
+    {
+        auto avoid_area = qobject_cast<AvoidArea*>(mission_item);
+        if(avoid_area)
+            ret.append(avoid_area);
+    }
+    return ret;
+}
+
 void AutonomousVehicleProject::updateAvoidanceAreas()
 {
     project11_nav_msgs::GeoOccupancyVectorMap avoidance_map;
@@ -566,6 +579,7 @@ void AutonomousVehicleProject::updateAvoidanceAreas()
     {
         m_activePlatform->missionManager()->sendAvoidanceAreas(avoidance_map);
     }
+    emit avoidAreasChanged();
 }
 
 void AutonomousVehicleProject::appendMission(const QModelIndex& index)
@@ -625,11 +639,14 @@ void AutonomousVehicleProject::deleteItem(const QModelIndex &index)
     }
     QModelIndex p = parent(index);
     MissionItem * pi = itemFromIndex(p);
+    bool avoid_area = qobject_cast<AvoidArea*>(item) || qobject_cast<AvoidArea*>(pi);
     int rownum = pi->childMissionItems().indexOf(item);
     beginRemoveRows(p,rownum,rownum);
     pi->removeChildMissionItem(item);
     delete item;
     endRemoveRows();
+    if(avoid_area)
+        emit avoidAreasChanged();
 }
 
 void AutonomousVehicleProject::deleteItem(MissionItem *item)
@@ -48,6 +48,7 @@ public:
 
     AvoidArea * createAvoidArea(MissionItem* parent=nullptr, int row=-1, QString label = "");
     AvoidArea * addAvoidArea(QGeoCoordinate position);
+    QList<AvoidArea*> avoidAreas() const;
 
     SearchPattern * createSearchPattern(MissionItem* parent=nullptr, int row=-1, QString label = "");
     SearchPattern * addSearchPattern(QGeoCoordinate position);
@@ -113,6 +114,7 @@ signals:
     void showRadar(bool show);
     void selectRadarColor();
     void showTail(bool show);
+    void avoidAreasChanged();
 
 public slots:
 
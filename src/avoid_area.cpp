@@ -22,13 +22,13 @@ void AvoidArea::paint(QPainter* painter, const QStyleOptionGraphicsItem* option,
   painter->save();
 
   QPen p;
-  p.setColor(Qt::red);
+  p.setColor(m_alert ? Qt::yellow : Qt::red);
   p.setCosmetic(true);
-  p.setWidth(2);
+  p.setWidth(m_alert ? 4 : 2);
   painter->setPen(p);
 
   QBrush b = painter->brush();
-  b.setColor(QColor(255, 0, 0, 128));
+  b.setColor(m_alert ? QColor(255, 0, 0, 192) : QColor(255, 0, 0, 128));
   b.setStyle(Qt::BrushStyle::SolidPattern);
   painter->setBrush(b);
 
@@ -110,6 +110,14 @@ QList<Waypoint *> AvoidArea::points() const
   return ret;
 }
 
+void AvoidArea::setAlert(bool alert)
+{
+  if(alert == m_alert)
+    return;
+  m_alert = alert;
+  update();
+}
+
 void AvoidArea::write(QJsonObject& json) const
 {
   MissionItem::write(json);
@@ -21,6 +21,9 @@ public:
 
     QList<Waypoint *> points() const;
 
+    // Highlights the area while something is in or heading into it.
+    void setAlert(bool alert);
+
     int type() const override {return AvoidAreaType;}
 
     void write(QJsonObject &json) const override;
@@ -43,7 +46,7 @@ protected:
     void mouseReleaseEvent(QGraphicsSceneMouseEvent *event) override;
 
 private:
-
+    bool m_alert = false;
 };
 
 #endif
@@ -9,7 +9,11 @@
 #include <QMenu>
 #include <QAction>
 #include <QFileDialog>
+#include <QInputDialog>
+#include <QLocale>
+#include <limits>
 #include "../wmts/capabilities.h"
+#include "../main/cached_file_loader.h"
 
 namespace background
 {
@@ -17,6 +21,12 @@ namespace background
 BackgroundManager::BackgroundManager(tools::ToolsManager* tools_manager):
   tools::LayerManager(tools_manager, "Background Manager")
 {
+  auto loader = camp::CachedFileLoader::get();
+  if(loader)
+  {
+    connect(loader, &camp::CachedFileLoader::statisticsChanged, this, &BackgroundManager::updateCacheStatus);
+    updateCacheStatus();
+  }
 }
 
 void BackgroundManager::createDefaultLayers()
@@ -49,6 +59,9 @@ void BackgroundManager::contextMenu(QMenu* menu)
 {
   auto open_raster_action = menu->addAction("Open raster");
   connect(open_raster_action, &QAction::triggered, this, &BackgroundManager::openRaster);
+
+  auto cache_budget_action = menu->addAction("Set cache size limit");
+  connect(cache_budget_action, &QAction::triggered, this, &BackgroundManager::setCacheBudget);
 }
 
 void BackgroundManager::openRaster()
@@ -65,4 +78,34 @@ void BackgroundManager::openRaster()
 
 }
 
+void BackgroundManager::updateCacheStatus()
+{
+  auto loader = camp::CachedFileLoader::get();
+  if(!loader)
+    return;
+
+  auto statistics = loader->statistics();
+  QLocale locale;
+  QString status = "(cache: "+locale.formattedDataSize(statistics.used_bytes);
+  if(statistics.budget_bytes > 0)
+    status += " of "+locale.formattedDataSize(statistics.budget_bytes);
+  status += ", "+QString::number(statistics.file_count)+" files";
+  if(statistics.evicted_file_count > 0)
+    status += ", "+QString::number(statistics.evicted_file_count)+" evicted";
+  status += ")";
+  setStatus(status);
+}
+
+void BackgroundManager::setCacheBudget()
+{
+  auto loader = camp::CachedFileLoader::get();
+  if(!loader)
+    return;
+
+  bool ok = false;
+  int megabytes = QInputDialog::getInt(nullptr, tr("Cache size limit"), tr("Maximum cache size in MB (0 for no limit):"), loader->cacheBudget()/(1024*1024), 0, std::numeric_limits<int>::max(), 100, &ok);
+  if(ok)
+    loader->setCacheBudget(qint64(megabytes)*1024*1024);
+}
+
 } // namespace base_layers
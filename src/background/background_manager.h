@@ -37,6 +37,10 @@ public:
 
 private slots:
   void openRaster();
+
+  // Shows the disk cache usage as status.
+  void updateCacheStatus();
+  void setCacheBudget();
 };
 
 } // namespace base_layers
@@ -0,0 +1,401 @@
+#include "geofence.h"
+#include "autonomousvehicleproject.h"
+#include "avoid_area.h"
+#include "waypoint.h"
+#include "ros/ros.h"
+#include <QTimer>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+
+// Children per R-tree node.
+const std::size_t node_capacity = 8;
+
+// Objects not heard from in this long are dropped from the alerts.
+const qint64 alert_timeout_ms = 600000;
+
+} // namespace
+
+void GeofenceEngine::project(double latitude, double longitude, float& x, float& y) const
+{
+  x = (longitude - m_origin_longitude)*m_meters_per_degree_longitude;
+  y = (latitude - m_origin_latitude)*m_meters_per_degree_latitude;
+}
+
+void GeofenceEngine::setHorizon(double seconds)
+{
+  m_horizon = seconds;
+}
+
+int GeofenceEngine::areaCount() const
+{
+  return m_areas.size();
+}
+
+void GeofenceEngine::setAreas(const std::vector<std::vector<QGeoCoordinate> >& areas)
+{
+  m_areas.clear();
+  m_edges.clear();
+  m_slabs.clear();
+  m_slab_edges.clear();
+
+  double latitude = 0.0;
+  double longitude = 0.0;
+  int count = 0;
+  for(const auto& area: areas)
+    for(const auto& vertex: area)
+    {
+      latitude += vertex.latitude();
+      longitude += vertex.longitude();
+      count++;
+    }
+  if(count > 0)
+  {
+    m_origin_latitude = latitude/count;
+    m_origin_longitude = longitude/count;
+  }
+  // Spherical approximation, plenty for the ranges involved.
+  m_meters_per_degree_latitude = 6371000.0*M_PI/180.0;
+  m_meters_per_degree_longitude = m_meters_per_degree_latitude*cos(m_origin_latitude*M_PI/180.0);
+
+  for(const auto& vertices: areas)
+  {
+    if(vertices.size() < 2)
+      continue;
+    std::vector<float> xs(vertices.size()), ys(vertices.size());
+    for(std::size_t i = 0; i < vertices.size(); i++)
+      project(vertices[i].latitude(), vertices[i].longitude(), xs[i], ys[i]);
+
+    Area area = {};
+    if(vertices.size() == 2)
+    {
+      area.circle = true;
+      area.center_x = xs[0];
+      area.center_y = ys[0];
+      area.radius = std::hypot(xs[1]-xs[0], ys[1]-ys[0]);
+      area.box = {xs[0]-area.radius, ys[0]-area.radius, xs[0]+area.radius, ys[0]+area.radius};
+      m_areas.push_back(area);
+      continue;
+    }
+
+    area.box = {*std::min_element(xs.begin(), xs.end()), *std::min_element(ys.begin(), ys.end()), *std::max_element(xs.begin(), xs.end()), *std::max_element(ys.begin(), ys.end())};
+    uint32_t first_edge = m_edges.size();
+    for(std::size_t i = 0; i < xs.size(); i++)
+    {
+      std::size_t j = (i+1)%xs.size();
+      m_edges.push_back({xs[i], ys[i], xs[j], ys[j]});
+    }
+
+    // About two edges per slab.
+    area.first_slab = m_slabs.size();
+    area.slab_count = std::max<std::size_t>(1, xs.size()/2);
+    area.slab_height = std::max(area.box.max_y - area.box.min_y, 1.0f)/area.slab_count;
+    for(uint32_t slab = 0; slab < area.slab_count; slab++)
+    {
+      float bottom = area.box.min_y + slab*area.slab_height;
+      float top = bottom + area.slab_height;
+      uint32_t begin = m_slab_edges.size();
+      for(uint32_t e = first_edge; e < m_edges.size(); e++)
+        if(std::max(m_edges[e].y0, m_edges[e].y1) >= bottom && std::min(m_edges[e].y0, m_edges[e].y1) <= top)
+          m_slab_edges.push_back(e);
+      m_slabs.push_back(std::make_pair(begin, uint32_t(m_slab_edges.size())));
+    }
+    m_areas.push_back(area);
+  }
+
+  buildTree();
+}
+
+// Sort-Tile-Recursive packing, one level at a time from the areas up.
+void GeofenceEngine::buildTree()
+{
+  m_nodes.clear();
+  m_children.clear();
+  m_root = -1;
+
+  std::vector<std::pair<Box, uint32_t> > entries;
+  for(uint32_t i = 0; i < m_areas.size(); i++)
+    entries.push_back(std::make_pair(m_areas[i].box, i));
+  if(entries.empty())
+    return;
+
+  auto center_x = [](const std::pair<Box, uint32_t>& e){return e.first.min_x + e.first.max_x;};
+  auto center_y = [](const std::pair<Box, uint32_t>& e){return e.first.min_y + e.first.max_y;};
+
+  bool leaf = true;
+  while(true)
+  {
+    std::size_t node_count = (entries.size()+node_capacity-1)/node_capacity;
+    std::size_t slice_size = std::ceil(std::sqrt(double(node_count)))*node_capacity;
+    std::sort(entries.begin(), entries.end(), [&](const std::pair<Box, uint32_t>& a, const std::pair<Box, uint32_t>& b){return center_x(a) < center_x(b);});
+    for(std::size_t s = 0; s < entries.size(); s += slice_size)
+      std::sort(entries.begin()+s, entries.begin()+std::min(s+slice_size, entries.size()), [&](const std::pair<Box, uint32_t>& a, const std::pair<Box, uint32_t>& b){return center_y(a) < center_y(b);});
+
+    std::vector<std::pair<Box, uint32_t> > parents;
+    for(std::size_t i = 0; i < entries.size(); i += node_capacity)
+    {
+      Node node;
+      node.leaf = leaf;
+      node.first = m_children.size();
+      node.count = std::min(node_capacity, entries.size()-i);
+      node.box = entries[i].first;
+      for(std::size_t j = i; j < i+node.count; j++)
+      {
+        m_children.push_back(entries[j].second);
+        const Box& b = entries[j].first;
+        node.box = {std::min(node.box.min_x, b.min_x), std::min(node.box.min_y, b.min_y), std::max(node.box.max_x, b.max_x), std::max(node.box.max_y, b.max_y)};
+      }
+      parents.push_back(std::make_pair(node.box, uint32_t(m_nodes.size())));
+      m_nodes.push_back(node);
+    }
+    entries.swap(parents);
+    leaf = false;
+    if(entries.size() == 1)
+      break;
+  }
+  m_root = entries.front().second;
+}
+
+void GeofenceEngine::query(const Box& box) const
+{
+  m_candidates.clear();
+  if(m_root < 0)
+    return;
+  m_stack.clear();
+  m_stack.push_back(m_root);
+  while(!m_stack.empty())
+  {
+    const Node& node = m_nodes[m_stack.back()];
+    m_stack.pop_back();
+    for(uint32_t i = node.first; i < node.first+node.count; i++)
+    {
+      const Box& b = node.leaf ? m_areas[m_children[i]].box : m_nodes[m_children[i]].box;
+      if(b.max_x < box.min_x || b.min_x > box.max_x || b.max_y < box.min_y || b.min_y > box.max_y)
+        continue;
+      if(node.leaf)
+        m_candidates.push_back(m_children[i]);
+      else
+        m_stack.push_back(m_children[i]);
+    }
+  }
+}
+
+bool GeofenceEngine::inside(const Area& area, float x, float y) const
+{
+  if(x < area.box.min_x || x > area.box.max_x || y < area.box.min_y || y > area.box.max_y)
+    return false;
+  if(area.circle)
+    return std::hypot(x-area.center_x, y-area.center_y) <= area.radius;
+
+  // Crossings of a ray going east.
+  uint32_t slab = std::min<uint32_t>((y - area.box.min_y)/area.slab_height, area.slab_count-1);
+  const auto& range = m_slabs[area.first_slab+slab];
+  bool in = false;
+  for(uint32_t i = range.first; i < range.second; i++)
+  {
+    const Edge& e = m_edges[m_slab_edges[i]];
+    if((e.y0 > y) != (e.y1 > y) && x < e.x0 + (y-e.y0)*(e.x1-e.x0)/(e.y1-e.y0))
+      in = !in;
+  }
+  return in;
+}
+
+float GeofenceEngine::entry(const Area& area, float x, float y, float dx, float dy) const
+{
+  if(area.circle)
+  {
+    float fx = x - area.center_x;
+    float fy = y - area.center_y;
+    float a = dx*dx + dy*dy;
+    float b = 2.0f*(fx*dx + fy*dy);
+    float c = fx*fx + fy*fy - area.radius*area.radius;
+    float discriminant = b*b - 4.0f*a*c;
+    if(a <= 0.0f || discriminant < 0.0f)
+      return -1.0f;
+    float t = (-b - std::sqrt(discriminant))/(2.0f*a);
+    return t >= 0.0f && t <= 1.0f ? t : -1.0f;
+  }
+
+  // Only the slabs the segment spans.
+  float low = std::max(std::min(y, y+dy), area.box.min_y);
+  float high = std::min(std::max(y, y+dy), area.box.max_y);
+  if(low > high)
+    return -1.0f;
+  uint32_t first = std::min<uint32_t>((low - area.box.min_y)/area.slab_height, area.slab_count-1);
+  uint32_t last = std::min<uint32_t>((high - area.box.min_y)/area.slab_height, area.slab_count-1);
+
+  float best = -1.0f;
+  for(uint32_t slab = first; slab <= last; slab++)
+  {
+    const auto& range = m_slabs[area.first_slab+slab];
+    for(uint32_t i = range.first; i < range.second; i++)
+    {
+      const Edge& e = m_edges[m_slab_edges[i]];
+      float ex = e.x1 - e.x0;
+      float ey = e.y1 - e.y0;
+      float denominator = dx*ey - dy*ex;
+      if(std::fabs(denominator) < 1.0e-9f)
+        continue;
+      float wx = e.x0 - x;
+      float wy = e.y0 - y;
+      float t = (wx*ey - wy*ex)/denominator;
+      float u = (wx*dy - wy*dx)/denominator;
+      if(t >= 0.0f && t <= 1.0f && u >= 0.0f && u <= 1.0f && (best < 0.0f || t < best))
+        best = t;
+    }
+  }
+  return best;
+}
+
+bool GeofenceEngine::check(double latitude, double longitude, double cog, double sog, GeofenceHit& hit) const
+{
+  if(m_areas.empty() || std::isnan(latitude) || std::isnan(longitude))
+    return false;
+
+  float x, y;
+  project(latitude, longitude, x, y);
+  float dx = 0.0f;
+  float dy = 0.0f;
+  if(!std::isnan(cog) && !std::isnan(sog) && sog > 0.0)
+  {
+    dx = sog*sin(cog*M_PI/180.0)*m_horizon;
+    dy = sog*cos(cog*M_PI/180.0)*m_horizon;
+  }
+
+  query({std::min(x, x+dx), std::min(y, y+dy), std::max(x, x+dx), std::max(y, y+dy)});
+
+  float best = -1.0f;
+  for(auto a: m_candidates)
+  {
+    const Area& area = m_areas[a];
+    if(inside(area, x, y))
+    {
+      hit.area = a;
+      hit.time = 0.0f;
+      return true;
+    }
+    float t = entry(area, x, y, dx, dy);
+    if(t >= 0.0f && (best < 0.0f || t < best))
+    {
+      best = t;
+      hit.area = a;
+    }
+  }
+  if(best < 0.0f)
+    return false;
+  hit.time = best*m_horizon;
+  return true;
+}
+
+GeofenceMonitor::GeofenceMonitor(QObject* parent): QObject(parent)
+{
+  m_engine.setHorizon(ros::param::param<double>("~geofence_horizon_seconds", 600.0));
+  m_clock.start();
+
+  QTimer* timer = new QTimer(this);
+  connect(timer, &QTimer::timeout, this, &GeofenceMonitor::expireAlerts);
+  timer->start(10000);
+}
+
+void GeofenceMonitor::setProject(AutonomousVehicleProject* project)
+{
+  if(m_project)
+    disconnect(m_project, nullptr, this, nullptr);
+  m_project = project;
+  if(project)
+    connect(project, &AutonomousVehicleProject::avoidAreasChanged, this, &GeofenceMonitor::updateAreas);
+  updateAreas();
+}
+
+void GeofenceMonitor::updateAreas()
+{
+  for(auto area: m_areas)
+    if(area)
+      area->setAlert(false);
+  m_areas.clear();
+  m_alerts.clear();
+
+  std::vector<std::vector<QGeoCoordinate> > polygons;
+  if(m_project)
+    for(auto area: m_project->avoidAreas())
+    {
+      std::vector<QGeoCoordinate> polygon;
+      for(auto point: area->points())
+        polygon.push_back(point->location());
+      // Same as the engine skips.
+      if(polygon.size() < 2)
+        continue;
+      polygons.push_back(polygon);
+      m_areas.push_back(area);
+    }
+  m_area_alerts.assign(m_areas.size(), 0);
+  m_engine.setAreas(polygons);
+}
+
+void GeofenceMonitor::update(const QString& key, const QString& name, const QGeoCoordinate& position, double cog, double sog)
+{
+  if(m_areas.empty())
+    return;
+
+  GeofenceHit hit;
+  bool found = m_engine.check(position.latitude(), position.longitude(), cog, sog, hit);
+  auto alert = m_alerts.find(key);
+  if(!found)
+  {
+    if(alert != m_alerts.end())
+      clearAlert(alert);
+    return;
+  }
+
+  bool inside = hit.time == 0.0f;
+  if(alert != m_alerts.end() && alert->second.area == hit.area)
+  {
+    alert->second.last_update = m_clock.elapsed();
+    // Only going in is news, leaving and heading back isn't.
+    bool entered = inside && !alert->second.inside;
+    alert->second.inside = inside;
+    if(!entered)
+      return;
+  }
+  else
+  {
+    if(alert != m_alerts.end())
+      clearAlert(alert);
+    m_alerts[key] = {hit.area, inside, m_clock.elapsed()};
+    setAreaAlert(hit.area, 1);
+  }
+
+  auto area = m_areas[hit.area];
+  emit geofenceAlert(key, name, area ? area->objectName() : QString(), hit.time);
+}
+
+void GeofenceMonitor::clearAlert(std::map<QString, Alert>::iterator alert)
+{
+  setAreaAlert(alert->second.area, -1);
+  m_alerts.erase(alert);
+}
+
+void GeofenceMonitor::setAreaAlert(int area, int change)
+{
+  bool was_alerted = m_area_alerts[area] > 0;
+  m_area_alerts[area] += change;
+  bool alerted = m_area_alerts[area] > 0;
+  if(alerted != was_alerted && m_areas[area])
+    m_areas[area]->setAlert(alerted);
+}
+
+void GeofenceMonitor::expireAlerts()
+{
+  qint64 now = m_clock.elapsed();
+  auto alert = m_alerts.begin();
+  while(alert != m_alerts.end())
+  {
+    auto next = std::next(alert);
+    if(now - alert->second.last_update > alert_timeout_ms)
+      clearAlert(alert);
+    alert = next;
+  }
+}
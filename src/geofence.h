@@ -0,0 +1,158 @@
+#ifndef CAMP_GEOFENCE_H
+#define CAMP_GEOFENCE_H
+
+#include <QGeoCoordinate>
+#include <QObject>
+#include <QPointer>
+#include <QElapsedTimer>
+#include <map>
+#include <vector>
+
+class AutonomousVehicleProject;
+class AvoidArea;
+
+// An area an object is in or predicted to enter.
+struct GeofenceHit
+{
+  // Index of the area in the order given to setAreas().
+  int area;
+  // Seconds until the object enters the area, 0 if it's inside.
+  float time;
+};
+
+// Checks positions against a fixed set of areas, fast enough to run on
+// every fix.
+//
+// The areas are prepared once when they are set. They are projected
+// onto a local east-north plane centered on them, their bounding boxes
+// are packed into an R-tree, and each polygon's edges are bucketed
+// into horizontal slabs so a point or segment only visits the edges at
+// its latitude. Areas with two vertices are circles around the first,
+// the way AvoidArea draws them.
+class GeofenceEngine
+{
+public:
+  // Vertices in order, in degrees.
+  void setAreas(const std::vector<std::vector<QGeoCoordinate> >& areas);
+  int areaCount() const;
+
+  // How far ahead to look for areas an object is heading into.
+  void setHorizon(double seconds);
+
+  // Course in degrees clockwise from north and speed in m/s. Returns
+  // false if the object is clear of all areas for the horizon. An
+  // area the object is inside wins over those it's heading into.
+  bool check(double latitude, double longitude, double cog, double sog, GeofenceHit& hit) const;
+
+private:
+  struct Box
+  {
+    float min_x, min_y, max_x, max_y;
+  };
+
+  struct Edge
+  {
+    float x0, y0, x1, y1;
+  };
+
+  struct Area
+  {
+    Box box;
+    bool circle;
+    float center_x, center_y, radius;
+    // The area's slabs in m_slabs.
+    uint32_t first_slab, slab_count;
+    float slab_height;
+  };
+
+  struct Node
+  {
+    Box box;
+    // Children in m_children, areas for leaves and nodes otherwise.
+    uint32_t first, count;
+    bool leaf;
+  };
+
+  void project(double latitude, double longitude, float& x, float& y) const;
+  void buildTree();
+  // Appends the areas whose boxes overlap box to m_candidates.
+  void query(const Box& box) const;
+
+  bool inside(const Area& area, float x, float y) const;
+  // Fraction of the segment from (x, y) to (x+dx, y+dy) at which it
+  // first crosses into the area, or a negative number if it doesn't.
+  float entry(const Area& area, float x, float y, float dx, float dy) const;
+
+  double m_horizon = 600.0;
+
+  double m_origin_latitude = 0.0;
+  double m_origin_longitude = 0.0;
+  double m_meters_per_degree_latitude = 0.0;
+  double m_meters_per_degree_longitude = 0.0;
+
+  std::vector<Area> m_areas;
+  std::vector<Edge> m_edges;
+  // Edges crossing each slab, as ranges of m_slab_edges.
+  std::vector<std::pair<uint32_t, uint32_t> > m_slabs;
+  std::vector<uint32_t> m_slab_edges;
+
+  std::vector<Node> m_nodes;
+  std::vector<uint32_t> m_children;
+  int m_root = -1;
+
+  // Reused between checks.
+  mutable std::vector<uint32_t> m_candidates;
+  mutable std::vector<uint32_t> m_stack;
+};
+
+// Watches our platforms and AIS contacts against the project's avoid
+// areas. An alert is raised when an object enters an area or is
+// predicted to, and the area is highlighted until no object is in or
+// heading into it.
+class GeofenceMonitor: public QObject
+{
+  Q_OBJECT
+public:
+  explicit GeofenceMonitor(QObject* parent = nullptr);
+
+  void setProject(AutonomousVehicleProject* project);
+
+  // Checks a position update. key identifies the platform or contact
+  // for as long as it exists, name is what alerts call it.
+  void update(const QString& key, const QString& name, const QGeoCoordinate& position, double cog, double sog);
+
+signals:
+  // key and name are as passed to update. seconds is 0 when the
+  // object is inside area.
+  void geofenceAlert(QString key, QString name, QString area, double seconds);
+
+public slots:
+  // Prepares the project's avoid areas.
+  void updateAreas();
+
+private slots:
+  // Forgets objects that stopped reporting.
+  void expireAlerts();
+
+private:
+  struct Alert
+  {
+    int area;
+    bool inside;
+    qint64 last_update;
+  };
+
+  void clearAlert(std::map<QString, Alert>::iterator alert);
+  void setAreaAlert(int area, int change);
+
+  AutonomousVehicleProject* m_project = nullptr;
+  GeofenceEngine m_engine;
+  std::vector<QPointer<AvoidArea> > m_areas;
+  // Objects alerted on each area.
+  std::vector<int> m_area_alerts;
+  // By object key.
+  std::map<QString, Alert> m_alerts;
+  QElapsedTimer m_clock;
+};
+
+#endif
@@ -32,6 +32,7 @@ public:
         SearchPatternType,
         GridType,
         AvoidAreaType,
+        AISDensityType,
     };
     
     GeoGraphicsItem(QGraphicsItem *parentItem = Q_NULLPTR);
@@ -6,7 +6,7 @@
 
 #include <QDebug>
 
-Georeferenced::Georeferenced(): m_geoTransform{0.0,1.0,0.0,0.0,0.0,1.0}, m_inverseGeoTransform{0.0,1.0,0.0,0.0,0.0,1.0}, m_projectTransformation(0), m_unprojectTransformation(0)
+Georeferenced::Georeferenced(): m_geoTransform{0.0,1.0,0.0,0.0,0.0,1.0}, m_inverseGeoTransform{0.0,1.0,0.0,0.0,0.0,1.0}, m_projectTransformation(0), m_unprojectTransformation(0), m_batchProjectTransformation(0)
 {
 
 }
@@ -47,6 +47,7 @@ void Georeferenced::extractGeoreference(GDALDataset *dataset)
 
         m_unprojectTransformation = OGRCreateCoordinateTransformation(&projected,&wgs84);
         m_projectTransformation = OGRCreateCoordinateTransformation(&wgs84,&projected);
+        m_batchProjectTransformation = OGRCreateCoordinateTransformation(&wgs84,&projected);
     }
 }
 
@@ -86,6 +87,26 @@ QPointF Georeferenced::geoToPixel(const QGeoCoordinate &point) const
     return projectedPointToPixel(project(point));
 }
 
+void Georeferenced::geoToPixel(std::size_t count, double *x, double *y) const
+{
+    std::lock_guard<std::mutex> lock(m_batchMutex);
+    bool geographic = false;
+    if(m_batchProjectTransformation)
+    {
+        m_batchProjectTransformation->Transform(count,x,y);
+        geographic = m_batchProjectTransformation->GetTargetCS()->IsGeographic();
+    }
+    for(std::size_t i = 0; i < count; i++)
+    {
+        QPointF projected;
+        if(m_batchProjectTransformation)
+            projected = geographic ? QPointF(y[i],x[i]) : QPointF(x[i],y[i]);
+        QPointF pixel = projectedPointToPixel(projected);
+        x[i] = pixel.x();
+        y[i] = pixel.y();
+    }
+}
+
 QGeoCoordinate Georeferenced::pixelToGeo(const QPointF &point) const
 {
     return unproject(pixelToProjectedPoint(point));
@@ -3,6 +3,7 @@
 
 #include <QPointF>
 #include <QGeoCoordinate>
+#include <mutex>
 class GDALDataset;
 class OGRCoordinateTransformation;
 
@@ -16,6 +17,10 @@ public:
     QGeoCoordinate unproject(QPointF const &point) const;
     QPointF geoToPixel(QGeoCoordinate const &point) const;
     QGeoCoordinate pixelToGeo(QPointF const &point) const;
+    // Converts count positions to pixels in place, latitudes in x and
+    // longitudes in y, with a single transformation call. Unlike the
+    // other conversions, it may be called from any thread.
+    void geoToPixel(std::size_t count, double *x, double *y) const;
     QString const &projection() const;
 protected:
     void extractGeoreference(GDALDataset *dataset);
@@ -23,6 +28,10 @@ private:
     double m_geoTransform[6];
     double m_inverseGeoTransform[6];
     OGRCoordinateTransformation *m_projectTransformation,*m_unprojectTransformation;
+    // Separate from m_projectTransformation since transformations can't
+    // be shared between threads.
+    OGRCoordinateTransformation *m_batchProjectTransformation;
+    mutable std::mutex m_batchMutex;
     QString m_projection;
 };
 
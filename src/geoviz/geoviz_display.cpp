@@ -1,230 +1,235 @@
 #include "geoviz_display.h"
+#include "geoviz_item.h"
+#include "backgroundraster.h"
 #include <QPainter>
+#include <algorithm>
 
-GeovizDisplay::GeovizDisplay(QWidget* parent, QGraphicsItem *parentItem):QWidget(parent), GeoGraphicsItem(parentItem)
+namespace geoviz
+{
+
+bool operator==(const PointList& a, const PointList& b)
+{
+  return a.color == b.color && a.size == b.size && a.points == b.points;
+}
+
+bool operator==(const Polygon& a, const Polygon& b)
+{
+  return a.fill_color == b.fill_color && a.edge_color == b.edge_color && a.edge_size == b.edge_size && a.outer == b.outer && a.inner == b.inner;
+}
+
+bool operator==(const Item& a, const Item& b)
 {
+  return a.id == b.id && a.label == b.label && a.label_position == b.label_position && a.point_groups == b.point_groups && a.lines == b.lines && a.polygons == b.polygons;
+}
+
+} // namespace geoviz
 
+namespace
+{
+
+template<typename T> QColor color(const T& message_color)
+{
+  QColor ret;
+  ret.setRedF(message_color.r);
+  ret.setGreenF(message_color.g);
+  ret.setBlueF(message_color.b);
+  ret.setAlphaF(message_color.a);
+  return ret;
+}
+
+template<typename T> std::vector<QGeoCoordinate> coordinates(const T& points)
+{
+  std::vector<QGeoCoordinate> ret;
+  ret.reserve(points.size());
+  for(const auto& p: points)
+    ret.push_back(QGeoCoordinate(p.latitude, p.longitude));
+  return ret;
+}
+
+} // namespace
+
+GeovizDisplay::GeovizDisplay(QWidget* parent, QGraphicsItem *parentItem):QWidget(parent), GeoGraphicsItem(parentItem)
+{
+  setFlag(QGraphicsItem::ItemHasNoContents);
 }
 
 
 void GeovizDisplay::updateRobotNamespace(QString robotNamespace)
 {
+  updateProjection();
   ros::NodeHandle nh;
   m_display_subscriber = nh.subscribe("/"+robotNamespace.toStdString()+"/project11/display", 10, &GeovizDisplay::geoVizDisplayCallback, this);
 }
 
 QRectF GeovizDisplay::boundingRect() const
 {
-  return shape().boundingRect();
+  return QRectF();
 }
 
 void GeovizDisplay::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget)
 {
-  painter->save();
+}
 
-  QPen p;
-  p.setCosmetic(true);
+void GeovizDisplay::updateProjection()
+{
+  std::lock_guard<std::mutex> lock(m_projection_mutex);
+  m_background = findParentBackgroundRaster();
+  m_projection_offset = parentItem() ? parentItem()->scenePos() : QPointF();
+  m_projection_generation++;
+}
 
-  for(auto display_item: m_display_items)
+std::shared_ptr<const geoviz::Geometry> GeovizDisplay::buildGeometry(const geoviz::Item& item) const
+{
+  auto geometry = std::make_shared<geoviz::Geometry>();
+
+  // Every position in one pair of arrays, latitudes in x and
+  // longitudes in y, in the order they're used below.
+  std::vector<double> x, y;
+  auto gather = [&](const std::vector<QGeoCoordinate>& points)
+  {
+    for(const auto& p: points)
+    {
+      x.push_back(p.latitude());
+      y.push_back(p.longitude());
+    }
+  };
+  for(const auto& point_group: item.point_groups)
+    gather(point_group.points);
+  for(const auto& line: item.lines)
+    gather(line.points);
+  for(const auto& polygon: item.polygons)
   {
-      for (auto point_group: display_item.second->point_groups)
-      {
-          p.setColor(point_group.color);
-          p.setWidth(point_group.size);
-          painter->setPen(p);
-          for(auto point: point_group.points)
-              painter->drawPoint(point.pos);
-      }
-      
-      for(auto line: display_item.second->lines)
-      {
-          p.setColor(line.color);
-          p.setWidth(line.size);
-          painter->setPen(p);
-          painter->drawPath(shape(line.points));
-      }
-      
-      for(auto polygon: display_item.second->polygons)
-      {
-          p.setColor(polygon.edge_color);
-          p.setWidth(polygon.edge_size);
-          painter->setPen(p);
-          painter->setBrush(QBrush(polygon.fill_color));
-          painter->drawPath(polygon.path);
-      }
-      painter->setBrush(Qt::NoBrush);
+    gather(polygon.outer);
+    for(const auto& inner: polygon.inner)
+      gather(inner);
   }
 
-  painter->restore();
-}
-
-QPainterPath GeovizDisplay::shape() const
-{
-  QPainterPath ret;
-    
-  for(auto display_item: m_display_items)
   {
-      for(auto plist: display_item.second->point_groups)
-      {
-          for(auto p: plist.points)
-              ret.addEllipse(p.pos,plist.size,plist.size);
-      }
-      for(auto line: display_item.second->lines)
-      {
-          ret.addPath(shape(line.points));
-      }
-      for(auto polygon: display_item.second->polygons)
-      {
-          ret.addPath(polygon.path);
-      }
+    std::lock_guard<std::mutex> lock(m_projection_mutex);
+    geometry->generation = m_projection_generation;
+    if(!m_background)
+      return geometry;
+    m_background->geoToPixel(x.size(), x.data(), y.data());
+    for(std::size_t i = 0; i < x.size(); i++)
+    {
+      x[i] -= m_projection_offset.x();
+      y[i] -= m_projection_offset.y();
+    }
   }
 
-  return ret;
-}
+  std::size_t next = 0;
+  auto polygon = [&](const std::vector<QGeoCoordinate>& points)
+  {
+    QPolygonF ret;
+    ret.reserve(points.size());
+    for(std::size_t i = 0; i < points.size(); i++, next++)
+      ret << QPointF(x[next], y[next]);
+    return ret;
+  };
+
+  // Pens are cosmetic so their width doesn't scale, the margin only
+  // has to cover them at the background's own resolution.
+  float margin = 1.0;
+
+  for(const auto& point_group: item.point_groups)
+  {
+    geometry->point_groups.push_back(polygon(point_group.points));
+    for(const auto& p: geometry->point_groups.back())
+      geometry->shape.addEllipse(p, point_group.size, point_group.size);
+    margin = std::max(margin, point_group.size);
+  }
 
-QPainterPath GeovizDisplay::shape(std::vector<LocationPosition> const &lps) const
-{
-  QPainterPath ret;
-  if(lps.size() > 1)
+  for(const auto& line: item.lines)
   {
-    auto p = lps.begin();
-    ret.moveTo(p->pos);
-    p++;
-    while(p != lps.end())
+    geometry->lines.push_back(polygon(line.points));
+    if(geometry->lines.back().size() > 1)
     {
-      ret.lineTo(p->pos);
-      p++;
+      QPainterPath path;
+      path.addPolygon(geometry->lines.back());
+      geometry->shape.addPath(path);
     }
+    margin = std::max(margin, line.size);
   }
-  return ret;
+
+  for(const auto& p: item.polygons)
+  {
+    QPainterPath path;
+    path.addPolygon(polygon(p.outer));
+    QPainterPath inner_path;
+    for(const auto& inner: p.inner)
+      inner_path.addPolygon(polygon(inner));
+    if(!inner_path.isEmpty())
+      path = path.subtracted(inner_path);
+    geometry->polygons.push_back(path);
+    geometry->shape.addPath(path);
+    margin = std::max(margin, p.edge_size);
+  }
+
+  geometry->bounding_rect = geometry->shape.boundingRect().marginsAdded(QMarginsF(margin, margin, margin, margin));
+  return geometry;
 }
 
 void GeovizDisplay::geoVizDisplayCallback(const geographic_visualization_msgs::GeoVizItem::ConstPtr& message)
 {
-  BackgroundRaster* bgr = findParentBackgroundRaster();
-  geoviz::Item *item = new geoviz::Item();
+  auto item = std::make_shared<geoviz::Item>();
   item->id = message->id;
   item->label = message->label;
-  item->label_position.location.setLatitude(message->label_position.latitude);
-  item->label_position.location.setLongitude(message->label_position.longitude);
-  item->label_position.pos = geoToPixel(item->label_position.location, bgr);
-  for(auto pg: message->point_groups)
+  item->label_position = QGeoCoordinate(message->label_position.latitude, message->label_position.longitude);
+  for(const auto& pg: message->point_groups)
   {
     geoviz::PointList pl;
-    pl.color.setRedF(pg.color.r);
-    pl.color.setGreenF(pg.color.g);
-    pl.color.setBlueF(pg.color.b);
-    pl.color.setAlphaF(pg.color.a);
+    pl.color = color(pg.color);
     pl.size = pg.size;
-    
-    for(auto p: pg.points)
-    {
-      LocationPosition lp;
-      lp.location.setLatitude(p.latitude);
-      lp.location.setLongitude(p.longitude);
-      lp.pos = geoToPixel(lp.location,bgr);
-      pl.points.push_back(lp);
-    }
+    pl.points = coordinates(pg.points);
     item->point_groups.push_back(pl);
   }
-  for(auto l: message->lines)
+  for(const auto& l: message->lines)
   {
     geoviz::PointList pl;
-    pl.color.setRedF(l.color.r);
-    pl.color.setGreenF(l.color.g);
-    pl.color.setBlueF(l.color.b);
-    pl.color.setAlphaF(l.color.a);
+    pl.color = color(l.color);
     pl.size = l.size;
-    
-    for(auto p: l.points)
-    {
-        LocationPosition lp;
-        lp.location.setLatitude(p.latitude);
-        lp.location.setLongitude(p.longitude);
-        lp.pos = geoToPixel(lp.location, bgr);
-        pl.points.push_back(lp);
-    }
+    pl.points = coordinates(l.points);
     item->lines.push_back(pl);
   }
-  for(auto p: message->polygons)
+  for(const auto& p: message->polygons)
   {
     geoviz::Polygon polygon;
-    QPolygonF qPoly;
-    for(auto op: p.outer.points) // outer points
-    {
-      LocationPosition lp;
-      lp.location.setLatitude(op.latitude);
-      lp.location.setLongitude(op.longitude);
-      lp.pos = geoToPixel(lp.location, bgr);
-      qPoly << lp.pos;
-      polygon.outer.push_back(lp);
-    }
-    polygon.path.addPolygon(qPoly);
-    QPainterPath innerPath;
-    for(auto ir: p.inner) //inner rings
-    {
-      polygon.inner.push_back(std::vector<LocationPosition>());
-      QPolygonF innerPoly;
-      for(auto ip: ir.points) // inner ring points
-      {
-        LocationPosition lp;
-        lp.location.setLatitude(ip.latitude);
-        lp.location.setLongitude(ip.longitude);
-        lp.pos = geoToPixel(lp.location, bgr);
-        innerPoly << lp.pos;
-        polygon.inner.back().push_back(lp);
-      }
-      innerPath.addPolygon(innerPoly);
-    }
-    polygon.path = polygon.path.subtracted(innerPath);
-    polygon.fill_color.setRedF(p.fill_color.r);
-    polygon.fill_color.setGreenF(p.fill_color.g);
-    polygon.fill_color.setBlueF(p.fill_color.b);
-    polygon.fill_color.setAlphaF(p.fill_color.a);
-    polygon.edge_color.setRedF(p.edge_color.r);
-    polygon.edge_color.setGreenF(p.edge_color.g);
-    polygon.edge_color.setBlueF(p.edge_color.b);
-    polygon.edge_color.setAlphaF(p.edge_color.a);
+    polygon.outer = coordinates(p.outer.points);
+    for(const auto& ir: p.inner)
+      polygon.inner.push_back(coordinates(ir.points));
+    polygon.fill_color = color(p.fill_color);
+    polygon.edge_color = color(p.edge_color);
     polygon.edge_size = p.edge_size;
     item->polygons.push_back(polygon);
   }
-    
-  QMetaObject::invokeMethod(this,"updateDisplayItem", Qt::QueuedConnection, Q_ARG(geoviz::Item*, item));
+
+  // Robots often republish items that haven't changed.
+  auto& received = m_received_items[item->id];
+  if(received && *received == *item)
+    return;
+  received = item;
+
+  std::shared_ptr<const geoviz::Item> display_item = item;
+  auto geometry = buildGeometry(*display_item);
+  QMetaObject::invokeMethod(this, [=](){updateDisplayItem(display_item, geometry);}, Qt::QueuedConnection);
 }
 
-void GeovizDisplay::updateDisplayItem(geoviz::Item *item)
+void GeovizDisplay::updateDisplayItem(std::shared_ptr<const geoviz::Item> item, std::shared_ptr<const geoviz::Geometry> geometry)
 {
-  prepareGeometryChange();
-  m_display_items[item->id] = std::shared_ptr<geoviz::Item>(item);
+  // Built just before the background changed.
+  if(geometry->generation != m_projection_generation)
+    geometry = buildGeometry(*item);
+
+  auto existing = m_display_items.find(item->id);
+  if(existing == m_display_items.end())
+    m_display_items[item->id] = new GeovizItem(item, geometry, this);
+  else
+    existing->second->setItem(item, geometry);
 }
 
 void GeovizDisplay::updateProjectedPoints()
 {
-  prepareGeometryChange();
-  BackgroundRaster* bgr = findParentBackgroundRaster();
-
-  for(std::pair<std::string, std::shared_ptr<geoviz::Item> > display_item: m_display_items)
-  {
-    display_item.second->label_position.pos = geoToPixel(display_item.second->label_position.location,bgr);
-    for(auto pl: display_item.second->point_groups)
-    {
-      for(auto& p: pl.points)
-        p.pos = geoToPixel(p.location, bgr);
-    }
-    for(auto& l: display_item.second->lines)
-    {
-      for(auto& p: l.points)
-      {
-        p.pos = geoToPixel(p.location, bgr);
-      }
-    }
-    for(auto& poly: display_item.second->polygons)
-    {
-      for(auto& op: poly.outer)
-        op.pos = geoToPixel(op.location, bgr);
-      for(auto& ir: poly.inner)
-        for(auto& ip: ir)
-          ip.pos = geoToPixel(ip.location, bgr);
-    }
-  } 
-}
\ No newline at end of file
+  updateProjection();
+  for(auto display_item: m_display_items)
+    display_item.second->setItem(display_item.second->item(), buildGeometry(*display_item.second->item()));
+}
@@ -3,44 +3,70 @@
 
 #include <QWidget>
 #include <QColor>
+#include <QPainterPath>
+#include <memory>
+#include <mutex>
 #include "ros/ros.h"
 #include "geographic_visualization_msgs/GeoVizItem.h"
 
 #include "geographicsitem.h"
-#include "locationposition.h"
+
+class GeovizItem;
 
 namespace geoviz
 {
   struct PointList
   {
-    std::vector<LocationPosition> points;
+    std::vector<QGeoCoordinate> points;
     QColor color;
     float size;
   };
 
   struct Polygon
   {
-    std::vector<LocationPosition> outer;
-    std::vector<std::vector<LocationPosition> > inner;
-    QPainterPath path;
+    std::vector<QGeoCoordinate> outer;
+    std::vector<std::vector<QGeoCoordinate> > inner;
     QColor fill_color;
     QColor edge_color;
     float edge_size;
   };
 
-  struct Item: public QObject
+  struct Item
   {
-    Q_OBJECT
-  public:
     std::string id;
     std::string label;
-    LocationPosition label_position;
+    QGeoCoordinate label_position;
     std::vector<PointList> point_groups;
     std::vector<PointList> lines;
     std::vector<Polygon> polygons;
   };
+
+  bool operator==(const PointList& a, const PointList& b);
+  bool operator==(const Polygon& a, const Polygon& b);
+  bool operator==(const Item& a, const Item& b);
+
+  // An Item projected onto the background, ready to draw. Parallel to
+  // the item's point groups, lines and polygons.
+  struct Geometry
+  {
+    std::vector<QPolygonF> point_groups;
+    std::vector<QPolygonF> lines;
+    std::vector<QPainterPath> polygons;
+    QPainterPath shape;
+    QRectF bounding_rect;
+    // Projection it was built with, see GeovizDisplay.
+    uint64_t generation = 0;
+  };
 }
 
+// Shows the items a robot publishes for display.
+//
+// Messages are converted on the ROS callback thread: every position in
+// the message is projected in one batched call and the paths and
+// bounds are built there too. The GUI thread only swaps the finished,
+// immutable item and geometry into the item's GeovizItem. Messages
+// identical to the last one for their id are dropped before reaching
+// the GUI.
 class GeovizDisplay: public QWidget, public GeoGraphicsItem
 {
   Q_OBJECT
@@ -52,23 +78,42 @@ public:
 
   int type() const override {return GeovizDisplayType;}
 
+  // Each display item is a child GeovizItem, this only groups them.
   QRectF boundingRect() const override;
   void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget) override;
-  QPainterPath shape() const override;
-  QPainterPath shape(std::vector<LocationPosition> const &lps) const;
-  
+
+  // Projects item with the current background. Safe to call from any
+  // thread.
+  std::shared_ptr<const geoviz::Geometry> buildGeometry(const geoviz::Item& item) const;
+
 public slots:
   void updateRobotNamespace(QString robot_namespace);
-  void updateDisplayItem(geoviz::Item *item);
   void updateProjectedPoints();
 
 
 private:
   void geoVizDisplayCallback(const geographic_visualization_msgs::GeoVizItem::ConstPtr& message);
+  void updateDisplayItem(std::shared_ptr<const geoviz::Item> item, std::shared_ptr<const geoviz::Geometry> geometry);
+
+  // Takes a snapshot of what buildGeometry needs from the scene, on the
+  // GUI thread.
+  void updateProjection();
 
   ros::Subscriber m_display_subscriber;
 
-  std::map<std::string,std::shared_ptr<geoviz::Item> > m_display_items;
+  std::map<std::string, GeovizItem*> m_display_items;
+
+  // Guards the projection snapshot.
+  mutable std::mutex m_projection_mutex;
+  BackgroundRaster* m_background = nullptr;
+  // Position of the parent item in the scene.
+  QPointF m_projection_offset;
+  // Bumped when the background changes, so geometry built with the
+  // previous one can be told apart.
+  uint64_t m_projection_generation = 0;
+
+  // Last item received for each id, only used on the callback thread.
+  std::map<std::string, std::shared_ptr<const geoviz::Item> > m_received_items;
 };
 
 #endif
@@ -0,0 +1,70 @@
+#include "geoviz_item.h"
+#include "geoviz_display.h"
+#include <QPainter>
+
+GeovizItem::GeovizItem(std::shared_ptr<const geoviz::Item> item, std::shared_ptr<const geoviz::Geometry> geometry, GeovizDisplay* display):
+  QGraphicsItem(display), m_item(item), m_geometry(geometry)
+{
+}
+
+QRectF GeovizItem::boundingRect() const
+{
+  return m_geometry->bounding_rect;
+}
+
+QPainterPath GeovizItem::shape() const
+{
+  return m_geometry->shape;
+}
+
+std::shared_ptr<const geoviz::Item> GeovizItem::item() const
+{
+  return m_item;
+}
+
+void GeovizItem::setItem(std::shared_ptr<const geoviz::Item> item, std::shared_ptr<const geoviz::Geometry> geometry)
+{
+  prepareGeometryChange();
+  m_item = item;
+  m_geometry = geometry;
+}
+
+void GeovizItem::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget)
+{
+  painter->save();
+
+  QPen p;
+  p.setCosmetic(true);
+
+  for(std::size_t i = 0; i < m_geometry->point_groups.size(); i++)
+  {
+    const auto& point_group = m_item->point_groups[i];
+    p.setColor(point_group.color);
+    p.setWidth(point_group.size);
+    painter->setPen(p);
+    painter->drawPoints(m_geometry->point_groups[i]);
+  }
+
+  for(std::size_t i = 0; i < m_geometry->lines.size(); i++)
+  {
+    const auto& line = m_item->lines[i];
+    if(m_geometry->lines[i].size() < 2)
+      continue;
+    p.setColor(line.color);
+    p.setWidth(line.size);
+    painter->setPen(p);
+    painter->drawPolyline(m_geometry->lines[i]);
+  }
+
+  for(std::size_t i = 0; i < m_geometry->polygons.size(); i++)
+  {
+    const auto& polygon = m_item->polygons[i];
+    p.setColor(polygon.edge_color);
+    p.setWidth(polygon.edge_size);
+    painter->setPen(p);
+    painter->setBrush(QBrush(polygon.fill_color));
+    painter->drawPath(m_geometry->polygons[i]);
+  }
+
+  painter->restore();
+}
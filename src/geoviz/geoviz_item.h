@@ -0,0 +1,36 @@
+#ifndef GEOVIZ_ITEM_H
+#define GEOVIZ_ITEM_H
+
+#include <QGraphicsItem>
+#include <memory>
+
+class GeovizDisplay;
+
+namespace geoviz
+{
+  struct Item;
+  struct Geometry;
+}
+
+// Draws one geoviz::Item from geometry built ahead of time by
+// GeovizDisplay, so painting is just drawing it and the scene can cull
+// items that are off screen.
+class GeovizItem: public QGraphicsItem
+{
+public:
+  GeovizItem(std::shared_ptr<const geoviz::Item> item, std::shared_ptr<const geoviz::Geometry> geometry, GeovizDisplay* display);
+
+  QRectF boundingRect() const override;
+  void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget) override;
+  QPainterPath shape() const override;
+
+  std::shared_ptr<const geoviz::Item> item() const;
+  // Swaps in a new version of the item.
+  void setItem(std::shared_ptr<const geoviz::Item> item, std::shared_ptr<const geoviz::Geometry> geometry);
+
+private:
+  std::shared_ptr<const geoviz::Item> m_item;
+  std::shared_ptr<const geoviz::Geometry> m_geometry;
+};
+
+#endif
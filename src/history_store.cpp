@@ -0,0 +1,243 @@
+#include "history_store.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+
+// Seconds of data time between trimming every entity.
+const double trim_interval = 60.0;
+
+// Interpolates angles in degrees the short way around.
+float interpolateAngle(float a, float b, double f)
+{
+  if(std::isnan(a))
+    return f < 0.5 ? a : b;
+  if(std::isnan(b))
+    return f < 0.5 ? a : b;
+  double difference = std::fmod(b - a + 540.0, 360.0) - 180.0;
+  return std::fmod(a + difference*f + 360.0, 360.0);
+}
+
+float interpolateValue(float a, float b, double f)
+{
+  if(std::isnan(a) || std::isnan(b))
+    return f < 0.5 ? a : b;
+  return a + (b-a)*f;
+}
+
+} // namespace
+
+HistoryStore::HistoryStore(QObject* parent): QObject(parent), m_trim_time(std::nan("")), m_start_time(std::nan("")), m_end_time(std::nan(""))
+{
+}
+
+int HistoryStore::entity(const QString& name)
+{
+  auto i = m_ids.find(name);
+  if(i != m_ids.end())
+    return i.value();
+  int id;
+  if(!m_free_ids.empty())
+  {
+    id = m_free_ids.back();
+    m_free_ids.pop_back();
+    m_names[id] = name;
+  }
+  else
+  {
+    id = m_entities.size();
+    m_entities.emplace_back();
+    m_names.push_back(name);
+  }
+  m_ids[name] = id;
+  return id;
+}
+
+QString HistoryStore::name(int entity) const
+{
+  return m_names[entity];
+}
+
+int HistoryStore::entityCount() const
+{
+  return m_entities.size();
+}
+
+HistoryStore::State HistoryStore::Columns::at(std::size_t i) const
+{
+  i += start;
+  return {time[i], latitude[i], longitude[i], heading[i], cog[i], sog[i]};
+}
+
+void HistoryStore::Columns::set(std::size_t i, const State& state)
+{
+  i += start;
+  time[i] = state.time;
+  latitude[i] = state.latitude;
+  longitude[i] = state.longitude;
+  heading[i] = state.heading;
+  cog[i] = state.cog;
+  sog[i] = state.sog;
+}
+
+void HistoryStore::Columns::insert(std::size_t i, const State& state)
+{
+  i += start;
+  time.insert(time.begin()+i, state.time);
+  latitude.insert(latitude.begin()+i, state.latitude);
+  longitude.insert(longitude.begin()+i, state.longitude);
+  heading.insert(heading.begin()+i, state.heading);
+  cog.insert(cog.begin()+i, state.cog);
+  sog.insert(sog.begin()+i, state.sog);
+}
+
+void HistoryStore::Columns::trim(double before)
+{
+  while(start < time.size() && time[start] < before)
+    start++;
+  // Erasing once half is dropped keeps trimming amortized O(1).
+  if(start > 1024 && start > time.size()/2)
+  {
+    time.erase(time.begin(), time.begin()+start);
+    latitude.erase(latitude.begin(), latitude.begin()+start);
+    longitude.erase(longitude.begin(), longitude.begin()+start);
+    heading.erase(heading.begin(), heading.begin()+start);
+    cog.erase(cog.begin(), cog.begin()+start);
+    sog.erase(sog.begin(), sog.begin()+start);
+    start = 0;
+  }
+}
+
+std::size_t HistoryStore::upperBound(const Columns& columns, double time)
+{
+  return std::upper_bound(columns.time.begin()+columns.start, columns.time.end(), time) - columns.time.begin() - columns.start;
+}
+
+void HistoryStore::add(int entity, const State& state)
+{
+  auto& columns = m_entities[entity];
+  if(columns.size() == 0 || state.time > columns.time.back())
+  {
+    columns.time.push_back(state.time);
+    columns.latitude.push_back(state.latitude);
+    columns.longitude.push_back(state.longitude);
+    columns.heading.push_back(state.heading);
+    columns.cog.push_back(state.cog);
+    columns.sog.push_back(state.sog);
+  }
+  else
+  {
+    std::size_t i = upperBound(columns, state.time);
+    if(i > 0 && columns.at(i-1).time == state.time)
+      columns.set(i-1, state);
+    else
+      columns.insert(i, state);
+  }
+
+  if(std::isnan(m_start_time) || state.time < m_start_time)
+    m_start_time = state.time;
+  if(std::isnan(m_end_time) || state.time > m_end_time)
+    m_end_time = state.time;
+
+  if(m_retention > 0.0)
+  {
+    columns.trim(m_end_time - m_retention);
+    m_start_time = std::max(m_start_time, m_end_time - m_retention);
+    if(std::isnan(m_trim_time) || m_end_time - m_trim_time > trim_interval)
+      trimAll(entity);
+  }
+}
+
+void HistoryStore::trimAll(int keep)
+{
+  m_trim_time = m_end_time;
+  double before = m_end_time - m_retention;
+  for(int i = 0; i < int(m_entities.size()); i++)
+  {
+    if(i == keep || m_names[i].isNull())
+      continue;
+    auto& columns = m_entities[i];
+    columns.trim(before);
+    if(columns.size() > 0)
+      continue;
+    // Replaced rather than cleared so the memory is released.
+    columns = Columns();
+    QString name = m_names[i];
+    m_ids.remove(name);
+    m_names[i] = QString();
+    m_free_ids.push_back(i);
+    emit entityRemoved(i, name);
+  }
+}
+
+void HistoryStore::setRetention(double seconds)
+{
+  m_retention = seconds;
+}
+
+double HistoryStore::startTime() const
+{
+  return m_start_time;
+}
+
+double HistoryStore::endTime() const
+{
+  return m_end_time;
+}
+
+HistoryStore::State HistoryStore::interpolate(const State& a, const State& b, double time)
+{
+  double f = b.time > a.time ? (time - a.time)/(b.time - a.time) : 0.0;
+  State ret;
+  ret.time = time;
+  ret.latitude = a.latitude + (b.latitude - a.latitude)*f;
+  ret.longitude = a.longitude + (b.longitude - a.longitude)*f;
+  ret.heading = interpolateAngle(a.heading, b.heading, f);
+  ret.cog = interpolateAngle(a.cog, b.cog, f);
+  ret.sog = interpolateValue(a.sog, b.sog, f);
+  return ret;
+}
+
+bool HistoryStore::stateAt(int entity, double time, State& state, double max_age) const
+{
+  if(entity < 0 || entity >= int(m_entities.size()))
+    return false;
+  const auto& columns = m_entities[entity];
+  std::size_t i = upperBound(columns, time);
+  if(i == 0)
+    return false;
+  State before = columns.at(i-1);
+  if(i == columns.size())
+  {
+    if(time - before.time > max_age)
+      return false;
+    state = before;
+    return true;
+  }
+  state = interpolate(before, columns.at(i), time);
+  return true;
+}
+
+void HistoryStore::statesAt(double time, std::vector<std::pair<int, State> >& states, double max_age) const
+{
+  State state;
+  for(int i = 0; i < int(m_entities.size()); i++)
+    if(stateAt(i, time, state, max_age))
+      states.push_back(std::make_pair(i, state));
+}
+
+void HistoryStore::segment(int entity, double start, double end, std::vector<State>& states) const
+{
+  if(entity < 0 || entity >= int(m_entities.size()) || end < start)
+    return;
+  const auto& columns = m_entities[entity];
+  std::size_t first = upperBound(columns, start);
+  std::size_t last = upperBound(columns, end);
+  if(first > 0 && first < columns.size())
+    states.push_back(interpolate(columns.at(first-1), columns.at(first), start));
+  for(std::size_t i = first; i < last; i++)
+    states.push_back(columns.at(i));
+  if(last > 0 && last < columns.size() && columns.at(last-1).time < end)
+    states.push_back(interpolate(columns.at(last-1), columns.at(last), end));
+}
@@ -0,0 +1,108 @@
+#ifndef CAMP_HISTORY_STORE_H
+#define CAMP_HISTORY_STORE_H
+
+#include <QHash>
+#include <QObject>
+#include <QString>
+#include <vector>
+
+// Time sorted state history of every tracked entity, AIS contacts and
+// platform nav sources alike, for looking back in time.
+//
+// Each entity's states are kept in columns, one vector per field, so
+// a lookup by time is a binary search over a contiguous array of
+// times. States between samples are interpolated. With a retention
+// time, every entity is trimmed once a minute and those left without
+// states are removed, so entities that stop reporting don't pile up.
+class HistoryStore: public QObject
+{
+  Q_OBJECT
+
+public:
+  // Positions in degrees, heading and course in degrees clockwise from
+  // north and speed in m/s. Any but time and position may be NaN.
+  struct State
+  {
+    double time;
+    double latitude;
+    double longitude;
+    float heading;
+    float cog;
+    float sog;
+  };
+
+  explicit HistoryStore(QObject* parent = nullptr);
+
+  // Returns the id of the named entity, adding it if new. Ids are only
+  // valid until entityRemoved is emitted for them.
+  int entity(const QString& name);
+  QString name(int entity) const;
+  int entityCount() const;
+
+  // States are expected in time order. A state at an existing time
+  // replaces it and late ones are inserted in place.
+  void add(int entity, const State& state);
+
+  // How long states are kept in seconds. Forever if 0.
+  void setRetention(double seconds);
+
+  // Earliest and latest times held, NaN if empty.
+  double startTime() const;
+  double endTime() const;
+
+  // State of the entity at time, interpolated between the samples
+  // either side. Past its last sample, the last state is returned for
+  // up to max_age seconds. Returns false if there is no state then.
+  bool stateAt(int entity, double time, State& state, double max_age = 600.0) const;
+
+  // Appends the state at time of every entity that has one.
+  void statesAt(double time, std::vector<std::pair<int, State> >& states, double max_age = 600.0) const;
+
+  // Appends the samples from start to end, bracketed by the states
+  // interpolated at start and end.
+  void segment(int entity, double start, double end, std::vector<State>& states) const;
+
+signals:
+  // Emitted when an entity was removed for having no states within
+  // the retention time. Its id may be reused for a new entity.
+  void entityRemoved(int entity, QString name);
+
+private:
+  struct Columns
+  {
+    // Samples before start have been dropped and are erased in bulk.
+    std::size_t start = 0;
+    std::vector<double> time;
+    std::vector<double> latitude;
+    std::vector<double> longitude;
+    std::vector<float> heading;
+    std::vector<float> cog;
+    std::vector<float> sog;
+
+    std::size_t size() const {return time.size() - start;}
+    State at(std::size_t i) const;
+    void set(std::size_t i, const State& state);
+    void insert(std::size_t i, const State& state);
+    void trim(double before);
+  };
+
+  // Index in columns of the first sample after time.
+  static std::size_t upperBound(const Columns& columns, double time);
+  static State interpolate(const State& a, const State& b, double time);
+
+  // Trims every entity and removes the empty ones, except keep.
+  void trimAll(int keep);
+
+  std::vector<Columns> m_entities;
+  QHash<QString, int> m_ids;
+  std::vector<QString> m_names;
+  // Ids of removed entities, for reuse.
+  std::vector<int> m_free_ids;
+  double m_retention = 0.0;
+  // Data time of the last trimAll.
+  double m_trim_time;
+  double m_start_time;
+  double m_end_time;
+};
+
+#endif
@@ -2,6 +2,7 @@
 #include <QApplication>
 #include <QString>
 #include <QFileInfo>
+#include <QStringList>
 
 #include "ros/ros.h"
 
@@ -17,7 +18,15 @@ int main(int argc, char *argv[])
     for(int i = 1; i < argc; i++)
     {
         QString arg(argv[i]);
-        if(arg.endsWith(".json", Qt::CaseInsensitive))
+        // --ais-benchmark=vessels[,seconds], needs a background to run over.
+        if(arg.startsWith("--ais-benchmark="))
+        {
+            QStringList values = arg.section('=', 1).split(',');
+            int vessels = values[0].toInt();
+            double seconds = values.size() > 1 ? values[1].toDouble() : 60.0;
+            w.startAISBenchmark(vessels > 0 ? vessels : 1000, seconds);
+        }
+        else if(arg.endsWith(".json", Qt::CaseInsensitive))
             //w.open(arg);
             QMetaObject::invokeMethod(&w, "open", Qt::QueuedConnection, Q_ARG(QString, arg));
         else if(QFileInfo(arg).isDir())
@@ -0,0 +1,220 @@
+#include "cache_index.h"
+
+#include <QDateTime>
+#include <QDataStream>
+#include <QDir>
+#include <QDirIterator>
+#include <QSaveFile>
+#include <algorithm>
+#include <vector>
+
+namespace camp
+{
+
+const char CacheIndex::index_file_name_[];
+const quint32 CacheIndex::index_magic_;
+
+CacheIndex CacheIndex::scan(QString root)
+{
+  QDir root_dir(root);
+  auto index_path = root_dir.absoluteFilePath(index_file_name_);
+
+  QHash<QString, quint32> saved_access;
+  QFile file(index_path);
+  if(file.open(QIODevice::ReadOnly))
+  {
+    QDataStream in(&file);
+    quint32 magic = 0;
+    quint32 count = 0;
+    in >> magic >> count;
+    if(magic == index_magic_)
+      for(quint32 i = 0; i < count && in.status() == QDataStream::Ok; i++)
+      {
+        QString path;
+        qint64 size;
+        quint32 last_access;
+        in >> path >> size >> last_access;
+        saved_access[root_dir.absoluteFilePath(path)] = last_access;
+      }
+  }
+
+  CacheIndex index;
+  QDirIterator it(root, QDir::Files, QDirIterator::Subdirectories);
+  while(it.hasNext())
+  {
+    it.next();
+    auto info = it.fileInfo();
+    auto path = info.absoluteFilePath();
+    if(path == index_path)
+      continue;
+    Entry entry;
+    entry.size = info.size();
+    auto saved = saved_access.find(path);
+    if(saved != saved_access.end())
+      entry.last_access = saved.value();
+    else
+      entry.last_access = info.lastModified().toSecsSinceEpoch();
+    index.entries_[path] = entry;
+  }
+  return index;
+}
+
+bool CacheIndex::save(QString root) const
+{
+  QDir root_dir(root);
+  QSaveFile file(root_dir.absoluteFilePath(index_file_name_));
+  if(!file.open(QIODevice::WriteOnly))
+    return false;
+
+  QDataStream out(&file);
+  out << index_magic_ << quint32(entries_.size());
+  for(auto entry = entries_.begin(); entry != entries_.end(); ++entry)
+    out << root_dir.relativeFilePath(entry.key()) << entry.value().size << entry.value().last_access;
+
+  return file.commit();
+}
+
+bool CacheIndex::contains(const QString& path) const
+{
+  return entries_.contains(path);
+}
+
+void CacheIndex::insert(const QString& path, qint64 size)
+{
+  Entry entry;
+  entry.size = size;
+  entry.last_access = QDateTime::currentSecsSinceEpoch();
+  auto existing = entries_.find(path);
+  if(existing != entries_.end())
+    account(path, -existing.value().size, -1);
+  entries_[path] = entry;
+  account(path, size, 1);
+}
+
+void CacheIndex::remove(const QString& path)
+{
+  auto entry = entries_.find(path);
+  if(entry == entries_.end())
+    return;
+  account(path, -entry.value().size, -1);
+  entries_.erase(entry);
+}
+
+void CacheIndex::touch(const QString& path)
+{
+  auto entry = entries_.find(path);
+  if(entry != entries_.end())
+    entry.value().last_access = QDateTime::currentSecsSinceEpoch();
+}
+
+void CacheIndex::merge(const CacheIndex& other)
+{
+  for(auto entry = other.entries_.begin(); entry != other.entries_.end(); ++entry)
+    if(!entries_.contains(entry.key()))
+    {
+      entries_[entry.key()] = entry.value();
+      account(entry.key(), entry.value().size, 1);
+    }
+}
+
+void CacheIndex::account(const QString& path, qint64 bytes, int files)
+{
+  for(auto totals = root_totals_.begin(); totals != root_totals_.end(); ++totals)
+    if(path.startsWith(totals.key()))
+    {
+      totals.value().bytes += bytes;
+      totals.value().files += files;
+    }
+}
+
+void CacheIndex::trackRoot(const QString& root)
+{
+  if(root_totals_.contains(root))
+    return;
+  Totals totals;
+  for(auto entry = entries_.begin(); entry != entries_.end(); ++entry)
+    if(entry.key().startsWith(root))
+    {
+      totals.bytes += entry.value().size;
+      totals.files++;
+    }
+  root_totals_[root] = totals;
+}
+
+qint64 CacheIndex::usedBytes(const QString& root) const
+{
+  auto totals = root_totals_.find(root);
+  if(totals != root_totals_.end())
+    return totals.value().bytes;
+  qint64 total = 0;
+  for(auto entry = entries_.begin(); entry != entries_.end(); ++entry)
+    if(entry.key().startsWith(root))
+      total += entry.value().size;
+  return total;
+}
+
+int CacheIndex::fileCount(const QString& root) const
+{
+  auto totals = root_totals_.find(root);
+  if(totals != root_totals_.end())
+    return totals.value().files;
+  int count = 0;
+  for(auto entry = entries_.begin(); entry != entries_.end(); ++entry)
+    if(entry.key().startsWith(root))
+      count++;
+  return count;
+}
+
+QStringList CacheIndex::evictionCandidates(const QString& root, qint64 budget_bytes) const
+{
+  QStringList ret;
+
+  auto used = usedBytes(root);
+  if(budget_bytes <= 0 || used <= budget_bytes)
+    return ret;
+
+  // Go down to 90% of the budget so eviction doesn't run on every new file.
+  qint64 target = budget_bytes*0.9;
+
+  struct Candidate
+  {
+    QString path;
+    quint32 last_access;
+    qint64 size;
+  };
+
+  std::vector<Candidate> candidates;
+  for(auto entry = entries_.begin(); entry != entries_.end(); ++entry)
+  {
+    const auto& path = entry.key();
+    if(!path.startsWith(root))
+      continue;
+    // Sidecars are accounted for with their data file.
+    if(path.endsWith(".json") && entries_.contains(path.left(path.size()-5)))
+      continue;
+    Candidate candidate {path, entry.value().last_access, entry.value().size};
+    auto sidecar = entries_.find(path+".json");
+    if(sidecar != entries_.end())
+      candidate.size += sidecar.value().size;
+    candidates.push_back(candidate);
+  }
+
+  std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b)
+  {
+    return a.last_access < b.last_access;
+  });
+
+  for(const auto& candidate: candidates)
+  {
+    if(used <= target)
+      break;
+    ret << candidate.path;
+    if(entries_.contains(candidate.path+".json"))
+      ret << candidate.path+".json";
+    used -= candidate.size;
+  }
+
+  return ret;
+}
+
+} // namespace camp
@@ -0,0 +1,76 @@
+#ifndef CAMP_CACHE_INDEX_H
+#define CAMP_CACHE_INDEX_H
+
+#include <QHash>
+#include <QStringList>
+
+namespace camp
+{
+
+// Tracks the size and last access time of files in a disk cache
+// so the least recently used ones can be evicted when the cache
+// grows over its budget. The index is saved in the cache root so
+// access times survive restarts.
+class CacheIndex
+{
+public:
+  struct Entry
+  {
+    qint64 size = 0;
+
+    // seconds since epoch
+    quint32 last_access = 0;
+  };
+
+  // Builds an index of all files under root. Access times are restored
+  // from the saved index, new files use their modification time.
+  static CacheIndex scan(QString root);
+
+  // Writes the index to root, replacing the previous one atomically.
+  bool save(QString root) const;
+
+  // Paths are absolute file paths.
+  bool contains(const QString& path) const;
+  void insert(const QString& path, qint64 size);
+  void remove(const QString& path);
+
+  // Sets path's access time to now.
+  void touch(const QString& path);
+
+  // Adds the entries of other that are not already present.
+  void merge(const CacheIndex& other);
+
+  // Keeps running totals of the files under root, updated as entries
+  // are inserted and removed, so usedBytes and fileCount don't scan
+  // the whole index for it.
+  void trackRoot(const QString& root);
+
+  // Total size and number of files under root.
+  qint64 usedBytes(const QString& root) const;
+  int fileCount(const QString& root) const;
+
+  // Returns the files to delete, least recently used first, so that
+  // files under root fit in the budget. A ".json" sidecar is evicted
+  // with the file it describes.
+  QStringList evictionCandidates(const QString& root, qint64 budget_bytes) const;
+
+private:
+  struct Totals
+  {
+    qint64 bytes = 0;
+    int files = 0;
+  };
+
+  // Adds to the totals of the tracked roots path is under.
+  void account(const QString& path, qint64 bytes, int files);
+
+  QHash<QString, Entry> entries_;
+  QHash<QString, Totals> root_totals_;
+
+  static constexpr char index_file_name_[] = "cache_index";
+  static constexpr quint32 index_magic_ = 0x43494458; // "CIDX"
+};
+
+} // namespace camp
+
+#endif
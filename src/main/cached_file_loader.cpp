@@ -5,6 +5,12 @@
 #include <QNetworkRequest>
 #include <QJsonObject>
 #include <QJsonDocument>
+#include <QtConcurrent>
+#include <QDirIterator>
+#include <QPointer>
+#include <QSettings>
+#include <QThread>
+#include <QTimer>
 
 #include <QDebug>
 
@@ -13,12 +19,33 @@ namespace camp
 
 CachedFileLoader* CachedFileLoader::instance = nullptr;
 
+const qint64 CachedFileLoader::default_budget_bytes_;
+const int CachedFileLoader::janitor_interval_ms_;
+
 CachedFileLoader::CachedFileLoader(QObject* parent):
   QObject(parent)
 {
   network_access_manager_ = new QNetworkAccessManager(this);
   connect(network_access_manager_, &QNetworkAccessManager::finished, this, &CachedFileLoader::downloadFinished);
+  connect(&cache_index_watcher_, &QFutureWatcher<CacheIndex>::finished, this, &CachedFileLoader::cacheIndexReady);
+  connect(&janitor_watcher_, &QFutureWatcher<QStringList>::finished, this, &CachedFileLoader::janitorFinished);
+  io_thread_pool_.setMaxThreadCount(4);
+  janitor_thread_pool_.setMaxThreadCount(1);
   setCachePath(QDir::home().filePath(".CCOMAutonomousMissionPlanner/"));
+  readSettings();
+
+  QTimer* janitor_timer = new QTimer(this);
+  connect(janitor_timer, &QTimer::timeout, this, &CachedFileLoader::runJanitor);
+  janitor_timer->start(janitor_interval_ms_);
+}
+
+CachedFileLoader::~CachedFileLoader()
+{
+  janitor_watcher_.waitForFinished();
+  io_thread_pool_.waitForDone();
+  if(cache_index_ready_)
+    cache_index_.save(cache_path_);
+  writeSettings();
 }
 
 CachedFileLoader* CachedFileLoader::get()
@@ -47,29 +74,218 @@ void CachedFileLoader::setCachePath(QString cache_path)
     if(!QDir::root().mkpath(cache_dir.absolutePath()))
       qDebug() << "failed to create cache directory";
   }
+
+  cache_index_ready_ = false;
+  cache_index_ = CacheIndex();
+  trackBudgetRoots();
+  cache_index_watcher_.setFuture(QtConcurrent::run(&CacheIndex::scan, cache_path_));
 }
 
-void CachedFileLoader::load(QString url, QString cache_local_path, CachedFileClient* client)
+void CachedFileLoader::cacheIndexReady()
 {
-  QUrl request_url(url);
-  if(!cache_path_.isEmpty() && !cache_local_path.isEmpty())
+  // Keep files saved while the scan was running.
+  auto index = cache_index_watcher_.result();
+  index.merge(cache_index_);
+  cache_index_ = index;
+  trackBudgetRoots();
+  cache_index_ready_ = true;
+  emit statisticsChanged();
+  runJanitor();
+}
+
+bool CachedFileLoader::isCached(const QString& file_path)
+{
+  if(cache_index_.contains(file_path))
   {
-    QFileInfo file_path(cache_path_, cache_local_path);
-    if(file_path.exists())
-      request_url.setUrl("file://"+file_path.filePath());
+    cache_index_.touch(file_path);
+    return true;
+  }
+  if(!cache_index_ready_ && QFileInfo::exists(file_path))
+  {
+    cache_index_.insert(file_path, QFileInfo(file_path).size());
+    return true;
   }
+  return false;
+}
 
-  QNetworkRequest request(request_url);
-  request.setRawHeader("User-Agent", "CCOMAutonomousMissionPlanner/1.0");
+bool CachedFileLoader::hasCachedCopy(QString cache_local_path) const
+{
+  if(cache_path_.isEmpty() || cache_local_path.isEmpty())
+    return false;
+  QFileInfo file_path(cache_path_, cache_local_path);
+  if(cache_index_.contains(file_path.absoluteFilePath()))
+    return true;
+  if(!cache_index_ready_)
+    return file_path.exists();
+  return false;
+}
+
+QString CachedFileLoader::budgetRoot(QString root) const
+{
+  if(root.isEmpty())
+    root = cache_path_;
+  return QDir(root).absolutePath()+"/";
+}
+
+void CachedFileLoader::trackBudgetRoots()
+{
+  for(auto budget = budgets_.begin(); budget != budgets_.end(); ++budget)
+    cache_index_.trackRoot(budget.key());
+}
+
+qint64 CachedFileLoader::cacheBudget(QString root) const
+{
+  return budgets_.value(budgetRoot(root), 0);
+}
+
+void CachedFileLoader::setCacheBudget(qint64 bytes, QString root)
+{
+  budgets_[budgetRoot(root)] = bytes;
+  trackBudgetRoots();
+  emit statisticsChanged();
+  runJanitor();
+}
+
+CachedFileLoader::Statistics CachedFileLoader::statistics(QString root) const
+{
+  Statistics ret;
+  auto budget_root = budgetRoot(root);
+  ret.used_bytes = cache_index_.usedBytes(budget_root);
+  ret.file_count = cache_index_.fileCount(budget_root);
+  ret.budget_bytes = budgets_.value(budget_root, 0);
+  ret.evicted_file_count = evicted_file_count_;
+  return ret;
+}
+
+void CachedFileLoader::runJanitor()
+{
+  emit statisticsChanged();
+
+  if(!cache_index_ready_ || janitor_watcher_.isRunning())
+    return;
+
+  bool over_budget = false;
+  for(auto budget = budgets_.begin(); budget != budgets_.end(); ++budget)
+    if(budget.value() > 0 && cache_index_.usedBytes(budget.key()) > budget.value())
+    {
+      over_budget = true;
+      break;
+    }
+
+  if(over_budget)
+    janitor_watcher_.setFuture(QtConcurrent::run(&janitor_thread_pool_, &CachedFileLoader::evict, cache_index_, budgets_, cache_path_));
+}
+
+QStringList CachedFileLoader::evict(CacheIndex index, QMap<QString, qint64> budgets, QString cache_path)
+{
+  QThread::currentThread()->setPriority(QThread::LowestPriority);
+
+  QStringList evicted;
+  for(auto budget = budgets.begin(); budget != budgets.end(); ++budget)
+    for(auto path: index.evictionCandidates(budget.key(), budget.value()))
+    {
+      // A file being read right now fails over to the network.
+      if(QFile::remove(path) || !QFileInfo::exists(path))
+      {
+        index.remove(path);
+        evicted << path;
+      }
+    }
+
+  index.save(cache_path);
+  return evicted;
+}
+
+void CachedFileLoader::janitorFinished()
+{
+  auto evicted = janitor_watcher_.result();
+  for(const auto& path: evicted)
+    cache_index_.remove(path);
+  evicted_file_count_ += evicted.size();
+  emit statisticsChanged();
+}
+
+void CachedFileLoader::readSettings()
+{
+  QSettings settings;
+  settings.beginGroup("CachedFileLoader");
+  auto budgets = settings.value("budgets").toMap();
+  settings.endGroup();
 
+  for(auto budget = budgets.begin(); budget != budgets.end(); ++budget)
+    budgets_[budgetRoot(budget.key())] = budget.value().toLongLong();
+  if(!budgets_.contains(budgetRoot(cache_path_)))
+    budgets_[budgetRoot(cache_path_)] = default_budget_bytes_;
+  trackBudgetRoots();
+}
+
+void CachedFileLoader::writeSettings()
+{
+  QVariantMap budgets;
+  for(auto budget = budgets_.begin(); budget != budgets_.end(); ++budget)
+    budgets[budget.key()] = budget.value();
+
+  QSettings settings;
+  settings.beginGroup("CachedFileLoader");
+  settings.setValue("budgets", budgets);
+  settings.endGroup();
+}
+
+void CachedFileLoader::load(QString url, QString cache_local_path, CachedFileClient* client)
+{
   QVariant local_path_variant;
   local_path_variant.setValue(cache_local_path);
   client->setProperty("cache_local_path", local_path_variant);
+
+  if(!cache_path_.isEmpty() && !cache_local_path.isEmpty())
+  {
+    QFileInfo file_path(cache_path_, cache_local_path);
+    if(isCached(file_path.absoluteFilePath()))
+    {
+      cacheLoad(file_path.absoluteFilePath(), url, client);
+      return;
+    }
+  }
+
+  networkLoad(QUrl(url), client);
+}
+
+void CachedFileLoader::networkLoad(QUrl url, CachedFileClient* client)
+{
+  QNetworkRequest request(url);
+  request.setRawHeader("User-Agent", "CCOMAutonomousMissionPlanner/1.0");
   request.setOriginatingObject(client);
 
   network_access_manager_->get(request);
 }
 
+void CachedFileLoader::cacheLoad(QString file_path, QString url, CachedFileClient* client)
+{
+  QPointer<CachedFileClient> client_pointer(client);
+  QtConcurrent::run(&io_thread_pool_, [this, file_path, url, client_pointer]()
+  {
+    QFile file(file_path);
+    bool ok = file.open(QIODevice::ReadOnly);
+    QByteArray data;
+    if(ok)
+      data = file.readAll();
+
+    QMetaObject::invokeMethod(this, [this, ok, data, file_path, url, client_pointer]() mutable
+    {
+      if(!client_pointer)
+        return;
+      if(ok)
+        emit client_pointer->dataLoaded(data, client_pointer);
+      else
+      {
+        // The file went away since it was indexed.
+        cache_index_.remove(file_path);
+        networkLoad(QUrl(url), client_pointer);
+      }
+    }, Qt::QueuedConnection);
+  });
+}
+
 void CachedFileLoader::downloadFinished(QNetworkReply* reply)
 {
   if(reply->error() == QNetworkReply::NoError)
@@ -107,6 +323,9 @@ void CachedFileLoader::downloadFinished(QNetworkReply* reply)
         reply_file.open(QIODevice::WriteOnly);
         reply_file.write(QJsonDocument(meta).toJson());
         reply_file.close();
+
+        cache_index_.insert(file_path.absoluteFilePath(), data.size());
+        cache_index_.insert(file_path.absoluteFilePath()+".json", reply_file.size());
       }
 
       emit client->dataLoaded(data, client);
@@ -114,7 +333,12 @@ void CachedFileLoader::downloadFinished(QNetworkReply* reply)
 
   }
   else
+  {
     qDebug() << "Error " << reply->error() << " when getting " << reply->request().url();
+    auto* client = qobject_cast<CachedFileClient*>(reply->request().originatingObject());
+    if(client)
+      emit client->loadFailed(client);
+  }
   reply->deleteLater();
 }
 
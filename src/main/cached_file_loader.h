@@ -3,6 +3,11 @@
 
 #include <QObject>
 #include <QDir>
+#include <QMap>
+#include <QThreadPool>
+#include <QFutureWatcher>
+#include <QUrl>
+#include "cache_index.h"
 
 class QNetworkAccessManager;
 class QNetworkReply;
@@ -19,11 +24,19 @@ public:
   CachedFileClient(QObject* parent=nullptr);
 signals:
   void dataLoaded(QByteArray &data, CachedFileClient* client);
+
+  // Sent instead of dataLoaded when the file could not be loaded.
+  void loadFailed(CachedFileClient* client);
 };
 
 // Loads file from a drive or
 // from the network via http.
 // can cache http files locally for performance.
+// Cache hits are read on a dedicated thread pool
+// without going through the network stack.
+// Directories in the cache may be given a disk budget,
+// a low priority janitor evicts the least recently used
+// files to stay within it.
 class CachedFileLoader: public QObject
 {
   Q_OBJECT
@@ -32,6 +45,31 @@ public:
 
   QDir cachePath() const;
 
+  // Returns true if a file is cached at cache_local_path without
+  // marking it as used.
+  bool hasCachedCopy(QString cache_local_path) const;
+
+  struct Statistics
+  {
+    qint64 used_bytes = 0;
+    qint64 budget_bytes = 0;
+    int file_count = 0;
+
+    // Files removed by the janitor since startup.
+    int evicted_file_count = 0;
+  };
+
+  // Usage of the cache under root, or the whole cache if root is empty.
+  Statistics statistics(QString root = {}) const;
+
+  // Maximum size in bytes of the files under root, or the
+  // whole cache if root is empty. Zero means no limit.
+  qint64 cacheBudget(QString root = {}) const;
+  void setCacheBudget(qint64 bytes, QString root = {});
+
+signals:
+  void statisticsChanged();
+
 public slots:
   void setCachePath(QString cache_path);
   void load(QString url, QString cache_local_path, CachedFileClient* client);
@@ -39,20 +77,73 @@ public slots:
 private:
   friend class MainWindow;
   CachedFileLoader(QObject* parent=nullptr);
+  ~CachedFileLoader();
   static void construct();
   static void destruct();
 
   static CachedFileLoader* instance;
 
+  // Requests url through the network access manager.
+  void networkLoad(QUrl url, CachedFileClient* client);
+
+  // Reads a cached file on the I/O thread pool and delivers the
+  // data to the client on this object's thread. Falls back to
+  // the network if the file can't be read.
+  void cacheLoad(QString file_path, QString url, CachedFileClient* client);
+
+  // Returns true if file_path, an absolute path, is in the cache
+  // and marks it as recently used.
+  bool isCached(const QString& file_path);
+
+  // Absolute directory path with a trailing separator used to
+  // match files in the index.
+  QString budgetRoot(QString root) const;
+
+  // Has the index keep running totals for each budgeted root, so
+  // statistics and the janitor don't scan it.
+  void trackBudgetRoots();
+
+  // Deletes files to bring each budgeted root within its budget
+  // and saves the resulting index. Runs on the janitor thread.
+  static QStringList evict(CacheIndex index, QMap<QString, qint64> budgets, QString cache_path);
+
+  void readSettings();
+  void writeSettings();
+
   QNetworkAccessManager* network_access_manager_;
 
   // Base location where files are stored locally
   QString cache_path_;
 
-private slots:
-  void downloadFinished(QNetworkReply* reply);
+  // Threads used to read cached files.
+  QThreadPool io_thread_pool_;
+
+  // Files present in the cache. Until the initial scan
+  // is done, misses are checked on the file system.
+  CacheIndex cache_index_;
+  bool cache_index_ready_ = false;
+  QFutureWatcher<CacheIndex> cache_index_watcher_;
 
+  // Disk budgets in bytes keyed by budgetRoot.
+  QMap<QString, qint64> budgets_;
 
+  // Single low priority thread for evicting files.
+  QThreadPool janitor_thread_pool_;
+  QFutureWatcher<QStringList> janitor_watcher_;
+
+  int evicted_file_count_ = 0;
+
+  // Budget used for the whole cache if none is configured.
+  static constexpr qint64 default_budget_bytes_ = qint64(4)*1024*1024*1024;
+
+  // How often the janitor checks the budgets.
+  static constexpr int janitor_interval_ms_ = 30000;
+
+private slots:
+  void downloadFinished(QNetworkReply* reply);
+  void cacheIndexReady();
+  void runJanitor();
+  void janitorFinished();
 
 };
 
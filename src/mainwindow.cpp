@@ -18,10 +18,15 @@
 #include "searchpattern.h"
 
 #include "ais/ais_manager.h"
+#include "ais/ais_benchmark.h"
+#include "history_store.h"
+#include "geofence.h"
+#include "time_slider.h"
 #include "radar/radar_manager.h"
 #include "sound_play/sound_play_widget.h"
 #include "sound_play/speech_alerts.h"
 #include "platform_manager/platform.h"
+#include "platform_manager/platform_manager.h"
 #include "grids/grid_manager.h"
 #include "markers/markers_manager.h"
 
@@ -90,8 +95,26 @@ MainWindow::MainWindow(QWidget *parent) :
 
     m_speech_alerts = new SpeechAlerts(this);
     connect(m_speech_alerts, &SpeechAlerts::tell, m_sound_play, &SoundPlay::say);
+    m_ais_manager->setPlatformManager(m_ui->platformManager);
+    connect(m_ais_manager, &AISManager::collisionRisk, m_speech_alerts, &SpeechAlerts::collisionRisk);
     //connect(m_ui->helmManager, &HelmManager::pilotingModeUpdated, m_speech_alerts, &SpeechAlerts::updatePilotingMode);
 
+    m_history_store = new HistoryStore(this);
+    m_history_store->setRetention(ros::param::param<double>("~history_store_hours", 2.0)*3600.0);
+    m_ais_manager->setHistoryStore(m_history_store);
+    m_ui->platformManager->setHistoryStore(m_history_store);
+
+    TimeSlider* time_slider = new TimeSlider(m_history_store, this);
+    statusBar()->addPermanentWidget(time_slider);
+    connect(time_slider, &TimeSlider::displayTimeChanged, m_ais_manager, &AISManager::setDisplayTime);
+    connect(time_slider, &TimeSlider::displayTimeChanged, m_ui->platformManager, &PlatformManager::setDisplayTime);
+
+    m_geofence_monitor = new GeofenceMonitor(this);
+    m_geofence_monitor->setProject(project);
+    m_ais_manager->setGeofenceMonitor(m_geofence_monitor);
+    m_ui->platformManager->setGeofenceMonitor(m_geofence_monitor);
+    connect(m_geofence_monitor, &GeofenceMonitor::geofenceAlert, m_speech_alerts, &SpeechAlerts::geofenceAlert);
+
     m_ui->platformManager->loadFromParameters();
 }
 
@@ -568,6 +591,12 @@ void MainWindow::onROSConnected(bool connected)
     //m_ui->rosDetails->setEnabled(connected);
 }
 
+void MainWindow::startAISBenchmark(int vessel_count, double seconds)
+{
+    AISBenchmark* benchmark = new AISBenchmark(m_ais_manager, m_ui->projectView, vessel_count, seconds, this);
+    connect(project, &AutonomousVehicleProject::backgroundUpdated, benchmark, &AISBenchmark::updateBackground);
+}
+
 void MainWindow::on_actionAISManager_triggered()
 {
     m_ais_manager->show();
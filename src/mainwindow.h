@@ -10,6 +10,8 @@ class MainWindow;
 }
 
 class AISManager;
+class HistoryStore;
+class GeofenceMonitor;
 class RadarManager;
 class SoundPlay;
 class SpeechAlerts;
@@ -37,6 +39,10 @@ public slots:
     void openBackground(QString const &fname);
     void setWorkspace(QString const &dir);
 
+    // Feeds the AIS display synthetic traffic once a background is
+    // loaded, logs its performance and quits after seconds.
+    void startAISBenchmark(int vessel_count, double seconds);
+
     void setCurrent(const QModelIndex &index, const QModelIndex &previous);
     void onROSConnected(bool connected);
     void activePlatformPosition(QGeoCoordinate position);
@@ -90,6 +96,8 @@ private:
     AutonomousVehicleProject *project;
     QString m_workspace_path;
     AISManager* m_ais_manager;
+    HistoryStore* m_history_store;
+    GeofenceMonitor* m_geofence_monitor;
     RadarManager* m_radar_manager = nullptr;
     GridManager* m_grid_manager = nullptr;
     MarkersManager* m_markers_manager = nullptr;
@@ -34,9 +34,6 @@ enum ItemType
   RosLayerType,
   MarkerNamespaceType,
   MarkerType,
-
-  // other QGraphicsItem descendants
-  TileType,
 };
 
 } // namespace map
@@ -26,6 +26,16 @@ void CachedTileLoader::setCachePath(QString cache_path)
   local_cache_path_ = cache_path;
 }
 
+QDir CachedTileLoader::cachePath() const
+{
+  return QDir(local_cache_path_);
+}
+
+QString CachedTileLoader::cacheFilePath(const TileAddress& tile) const
+{
+  return QFileInfo(local_cache_path_, tile).filePath();
+}
+
 void CachedTileLoader::load(TileAddress address)
 {
   if(local_cache_path_.isEmpty())
@@ -35,8 +45,6 @@ void CachedTileLoader::load(TileAddress address)
   }
   QString url_str = address.url().c_str();
 
-  QFileInfo file_path(local_cache_path_, address);
-
   CachedFileClient* client = new CachedFileClient(this);
   connect(client, &CachedFileClient::dataLoaded, this, &CachedTileLoader::dataLoaded);
 
@@ -44,7 +52,7 @@ void CachedTileLoader::load(TileAddress address)
   address_variant.setValue(address);
   client->setProperty("address", address_variant);
 
-  CachedFileLoader::get()->load(url_str, file_path.filePath(), client);
+  CachedFileLoader::get()->load(url_str, cacheFilePath(address), client);
 }
 
 void CachedTileLoader::dataLoaded(QByteArray &data, CachedFileClient* client)
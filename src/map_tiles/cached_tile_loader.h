@@ -31,6 +31,9 @@ public:
 
   QDir cachePath() const;
 
+  // Location of a tile's cached image.
+  QString cacheFilePath(const TileAddress& tile) const;
+
 signals:
   void pixmapLoaded(QPixmap pixmap, TileAddress tile_address);
 
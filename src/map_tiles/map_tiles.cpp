@@ -1,21 +1,30 @@
 #include "map_tiles.h"
 #include <QPainter>
-#include "tile.h"
 #include <cmath>
 #include <QSpinBox>
 #include <QDoubleSpinBox>
 #include "cached_tile_loader.h"
+#include "tile_seeder.h"
 #include <QDir>
 #include <QStyleOptionGraphicsItem>
-#include <set>
+#include <QGraphicsScene>
+#include <QGraphicsView>
+#include <QInputDialog>
+#include <QLocale>
+#include <QMenu>
+#include <QSettings>
 #include "wmts/capabilities.h"
 
+#include <QDebug>
+
 namespace camp
 {
 
 namespace map_tiles
 {
 
+const int MapTiles::max_fallback_descent_;
+
 MapTiles::MapTiles(map::MapItem* parentItem, const QString& label, const TileLayout& tile_layout):
   map::Layer(parentItem, label), tile_layout_(tile_layout)
 {
@@ -25,73 +34,127 @@ MapTiles::MapTiles(map::MapItem* parentItem, const QString& label, const TileLay
 
   auto dir = QDir::home().filePath(".CCOMAutonomousMissionPlanner/map_tiles/"+label);
   tile_loader_->setCachePath(dir);
+
+  seeder_ = new TileSeeder(&tile_layout_, tile_loader_, this);
+  connect(seeder_, &TileSeeder::statisticsChanged, this, &MapTiles::seedingStatisticsChanged);
+  connect(seeder_, &TileSeeder::finished, this, &MapTiles::seedingFinished);
+
   setLayout(tile_layout);
 }
 
 QRectF MapTiles::boundingRect() const
 {
-  return childrenBoundingRect();
+  return tile_layout_.boundingRect();
 }
 
 void MapTiles::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget)
 {
+  if(tile_layout_.zoom_levels.empty())
+    return;
+
   auto lod = QStyleOptionGraphicsItem::levelOfDetailFromTransform(painter->worldTransform());
 
   // scale up view 
   lod /= 2.0;
 
-  auto wt = painter->worldTransform();
-  auto window = painter->window();
-  QPointF top_left((window.x()-wt.m31())/wt.m11(), (window.y()-wt.m32())/wt.m22());
-  QPointF bottom_right(top_left.x()+window.width()/wt.m11(), top_left.y()+window.height()/wt.m22());
+  auto visible_area = painter->worldTransform().inverted().mapRect(QRectF(painter->window()));
 
-  int level_number = 0;
   int render_level = tile_layout_.zoom_levels.size()-1;
 
-  std::set<TileAddress> visible_tiles;
+  for(int level_number = 0; level_number < tile_layout_.zoom_levels.size(); level_number++)
+    if(tile_layout_.zoom_levels[level_number].scale*lod < 2.0)
+    {
+      render_level = level_number;
+      break;
+    }
+
+  auto index_range = tile_layout_.zoom_levels[render_level].indexRange(visible_area);
+
+  // Tile images have their first row to the north, so flip the y axis
+  // to draw them upright.
+  painter->save();
+  painter->scale(1.0, -1.0);
+
+  for(int row = index_range.top(); row <= index_range.bottom(); row++)
+    for(int col = index_range.left(); col <= index_range.right(); col++)
+    {
+      TileAddress address(&tile_layout_, render_level, QPoint(col, row));
+      auto tile = tiles_.find(address);
+      if(tile != tiles_.end() && !tile->second.isNull())
+      {
+        drawTile(painter, address, tile->second, address.boundingRect());
+        continue;
+      }
+      if(tile == tiles_.end())
+      {
+        tiles_[address] = QPixmap();
+        tile_loader_->load(address);
+      }
+      drawFallback(painter, address);
+    }
+
+  painter->restore();
+}
+
+void MapTiles::drawTile(QPainter* painter, const TileAddress& address, const QPixmap& pixmap, const QRectF& area) const
+{
+  auto tile_rect = address.boundingRect();
+  auto target = tile_rect.intersected(area);
+  if(target.isEmpty())
+    return;
+
+  // Pixmaps that are not the standard tile size get scaled to fit.
+  double x_scale = pixmap.width()/tile_rect.width();
+  double y_scale = pixmap.height()/tile_rect.height();
+  QRectF source((target.left()-tile_rect.left())*x_scale, (tile_rect.bottom()-target.bottom())*y_scale, target.width()*x_scale, target.height()*y_scale);
+
+  painter->drawPixmap(QRectF(target.left(), -target.bottom(), target.width(), target.height()), pixmap, source);
+}
+
+void MapTiles::drawFallback(QPainter* painter, const TileAddress& address) const
+{
+  auto area = address.boundingRect();
 
-  for(const auto& level: tile_layout_.zoom_levels)
+  // Nearest loaded ancestor, cropped and scaled to the missing tile.
+  for(int zoom_level = address.zoomLevel()-1; zoom_level >= 0; zoom_level--)
   {
-    if(level.scale*lod < 2.0)
+    auto index_range = tile_layout_.zoom_levels[zoom_level].indexRange(QRectF(area.center(), QSizeF()));
+    if(index_range.isEmpty())
+      continue;
+    TileAddress ancestor(&tile_layout_, zoom_level, index_range.topLeft());
+    auto tile = tiles_.find(ancestor);
+    if(tile != tiles_.end() && !tile->second.isNull())
     {
-      render_level = level_number;
+      drawTile(painter, ancestor, tile->second, area);
       break;
     }
-    level_number++;
   }
 
-  if(render_level >= 0)
+  // Loaded descendants go on top since they have more detail.
+  // The area is shrunk a bit so neighbouring tiles sharing an
+  // edge are not looked up.
+  auto inner_area = area.adjusted(area.width()*0.001, area.height()*0.001, -area.width()*0.001, -area.height()*0.001);
+  int last_level = std::min<int>(tile_layout_.zoom_levels.size()-1, address.zoomLevel()+max_fallback_descent_);
+  for(int zoom_level = address.zoomLevel()+1; zoom_level <= last_level; zoom_level++)
   {
-    const auto& level = tile_layout_.zoom_levels[render_level];
-    auto start_x_index = std::max(0,std::min(level.matrix_width,int(floor( (top_left.x() - level.top_left_corner.x())/(level.tile_width*level.scale)))));
-    auto end_x_index = std::max(0,std::min(level.matrix_width,int(ceil(( bottom_right.x() - level.top_left_corner.x())/(level.tile_width*level.scale)))));
-    auto start_y_index = std::max(0,std::min(level.matrix_height,int(floor( (level.top_left_corner.y()-top_left.y()))/(level.tile_height*level.scale))));
-    auto end_y_index = std::max(0,std::min(level.matrix_height,int(ceil( (level.top_left_corner.y()-bottom_right.y())/(level.tile_height*level.scale)))));
-
-    for(int row = start_y_index; row <= end_y_index && row < level.matrix_height; row++)
-      for(int col = start_x_index; col <= end_x_index && col < level.matrix_width; col++)
+    auto index_range = tile_layout_.zoom_levels[zoom_level].indexRange(inner_area);
+    for(int row = index_range.top(); row <= index_range.bottom(); row++)
+      for(int col = index_range.left(); col <= index_range.right(); col++)
       {
-        TileAddress address(&tile_layout_, render_level, QPoint(col, row));
-        if(tiles_.find(address) == tiles_.end() || tiles_[address] == nullptr)
-        {
-          tiles_[address] = new Tile(address, this);
-          tile_loader_->load(address);
-        }
-        tiles_[address]->setVisible(true);
-        visible_tiles.insert(address);
+        TileAddress descendant(&tile_layout_, zoom_level, QPoint(col, row));
+        auto tile = tiles_.find(descendant);
+        if(tile != tiles_.end() && !tile->second.isNull())
+          drawTile(painter, descendant, tile->second, area);
       }
   }
-
-  for(auto tile: tiles_)
-    if(visible_tiles.find(tile.first) == visible_tiles.end())
-      tile.second->setVisible(false);
 }
 
 void MapTiles::setLayout(const TileLayout& tile_layout)
 {
-  for(auto tile: tiles_)
-    if(tile.second)
-      delete tile.second;
+  // The seeder's addresses refer to the current layout.
+  seeder_->stop();
+
+  prepareGeometryChange();
   tiles_.clear();
   tile_layout_ = tile_layout;
   if(!tile_layout_.zoom_levels.empty())
@@ -101,10 +164,12 @@ void MapTiles::setLayout(const TileLayout& tile_layout)
       for(int col = 0; col < top_level.matrix_width; col++)
       {
         TileAddress address(&tile_layout_, 0, QPoint(col, row));
-        tiles_[address] = new Tile(address, this);
+        tiles_[address] = QPixmap();
         tile_loader_->load(address);
       }
   }
+
+  startSeeding();
 }
 
 void MapTiles::setLayoutFromWMTS(const wmts::Capabilities &capabilites, QString layer_id, QString tile_matrix_set)
@@ -132,12 +197,136 @@ void MapTiles::loadTile(TileAddress tile_address)
 
 void MapTiles::tileLoaded(QPixmap pixmap, TileAddress tile_address)
 {
-  if(tiles_.find(tile_address) != tiles_.end() && tiles_[tile_address] != nullptr)
-    // The < operator used for map does not consider layout, but the == operator does.
-    // This is to make sure an old pixmap loading before a setLayout call doesn't make
-    // it to a new layout's tile.
-    if(tiles_[tile_address]->address() == tile_address) 
-      tiles_[tile_address]->updatePixmap(pixmap);
+  auto tile = tiles_.find(tile_address);
+  // The < operator used for map does not consider layout, but the == operator does.
+  // This is to make sure an old pixmap loading before a setLayout call doesn't make
+  // it to a new layout's tile.
+  if(tile != tiles_.end() && tile->first == tile_address)
+  {
+    tile->second = pixmap;
+    update(tile_address.boundingRect());
+  }
+}
+
+void MapTiles::seed(QPolygonF area, int min_zoom_level, int max_zoom_level)
+{
+  seed_job_.area = area;
+  seed_job_.min_zoom_level = min_zoom_level;
+  seed_job_.max_zoom_level = max_zoom_level;
+  seed_job_pending_ = true;
+  startSeeding();
+}
+
+void MapTiles::startSeeding()
+{
+  if(seed_job_pending_ && !tile_layout_.zoom_levels.empty())
+    seeder_->start(seed_job_.area, seed_job_.min_zoom_level, seed_job_.max_zoom_level);
+}
+
+void MapTiles::seedVisibleArea()
+{
+  if(!scene() || scene()->views().empty() || tile_layout_.zoom_levels.empty())
+    return;
+
+  auto view = scene()->views().front();
+  auto area = mapFromScene(view->mapToScene(view->viewport()->rect()));
+
+  int last_level = tile_layout_.zoom_levels.size()-1;
+  bool ok = false;
+  int min_zoom_level = QInputDialog::getInt(nullptr, tr("Pre-seed tiles"), tr("Minimum zoom level:"), 0, 0, last_level, 1, &ok);
+  if(!ok)
+    return;
+  int max_zoom_level = QInputDialog::getInt(nullptr, tr("Pre-seed tiles"), tr("Maximum zoom level:"), std::min(last_level, 16), min_zoom_level, last_level, 1, &ok);
+  if(!ok)
+    return;
+
+  seed(area, min_zoom_level, max_zoom_level);
+}
+
+void MapTiles::stopSeeding()
+{
+  seed_job_pending_ = false;
+  seeder_->stop();
+  setStatus("");
+}
+
+void MapTiles::seedingStatisticsChanged()
+{
+  if(!seed_job_pending_)
+    return;
+  const auto& statistics = seeder_->statistics();
+  QLocale locale;
+  setStatus("(seeding: "+QString::number(statistics.visited_count)+" of "+QString::number(statistics.tile_count)+" tiles, "
+    +QString::number(statistics.tiles_per_second, 'f', 1)+" tiles/s, "
+    +locale.formattedDataSize(statistics.bytes_per_second)+"/s)");
+}
+
+void MapTiles::seedingFinished()
+{
+  const auto& statistics = seeder_->statistics();
+  qDebug() << objectName() << "seeding done:" << statistics.downloaded_count << "downloaded," << statistics.cached_count << "already cached," << statistics.failed_count << "failed";
+  seed_job_pending_ = false;
+  setStatus("");
+}
+
+void MapTiles::contextMenu(QMenu* menu)
+{
+  auto seed_action = menu->addAction("Pre-seed visible area");
+  connect(seed_action, &QAction::triggered, this, &MapTiles::seedVisibleArea);
+
+  if(seed_job_pending_)
+  {
+    auto stop_action = menu->addAction("Stop pre-seeding");
+    connect(stop_action, &QAction::triggered, this, &MapTiles::stopSeeding);
+  }
+}
+
+void MapTiles::readSettings()
+{
+  map::Layer::readSettings();
+
+  QSettings settings;
+  settings.beginGroup("MapItem");
+  settings.beginGroup(objectName());
+
+  auto area = settings.value("seed_area").value<QPolygonF>();
+  if(!area.isEmpty())
+  {
+    seed_job_.area = area;
+    seed_job_.min_zoom_level = settings.value("seed_min_zoom_level", 0).toInt();
+    seed_job_.max_zoom_level = settings.value("seed_max_zoom_level", 0).toInt();
+    seed_job_pending_ = true;
+  }
+
+  settings.endGroup();
+  settings.endGroup();
+
+  startSeeding();
+}
+
+void MapTiles::writeSettings()
+{
+  map::Layer::writeSettings();
+
+  QSettings settings;
+  settings.beginGroup("MapItem");
+  settings.beginGroup(objectName());
+
+  if(seed_job_pending_)
+  {
+    settings.setValue("seed_area", seed_job_.area);
+    settings.setValue("seed_min_zoom_level", seed_job_.min_zoom_level);
+    settings.setValue("seed_max_zoom_level", seed_job_.max_zoom_level);
+  }
+  else
+  {
+    settings.remove("seed_area");
+    settings.remove("seed_min_zoom_level");
+    settings.remove("seed_max_zoom_level");
+  }
+
+  settings.endGroup();
+  settings.endGroup();
 }
 
 } // namespace map_tiles
@@ -3,6 +3,8 @@
 
 #include "../map/layer.h"
 #include "tile_address.h"
+#include <QPixmap>
+#include <QPolygonF>
 
 namespace camp
 {
@@ -15,11 +17,16 @@ namespace wmts
 namespace map_tiles
 {
 
-class Tile;
 class CachedTileLoader;
+class TileSeeder;
 
 // Displays a hierarchy of map tiles from local disk or network sources.
 // The tiles are layed out in the OpenStreetMap Slippy map scheme.
+// Tiles are not scene items, they are drawn directly from the pixmap
+// cache so painting only costs as much as the visible tiles.
+// Tiles still loading are filled in with already loaded tiles
+// from other zoom levels.
+// An area can be pre-seeded into the cache for offline use.
 class MapTiles: public map::Layer
 {
   Q_OBJECT
@@ -41,23 +48,68 @@ public:
 
   void loadTile(TileAddress tile_address);
 
+  // Downloads the tiles covering area, in projected coordinates,
+  // from min_zoom_level to max_zoom_level into the cache. An
+  // unfinished job is resumed the next time the layer is loaded.
+  void seed(QPolygonF area, int min_zoom_level, int max_zoom_level);
+
   //void setBaseUrl(QString base_url);
 
 public slots:
   void updateViewScale(double view_scale);
   void wmtsCapabilitiesReady();
 
+protected:
+  void contextMenu(QMenu* menu) override;
+  void readSettings() override;
+  void writeSettings() override;
+
 private:
+  // Starts the pending seed job once the layout is known.
+  void startSeeding();
+
+  // Draws the part of a tile's pixmap covering area. Expects the
+  // painter's y axis to be flipped.
+  void drawTile(QPainter* painter, const TileAddress& address, const QPixmap& pixmap, const QRectF& area) const;
+
+  // Fills the area of a tile that is not loaded yet using the
+  // nearest loaded ancestor and any loaded descendants.
+  void drawFallback(QPainter* painter, const TileAddress& address) const;
+
+  // How many levels down to look for loaded tiles when
+  // filling in for a missing tile.
+  static constexpr int max_fallback_descent_ = 2;
+
   TileLayout tile_layout_;
-  std::map<TileAddress, Tile*> tiles_;
+
+  // Loaded tile images. A null pixmap means the tile has been
+  // requested but is not ready yet.
+  std::map<TileAddress, QPixmap> tiles_;
 
   CachedTileLoader* tile_loader_;
 
+  TileSeeder* seeder_;
+
+  struct SeedJob
+  {
+    QPolygonF area;
+    int min_zoom_level = 0;
+    int max_zoom_level = 0;
+  };
+
+  // Seed job started but not finished yet.
+  bool seed_job_pending_ = false;
+  SeedJob seed_job_;
+
   const wmts::Capabilities* wmts_capabilites_ = nullptr;
   QString wmts_layer_id_;
   QString wmts_tile_matrix_set_;
 private slots:
   void tileLoaded(QPixmap pixmap, TileAddress tile);
+  void seedVisibleArea();
+  void stopSeeding();
+  void seedingStatisticsChanged();
+  void seedingFinished();
 };
 
 } // namespace map_tiles
@@ -69,6 +69,14 @@ QPointF TileAddress::topLeftCorner() const
   return QPointF(level.top_left_corner.x()+index_.x()*level.scale*level.tile_width, level.top_left_corner.y()-index_.y()*level.scale*level.tile_height);
 }
 
+QRectF TileAddress::boundingRect() const
+{
+  const auto& level = layout_->zoom_levels[zoom_level_];
+  auto top_left = topLeftCorner();
+  QPointF bottom_right(top_left.x()+level.scale*level.tile_width, top_left.y()-level.scale*level.tile_height);
+  return QRectF(top_left, bottom_right).normalized();
+}
+
 } // namepsace map_tiles
 
 } // camp
@@ -44,6 +44,9 @@ public:
   double scale() const;
   QPointF topLeftCorner() const;
 
+  // Area covered by the tile in projected coordinates.
+  QRectF boundingRect() const;
+
 private:
   const TileLayout* layout_;
   uint8_t zoom_level_ = 0;
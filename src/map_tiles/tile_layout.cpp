@@ -1,5 +1,6 @@
 #include "tile_layout.h"
 #include "tile_address.h"
+#include <cmath>
 
 namespace camp
 {
@@ -16,7 +17,30 @@ QRectF TileLayout::boundingRect() const
 
 QRectF TileLayout::ZoomLevel::boundingRect() const
 {
-  return QRectF(top_left_corner, QSizeF(scale*tile_width*matrix_width, scale*tile_height*matrix_height));
+  // Projected y increases northward while tile rows go south.
+  QPointF bottom_right(top_left_corner.x()+scale*tile_width*matrix_width, top_left_corner.y()-scale*tile_height*matrix_height);
+  return QRectF(top_left_corner, bottom_right).normalized();
+}
+
+QRect TileLayout::ZoomLevel::indexRange(const QRectF& area) const
+{
+  double tile_span_x = tile_width*scale;
+  double tile_span_y = tile_height*scale;
+
+  // Clamp before converting to int to avoid overflow when zoomed far out.
+  auto index = [](double position, int count)
+  {
+    return int(std::max(-1.0, std::min(double(count), floor(position))));
+  };
+
+  int start_col = std::max(0, index((area.left()-top_left_corner.x())/tile_span_x, matrix_width));
+  int end_col = std::min(matrix_width-1, index((area.right()-top_left_corner.x())/tile_span_x, matrix_width));
+
+  // Rows increase southward while projected y increases northward.
+  int start_row = std::max(0, index((top_left_corner.y()-area.bottom())/tile_span_y, matrix_height));
+  int end_row = std::min(matrix_height-1, index((top_left_corner.y()-area.top())/tile_span_y, matrix_height));
+
+  return QRect(QPoint(start_col, start_row), QPoint(end_col, end_row));
 }
 
 std::string TileLayout::getUrl(const TileAddress& address) const
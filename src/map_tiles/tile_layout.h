@@ -6,6 +6,7 @@
 #include <vector>
 #include <QPointF>
 #include <QRectF>
+#include <QRect>
 
 namespace camp
 {
@@ -38,8 +39,12 @@ struct TileLayout
     // number of tile rows
     int matrix_height; 
 
-
+    // Area covered by the level in projected coordinates.
     QRectF boundingRect() const;
+
+    // Returns the range of tile indices that intersect area, in
+    // projected coordinates. The range is empty if no tiles do.
+    QRect indexRange(const QRectF& area) const;
   };
 
   std::vector<ZoomLevel> zoom_levels;
@@ -0,0 +1,207 @@
+#include "tile_seeder.h"
+#include "cached_tile_loader.h"
+#include "main/cached_file_loader.h"
+#include <QTimer>
+#include <QUrl>
+
+namespace camp
+{
+
+namespace map_tiles
+{
+
+const int TileSeeder::max_skips_per_tick_;
+
+TileSeeder::TileSeeder(const TileLayout* layout, const CachedTileLoader* tile_loader, QObject* parent):
+  QObject(parent), layout_(layout), tile_loader_(tile_loader)
+{
+  timer_ = new QTimer(this);
+  connect(timer_, &QTimer::timeout, this, &TileSeeder::tick);
+  setMaxRequestsPerSecond(10.0);
+}
+
+void TileSeeder::start(QPolygonF area, int min_zoom_level, int max_zoom_level)
+{
+  stop();
+
+  area_ = area;
+  min_zoom_level = std::max(0, min_zoom_level);
+  max_zoom_level_ = std::min<int>(layout_->zoom_levels.size()-1, max_zoom_level);
+
+  statistics_ = Statistics();
+  for(int zoom_level = min_zoom_level; zoom_level <= max_zoom_level_; zoom_level++)
+  {
+    auto range = layout_->zoom_levels[zoom_level].indexRange(area_.boundingRect());
+    if(!range.isEmpty())
+      statistics_.tile_count += quint64(range.width())*quint64(range.height());
+  }
+
+  zoom_level_ = min_zoom_level-1;
+  index_range_ = QRect();
+  index_ = QPoint();
+  done_enumerating_ = false;
+  enumeration_complete_ = false;
+  has_held_address_ = false;
+  downloaded_bytes_ = 0;
+  elapsed_.start();
+
+  timer_->start();
+  emit statisticsChanged();
+}
+
+void TileSeeder::stop()
+{
+  timer_->stop();
+  done_enumerating_ = true;
+  has_held_address_ = false;
+}
+
+bool TileSeeder::isRunning() const
+{
+  return timer_->isActive() || requests_in_flight_ > 0;
+}
+
+void TileSeeder::setMaxRequestsPerSecond(double rate)
+{
+  if(rate > 0.0)
+    timer_->setInterval(std::max(1, int(1000.0/rate)));
+}
+
+void TileSeeder::setMaxRequestsPerHost(int count)
+{
+  max_requests_per_host_ = std::max(1, count);
+}
+
+const TileSeeder::Statistics& TileSeeder::statistics() const
+{
+  return statistics_;
+}
+
+bool TileSeeder::nextAddress(TileAddress& address)
+{
+  while(!done_enumerating_)
+  {
+    if(index_range_.isEmpty() || index_.y() > index_range_.bottom())
+    {
+      zoom_level_++;
+      if(zoom_level_ > max_zoom_level_)
+      {
+        done_enumerating_ = true;
+        enumeration_complete_ = true;
+        return false;
+      }
+      index_range_ = layout_->zoom_levels[zoom_level_].indexRange(area_.boundingRect());
+      index_ = index_range_.topLeft();
+      continue;
+    }
+
+    TileAddress candidate(layout_, zoom_level_, index_);
+
+    index_.rx()++;
+    if(index_.x() > index_range_.right())
+    {
+      index_.setX(index_range_.left());
+      index_.ry()++;
+    }
+
+    statistics_.visited_count++;
+    if(area_.intersects(QPolygonF(candidate.boundingRect())))
+    {
+      address = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
+void TileSeeder::tick()
+{
+  auto loader = CachedFileLoader::get();
+  if(!loader)
+    return;
+
+  // Find one tile that needs to be downloaded, skipping cached ones
+  // without spending a request.
+  for(int i = 0; i < max_skips_per_tick_ && !has_held_address_; i++)
+  {
+    TileAddress address;
+    if(!nextAddress(address))
+      break;
+    if(loader->hasCachedCopy(tile_loader_->cacheFilePath(address)))
+      statistics_.cached_count++;
+    else
+    {
+      held_address_ = address;
+      has_held_address_ = true;
+    }
+  }
+
+  if(has_held_address_)
+  {
+    QString url = held_address_.url().c_str();
+    auto host = QUrl(url).host();
+    if(requests_per_host_[host] < max_requests_per_host_)
+    {
+      CachedFileClient* client = new CachedFileClient(this);
+      connect(client, &CachedFileClient::dataLoaded, this, &TileSeeder::dataLoaded);
+      connect(client, &CachedFileClient::loadFailed, this, &TileSeeder::loadFailed);
+      client->setProperty("host", host);
+
+      requests_per_host_[host]++;
+      requests_in_flight_++;
+      has_held_address_ = false;
+
+      loader->load(url, tile_loader_->cacheFilePath(held_address_), client);
+    }
+  }
+
+  if(done_enumerating_ && !has_held_address_)
+  {
+    timer_->stop();
+    if(requests_in_flight_ == 0 && enumeration_complete_)
+      emit finished();
+  }
+
+  updateRates();
+  emit statisticsChanged();
+}
+
+void TileSeeder::dataLoaded(QByteArray &data, CachedFileClient* client)
+{
+  statistics_.downloaded_count++;
+  downloaded_bytes_ += data.size();
+  requestDone(client);
+}
+
+void TileSeeder::loadFailed(CachedFileClient* client)
+{
+  statistics_.failed_count++;
+  requestDone(client);
+}
+
+void TileSeeder::requestDone(CachedFileClient* client)
+{
+  requests_per_host_[client->property("host").toString()]--;
+  requests_in_flight_--;
+  client->deleteLater();
+
+  updateRates();
+  emit statisticsChanged();
+
+  if(requests_in_flight_ == 0 && !timer_->isActive() && enumeration_complete_)
+    emit finished();
+}
+
+void TileSeeder::updateRates()
+{
+  double seconds = elapsed_.elapsed()/1000.0;
+  if(seconds > 0.0)
+  {
+    statistics_.tiles_per_second = statistics_.downloaded_count/seconds;
+    statistics_.bytes_per_second = downloaded_bytes_/seconds;
+  }
+}
+
+} // namespace map_tiles
+
+} // namespace camp
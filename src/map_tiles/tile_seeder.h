@@ -0,0 +1,117 @@
+#ifndef MAP_TILES_TILE_SEEDER_H
+#define MAP_TILES_TILE_SEEDER_H
+
+#include <QObject>
+#include <QPolygonF>
+#include <QHash>
+#include <QElapsedTimer>
+#include "tile_address.h"
+
+class QTimer;
+
+namespace camp
+{
+
+class CachedFileClient;
+
+namespace map_tiles
+{
+
+class CachedTileLoader;
+
+// Downloads the tiles of a layout covering an area over a range
+// of zoom levels into the tile cache so they are available offline.
+// Requests are rate limited and the number of concurrent requests
+// to each host is capped to respect tile server usage policies.
+// Tiles already in the cache are skipped, so starting an interrupted
+// job again resumes where it left off.
+class TileSeeder: public QObject
+{
+  Q_OBJECT
+public:
+  TileSeeder(const TileLayout* layout, const CachedTileLoader* tile_loader, QObject* parent = nullptr);
+
+  // Starts seeding tiles intersecting area, in projected coordinates.
+  void start(QPolygonF area, int min_zoom_level, int max_zoom_level);
+  void stop();
+  bool isRunning() const;
+
+  void setMaxRequestsPerSecond(double rate);
+  void setMaxRequestsPerHost(int count);
+
+  struct Statistics
+  {
+    // Number of tile indices covered by the area's bounding box
+    // over the zoom range.
+    quint64 tile_count = 0;
+
+    // Tiles done so far, including skipped ones.
+    quint64 visited_count = 0;
+
+    quint64 downloaded_count = 0;
+    quint64 cached_count = 0;
+    quint64 failed_count = 0;
+
+    double tiles_per_second = 0.0;
+    double bytes_per_second = 0.0;
+  };
+
+  const Statistics& statistics() const;
+
+signals:
+  void statisticsChanged();
+  void finished();
+
+private slots:
+  void tick();
+  void dataLoaded(QByteArray &data, CachedFileClient* client);
+  void loadFailed(CachedFileClient* client);
+
+private:
+  // Advances the cursor to the next tile intersecting the area.
+  // Returns false once all zoom levels are done.
+  bool nextAddress(TileAddress& address);
+
+  void requestDone(CachedFileClient* client);
+  void updateRates();
+
+  const TileLayout* layout_;
+  const CachedTileLoader* tile_loader_;
+
+  QPolygonF area_;
+  int max_zoom_level_ = 0;
+
+  // Position of the enumeration.
+  int zoom_level_ = 0;
+  QRect index_range_;
+  QPoint index_;
+  bool done_enumerating_ = true;
+
+  // True once every zoom level has been enumerated, as opposed
+  // to being stopped.
+  bool enumeration_complete_ = false;
+
+  // Address that could not be requested yet because its
+  // host was busy.
+  bool has_held_address_ = false;
+  TileAddress held_address_;
+
+  QHash<QString, int> requests_per_host_;
+  int requests_in_flight_ = 0;
+  int max_requests_per_host_ = 2;
+
+  QTimer* timer_;
+  QElapsedTimer elapsed_;
+  quint64 downloaded_bytes_ = 0;
+
+  Statistics statistics_;
+
+  // Cached tiles checked per tick before yielding to the event loop.
+  static constexpr int max_skips_per_tick_ = 2000;
+};
+
+} // namespace map_tiles
+
+} // namespace camp
+
+#endif
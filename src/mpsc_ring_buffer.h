@@ -0,0 +1,87 @@
+#ifndef CAMP_MPSC_RING_BUFFER_H
+#define CAMP_MPSC_RING_BUFFER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Bounded lock-free queue for many producer threads and a single
+// consumer. Each slot carries a sequence number telling producers and
+// the consumer whose turn it is, so neither side ever blocks. T should
+// be trivially copyable so pushing doesn't allocate.
+template <typename T> class MPSCRingBuffer
+{
+public:
+  // capacity is rounded up to a power of two.
+  explicit MPSCRingBuffer(std::size_t capacity)
+  {
+    std::size_t size = 2;
+    while(size < capacity)
+      size *= 2;
+    m_mask = size - 1;
+    m_cells.reset(new Cell[size]);
+    for(std::size_t i = 0; i < size; i++)
+      m_cells[i].sequence.store(i, std::memory_order_relaxed);
+  }
+
+  // Returns false if the buffer is full.
+  bool push(const T& value)
+  {
+    Cell* cell;
+    std::size_t position = m_enqueue_position.load(std::memory_order_relaxed);
+    while(true)
+    {
+      cell = &m_cells[position & m_mask];
+      std::size_t sequence = cell->sequence.load(std::memory_order_acquire);
+      std::intptr_t difference = std::intptr_t(sequence) - std::intptr_t(position);
+      if(difference == 0)
+      {
+        if(m_enqueue_position.compare_exchange_weak(position, position+1, std::memory_order_relaxed))
+          break;
+      }
+      else if(difference < 0)
+        return false;
+      else
+        position = m_enqueue_position.load(std::memory_order_relaxed);
+    }
+    cell->value = value;
+    cell->sequence.store(position+1, std::memory_order_release);
+    return true;
+  }
+
+  // Only to be called from the consumer thread. Returns false if no
+  // value is ready.
+  bool pop(T& value)
+  {
+    Cell* cell = &m_cells[m_dequeue_position & m_mask];
+    std::size_t sequence = cell->sequence.load(std::memory_order_acquire);
+    if(std::intptr_t(sequence) - std::intptr_t(m_dequeue_position+1) < 0)
+      return false;
+    value = cell->value;
+    cell->sequence.store(m_dequeue_position + m_mask + 1, std::memory_order_release);
+    m_dequeue_position++;
+    return true;
+  }
+
+  std::size_t capacity() const
+  {
+    return m_mask + 1;
+  }
+
+private:
+  struct Cell
+  {
+    std::atomic<std::size_t> sequence;
+    T value;
+  };
+
+  std::unique_ptr<Cell[]> m_cells;
+  std::size_t m_mask;
+  // Kept on separate cache lines so producers and the consumer
+  // don't contend.
+  alignas(64) std::atomic<std::size_t> m_enqueue_position {0};
+  alignas(64) std::size_t m_dequeue_position = 0;
+};
+
+#endif
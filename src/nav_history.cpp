@@ -0,0 +1,224 @@
+#include "nav_history.h"
+#include <algorithm>
+#include <limits>
+
+NavHistory::NavHistory()
+{
+  // Full rate for a minute, then one a second for half an hour, then
+  // one every ten seconds.
+  m_tiers.emplace_back(0.0, 60.0);
+  m_tiers.emplace_back(1.0, 1800.0);
+  m_tiers.emplace_back(10.0, std::numeric_limits<double>::infinity());
+}
+
+void NavHistory::add(const LocationPositionHeadingTime& sample)
+{
+  auto& recent = m_tiers.front().samples;
+  if(recent.empty() || sample.time > recent.back().time)
+    push(recent, sample);
+  else if(sample.time == recent.back().time)
+  {
+    merge(recent.back(), sample);
+    auto& tier = m_tiers.front();
+    tier.changed_from = std::min<uint64_t>(tier.changed_from, tier.first_id + recent.size() - 1);
+  }
+  else
+    insert(sample);
+  thin();
+  trim();
+}
+
+void NavHistory::insert(const LocationPositionHeadingTime& sample)
+{
+  // Orientation and position arrive on separate topics so they can be
+  // a little out of order, but rarely by more than a few samples.
+  auto& recent = m_tiers.front().samples;
+  if(sample.time < recent.front().time)
+    return;
+  std::vector<LocationPositionHeadingTime> newer;
+  while(!recent.empty() && recent.back().time > sample.time)
+  {
+    newer.push_back(recent.back());
+    recent.pop_back();
+  }
+  auto& tier = m_tiers.front();
+  if(!recent.empty() && recent.back().time == sample.time)
+  {
+    merge(recent.back(), sample);
+    tier.changed_from = std::min<uint64_t>(tier.changed_from, tier.first_id + recent.size() - 1);
+  }
+  else
+  {
+    tier.changed_from = std::min<uint64_t>(tier.changed_from, tier.first_id + recent.size());
+    push(recent, sample);
+  }
+  for(auto i = newer.rbegin(); i != newer.rend(); i++)
+    push(recent, *i);
+}
+
+void NavHistory::thin()
+{
+  double latest = m_tiers.front().samples.back().time;
+  for(std::size_t i = 0; i+1 < m_tiers.size(); i++)
+  {
+    auto& samples = m_tiers[i].samples;
+    auto& next = m_tiers[i+1];
+    while(!samples.empty() && samples.front().time < latest - m_tiers[i].age)
+    {
+      if(next.samples.empty() || samples.front().time >= next.samples.back().time + next.period)
+        push(next.samples, samples.front());
+      popFront(m_tiers[i]);
+    }
+  }
+}
+
+void NavHistory::trim()
+{
+  if(m_duration <= 0.0)
+    return;
+  double oldest = m_tiers.front().samples.back().time - m_duration;
+  for(auto tier = m_tiers.rbegin(); tier != m_tiers.rend(); tier++)
+  {
+    while(!tier->samples.empty() && tier->samples.front().time < oldest)
+      popFront(*tier);
+    if(!tier->samples.empty())
+      break;
+  }
+}
+
+void NavHistory::push(RingBuffer<LocationPositionHeadingTime>& samples, const LocationPositionHeadingTime& sample)
+{
+  if(samples.full())
+    samples.setCapacity(std::max<std::size_t>(64, samples.capacity()*2));
+  samples.push_back(sample);
+}
+
+void NavHistory::popFront(Tier& tier)
+{
+  tier.samples.pop_front();
+  tier.first_id++;
+}
+
+void NavHistory::merge(LocationPositionHeadingTime& into, const LocationPositionHeadingTime& sample)
+{
+  if(sample.location.isValid())
+  {
+    into.location = sample.location;
+    into.pos = sample.pos;
+  }
+  if(!std::isnan(sample.heading))
+    into.heading = sample.heading;
+}
+
+void NavHistory::setDuration(double duration)
+{
+  m_duration = duration;
+  if(!empty())
+    trim();
+}
+
+std::size_t NavHistory::size() const
+{
+  std::size_t ret = 0;
+  for(const auto& tier: m_tiers)
+    ret += tier.samples.size();
+  return ret;
+}
+
+bool NavHistory::empty() const
+{
+  return m_tiers.front().samples.empty();
+}
+
+void NavHistory::clear()
+{
+  for(auto& tier: m_tiers)
+  {
+    tier.first_id += tier.samples.size();
+    tier.samples.clear();
+  }
+}
+
+LocationPositionHeadingTime& NavHistory::at(std::size_t i)
+{
+  for(auto tier = m_tiers.rbegin(); tier != m_tiers.rend(); tier++)
+  {
+    if(i < tier->samples.size())
+      return tier->samples[i];
+    i -= tier->samples.size();
+  }
+  return m_tiers.front().samples.back();
+}
+
+const LocationPositionHeadingTime& NavHistory::at(std::size_t i) const
+{
+  for(auto tier = m_tiers.rbegin(); tier != m_tiers.rend(); tier++)
+  {
+    if(i < tier->samples.size())
+      return tier->samples[i];
+    i -= tier->samples.size();
+  }
+  return m_tiers.front().samples.back();
+}
+
+std::size_t NavHistory::lowerBound(double time) const
+{
+  std::size_t first = 0;
+  std::size_t count = size();
+  while(count > 0)
+  {
+    std::size_t step = count/2;
+    if(at(first+step).time < time)
+    {
+      first += step+1;
+      count -= step+1;
+    }
+    else
+      count = step;
+  }
+  return first;
+}
+
+LocationPositionHeadingTime NavHistory::latestLocation() const
+{
+  for(std::size_t i = size(); i > 0; i--)
+    if(at(i-1).location.isValid())
+      return at(i-1);
+  return {};
+}
+
+LocationPositionHeadingTime NavHistory::latestHeading() const
+{
+  for(std::size_t i = size(); i > 0; i--)
+    if(!std::isnan(at(i-1).heading))
+      return at(i-1);
+  return {};
+}
+
+std::size_t NavHistory::tierCount() const
+{
+  return m_tiers.size();
+}
+
+std::size_t NavHistory::tierSize(std::size_t tier) const
+{
+  return m_tiers[tier].samples.size();
+}
+
+const LocationPositionHeadingTime& NavHistory::tierAt(std::size_t tier, std::size_t i) const
+{
+  return m_tiers[tier].samples[i];
+}
+
+uint64_t NavHistory::tierFirstId(std::size_t tier) const
+{
+  return m_tiers[tier].first_id;
+}
+
+uint64_t NavHistory::takeTierChanges(std::size_t tier)
+{
+  auto& t = m_tiers[tier];
+  uint64_t ret = std::min<uint64_t>(t.changed_from, t.first_id + t.samples.size());
+  t.changed_from = std::numeric_limits<uint64_t>::max();
+  return ret;
+}
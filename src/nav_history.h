@@ -0,0 +1,88 @@
+#ifndef CAMP_NAV_HISTORY_H
+#define CAMP_NAV_HISTORY_H
+
+#include "locationposition.h"
+#include "ring_buffer.h"
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// Time ordered position and heading history, kept at full rate for
+// the recent past and thinned out as it ages.
+//
+// Samples live in tiers, newest first. Each tier holds samples up to
+// a given age at no more than one per period, and samples that age
+// out of a tier are passed to the next one or dropped if they are too
+// close to the sample before them. Tiers are ring buffers that double
+// when full, so adding a sample and thinning are amortized O(1) and
+// lookup by time is a binary search.
+class NavHistory
+{
+public:
+  NavHistory();
+
+  // Adds a sample, merging it with an existing one at the same time.
+  // Samples older than the full rate tier are dropped.
+  void add(const LocationPositionHeadingTime& sample);
+
+  // How long samples are kept in seconds. Forever if 0.
+  void setDuration(double duration);
+
+  std::size_t size() const;
+  bool empty() const;
+  void clear();
+
+  // Index 0 is the oldest sample.
+  LocationPositionHeadingTime& at(std::size_t i);
+  const LocationPositionHeadingTime& at(std::size_t i) const;
+
+  // Index of the first sample at or after time, or size() if there
+  // is none.
+  std::size_t lowerBound(double time) const;
+
+  // Newest samples with a valid location and with a heading, or an
+  // empty one if there is none.
+  LocationPositionHeadingTime latestLocation() const;
+  LocationPositionHeadingTime latestHeading() const;
+
+  // Access to the tiers, newest first, for caches built from them.
+  // Samples are numbered in the order they entered their tier, so a
+  // cache can tell which of its samples are still there.
+  std::size_t tierCount() const;
+  std::size_t tierSize(std::size_t tier) const;
+  const LocationPositionHeadingTime& tierAt(std::size_t tier, std::size_t i) const;
+  // Number of tierAt(tier, 0).
+  uint64_t tierFirstId(std::size_t tier) const;
+  // Lowest numbered sample of the tier changed in place or shifted by
+  // an insert since the last call, or the tier's end if none.
+  uint64_t takeTierChanges(std::size_t tier);
+
+private:
+  struct Tier
+  {
+    Tier(double period, double age): period(period), age(age) {}
+
+    // Minimum seconds between samples.
+    double period;
+    // Age in seconds at which samples move to the next tier.
+    double age;
+    RingBuffer<LocationPositionHeadingTime> samples;
+    uint64_t first_id = 0;
+    uint64_t changed_from = std::numeric_limits<uint64_t>::max();
+  };
+
+  // Inserts a sample older than the newest one into the full rate
+  // tier.
+  void insert(const LocationPositionHeadingTime& sample);
+  void thin();
+  void trim();
+  static void push(RingBuffer<LocationPositionHeadingTime>& samples, const LocationPositionHeadingTime& sample);
+  static void popFront(Tier& tier);
+  static void merge(LocationPositionHeadingTime& into, const LocationPositionHeadingTime& sample);
+
+  // Newest first.
+  std::vector<Tier> m_tiers;
+  double m_duration = 0.0;
+};
+
+#endif
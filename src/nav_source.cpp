@@ -1,22 +1,27 @@
 #include "nav_source.h"
 #include <tf2/utils.h>
 #include <QPainter>
+#include <QStyleOptionGraphicsItem>
 #include <QTimer>
+#include <QElapsedTimer>
 #include <QDebug>
 
 NavSource::NavSource(const project11_msgs::NavSource& source, QObject* parent, QGraphicsItem *parentItem): QObject(parent), GeoGraphicsItem(parentItem)
 {
   setColor(color_);
+  setFlag(QGraphicsItem::ItemUsesExtendedStyleOption);
   pending_position_topic_ = source.position_topic;
   pending_orientation_topic_ = source.orientation_topic;
   pending_velocity_topic_ = source.velocity_topic;
   setObjectName(source.name.c_str());
+  openJournal();
   trySubscribe();
 }
 
 NavSource::NavSource(std::pair<const std::string, XmlRpc::XmlRpcValue> &source, QObject* parent, QGraphicsItem *parentItem): QObject(parent), GeoGraphicsItem(parentItem)
 {
   setColor(color_);
+  setFlag(QGraphicsItem::ItemUsesExtendedStyleOption);
   if (source.second.hasMember("position_topic"))
     pending_position_topic_ = std::string(source.second["position_topic"]);
   if (source.second.hasMember("orientation_topic"))
@@ -24,6 +29,7 @@ NavSource::NavSource(std::pair<const std::string, XmlRpc::XmlRpcValue> &source,
   if (source.second.hasMember("velocity_topic"))
     pending_velocity_topic_ = std::string(source.second["velocity_topic"]);
   setObjectName(source.first.c_str());
+  openJournal();
   trySubscribe();
 }
 
@@ -87,23 +93,35 @@ void NavSource::trySubscribe()
 
 QRectF NavSource::boundingRect() const
 {
-  return shape().boundingRect().marginsAdded(QMargins(2,2,2,2));
+  if(!std::isnan(display_time_))
+    return (replay_paths_.first.boundingRect() | replay_paths_.second.boundingRect()).marginsAdded(QMargins(2,2,2,2));
+  QRectF ret;
+  for(const auto& cache: track_caches_)
+    if(!cache.empty())
+    {
+      // Padded so a track with no width or height isn't ignored.
+      QRectF bounds = cache.boundingRect().adjusted(-.5, -.5, .5, .5);
+      ret = ret.isNull() ? bounds : (ret | bounds);
+    }
+  return ret.marginsAdded(QMargins(2,2,2,2));
 }
 
 void NavSource::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget)
 {
   painter->save();
 
+  // The full rate tier covers the last minute and is drawn solid.
   QPen p1;
   p1.setCosmetic(true);
   p1.setColor(color_);
   p1.setWidth(2);
   painter->setPen(p1);
 
-  auto s = shapes();
-
-  auto l = location();
-  painter->drawPath(s.first);
+  bool replay = !std::isnan(display_time_);
+  if(replay)
+    painter->drawPath(replay_paths_.first);
+  else if(!track_caches_.empty())
+    track_caches_.front().paint(painter, option->exposedRect);
 
   QPen p2;
   p2.setCosmetic(true);
@@ -111,7 +129,14 @@ void NavSource::paint(QPainter* painter, const QStyleOptionGraphicsItem* option,
   p2.setWidth(1);
   painter->setPen(p2);
 
-  painter->drawPath(s.second);
+  if(replay)
+    painter->drawPath(replay_paths_.second);
+  else
+  {
+    for(std::size_t i = 1; i < track_caches_.size(); i++)
+      track_caches_[i].paint(painter, option->exposedRect);
+    painter->drawPath(tierJoins());
+  }
 
   painter->restore();
 }
@@ -119,61 +144,40 @@ void NavSource::paint(QPainter* painter, const QStyleOptionGraphicsItem* option,
 QPainterPath NavSource::shape() const
 {
   QPainterPath ret;
-  auto s = shapes();
-  ret.addPath(s.first);
-  ret.addPath(s.second);
+  if(!std::isnan(display_time_))
+  {
+    ret.addPath(replay_paths_.first);
+    ret.addPath(replay_paths_.second);
+    return ret;
+  }
+  for(const auto& cache: track_caches_)
+    cache.addTo(ret);
+  ret.addPath(tierJoins());
   return ret;
 }
 
-std::pair<QPainterPath, QPainterPath> NavSource::shapes() const
+QPainterPath NavSource::tierJoins() const
 {
-  auto paths = std::make_pair<QPainterPath,QPainterPath>({},{});
-  auto location_iterator = location_history_.rbegin();
-  auto last_point = location_history_.rend();
-  if(location_iterator != location_history_.rend())
-  {
-    double latest_time = location_iterator->first;
-    bool first_point = true;
-    while(location_iterator != location_history_.rend())
-    {
-      if(location_iterator->first < latest_time-60.0)
-        break;
-      if(location_iterator->second.location.isValid())
-        if(first_point)
-        {
-          paths.first.moveTo(location_iterator->second.pos);
-          first_point = false;
-        }
-        else
-        {
-          paths.first.lineTo(location_iterator->second.pos);
-          last_point = location_iterator;
-        }
-      location_iterator++;
-    }
-    if(last_point != location_history_.rend())
-    {
-      paths.second.moveTo(last_point->second.pos);
-      first_point = false;
-    }
-    else
-      first_point = true;
-    while(location_iterator != location_history_.rend())
+  QPainterPath ret;
+  const TrackPathCache* newer = nullptr;
+  for(const auto& cache: track_caches_)
+    if(!cache.empty())
     {
-      if(location_iterator->second.location.isValid())
-        if(first_point)
-        {
-          paths.second.moveTo(location_iterator->second.pos);
-          first_point = false;
-        }
-        else
-        {
-          paths.second.lineTo(location_iterator->second.pos);
-        }
-      location_iterator++;
+      if(newer)
+      {
+        ret.moveTo(newer->firstPoint());
+        ret.lineTo(cache.lastPoint());
+      }
+      newer = &cache;
     }
-  }
-  return paths;
+  return ret;
+}
+
+void NavSource::updateTrackCaches()
+{
+  track_caches_.resize(location_history_.tierCount());
+  for(std::size_t i = 0; i < track_caches_.size(); i++)
+    track_caches_[i].update(location_history_, i, location_history_.takeTierChanges(i));
 }
 
 
@@ -230,49 +234,84 @@ void NavSource::updateLocation(QGeoCoordinate const &location, float heading, do
   emit beforeNavUpdate();
   prepareGeometryChange();
 
-  location_history_[time].time = time;
+  LocationPositionHeadingTime sample;
+  sample.time = time;
   if(location.isValid())
   {
-    location_history_[time].location = location;
+    sample.location = location;
     auto bg = findParentBackgroundRaster();
     if(bg)
-      location_history_[time].pos = geoToPixel(location, bg);
+      sample.pos = geoToPixel(location, bg);
   }
-  if(!isnan(heading))
-    location_history_[time].heading = heading;
+  sample.heading = heading;
+  location_history_.add(sample);
+  updateTrackCaches();
 
-  // trim samples that are older than buffer durration, if applicable.
-  while(buffer_duration_ > 0.0 && !location_history_.empty() && location_history_.rbegin()->first-buffer_duration_ > location_history_.begin()->first)
-    location_history_.erase(location_history_.begin()->first);
+  if(history_store_ && location.isValid())
+  {
+    float h = isnan(heading) ? location_history_.latestHeading().heading : heading;
+    if(history_entity_ < 0)
+      history_entity_ = history_store_->entity(history_name_);
+    history_store_->add(history_entity_, {time, location.latitude(), location.longitude(), h, std::nanf(""), std::nanf("")});
+  }
 
-  // thin older data
-  if(!location_history_.empty())
+  if(journal_.isOpen())
   {
-    double low_res_end_time = location_history_.rbegin()->first - high_resolution_duration_;
-    std::vector<double> discard_pile;
-    auto location_iterator = location_history_.begin();
-    double last_keep_time = location_iterator->first;
-    location_iterator++;
-    while(location_iterator != location_history_.end() && location_iterator->first < low_res_end_time)
+    track_journal::Record record;
+    record.stamp_ns = time*1.0e9;
+    record.latitude = location.isValid() ? location.latitude() : std::nan("");
+    record.longitude = location.isValid() ? location.longitude() : std::nan("");
+    record.id = 0;
+    record.heading = heading;
+    record.cog = std::nan("");
+    record.sog = std::nan("");
+    journal_.append(record);
+  }
+
+  if(location.isValid())
+    emit positionUpdate(location);
+}
+
+void NavSource::openJournal()
+{
+  QString name = "nav_";
+  if(parent())
+    name += parent()->objectName() + "_";
+  name += objectName();
+  QString path = track_journal::path(name);
+  if(path.isEmpty())
+    return;
+
+  double reload = track_journal::reloadSeconds();
+  TrackJournalReader reader;
+  if(reader.open(path))
+  {
+    QElapsedTimer timer;
+    timer.start();
+    // Records carry the header stamps, so this uses ROS time too, which
+    // may be simulated.
+    int64_t since = ros::Time::now().toNSec() - int64_t(reload*1.0e9);
+    auto bg = findParentBackgroundRaster();
+    for(std::size_t i = reader.seek(since); i < reader.size(); i++)
     {
-      if(location_iterator->first >= last_keep_time+low_resolution_period_)
+      const auto& record = reader.records()[i];
+      if(record.stamp_ns < since || !track_journal::valid(record))
+        continue;
+      LocationPositionHeadingTime sample;
+      sample.time = record.stamp_ns/1.0e9;
+      if(!std::isnan(record.latitude))
       {
-        last_keep_time = location_iterator->first;
+        sample.location = QGeoCoordinate(record.latitude, record.longitude);
+        if(bg)
+          sample.pos = geoToPixel(sample.location, bg);
       }
-      else
-      {
-        discard_pile.push_back(location_iterator->first);
-      }
-      location_iterator++;
+      sample.heading = record.heading;
+      location_history_.add(sample);
     }
-
-    for(auto discard: discard_pile)
-      location_history_.erase(discard);
+    updateTrackCaches();
+    ROS_INFO_STREAM("Reloaded " << location_history_.size() << " fixes for " << name.toStdString() << " in " << timer.elapsed() << " ms");
   }
-
-
-  if(location.isValid())
-    emit positionUpdate(location);
+  journal_.open(path, reload);
 }
 
 void NavSource::updateProjectedPoints()
@@ -280,35 +319,146 @@ void NavSource::updateProjectedPoints()
   prepareGeometryChange();
   auto bg = findParentBackgroundRaster();
   if(bg)
-    for(auto& lp: location_history_)
-      lp.second.pos = geoToPixel(lp.second.location, bg);
+    for(std::size_t i = 0; i < location_history_.size(); i++)
+    {
+      auto& lp = location_history_.at(i);
+      lp.pos = geoToPixel(lp.location, bg);
+    }
+  for(auto& cache: track_caches_)
+    cache.clear();
+  updateTrackCaches();
+  if(!std::isnan(display_time_))
+    updateReplayPaths(display_time_);
 }
 
 LocationPositionHeadingTime NavSource::location() const
 {
-  auto location_iterator = location_history_.rbegin();
-  while(location_iterator != location_history_.rend())
-    if(location_iterator->second.location.isValid())
-      return location_iterator->second;
-    else
-      location_iterator++;
-  return {};
+  return location_history_.latestLocation();
 }
 
 LocationPositionHeadingTime NavSource::heading() const
 {
-  auto location_iterator = location_history_.rbegin();
-  while(location_iterator != location_history_.rend())
-    if(!isnan(location_iterator->second.heading))
-      return location_iterator->second;
-    else
-      location_iterator++;
-  return {};
+  return location_history_.latestHeading();
 }
 
 void NavSource::setHistoryDuration(double duration)
 {
-  buffer_duration_ = duration;
+  prepareGeometryChange();
+  location_history_.setDuration(duration);
+  updateTrackCaches();
+}
+
+LocationPositionHeadingTime NavSource::displayLocation() const
+{
+  if(std::isnan(display_time_))
+    return location();
+  return replay_location_;
+}
+
+LocationPositionHeadingTime NavSource::displayHeading() const
+{
+  if(std::isnan(display_time_))
+    return heading();
+  return replay_location_;
+}
+
+void NavSource::setHistoryStore(HistoryStore* store, QString name)
+{
+  if(history_store_)
+    disconnect(history_store_, nullptr, this, nullptr);
+  history_store_ = store;
+  history_name_ = name;
+  history_entity_ = -1;
+  if(!store)
+    return;
+  history_entity_ = store->entity(name);
+  connect(store, &HistoryStore::entityRemoved, this, [this](int entity)
+  {
+    if(entity == history_entity_)
+      history_entity_ = -1;
+  });
+  float heading = std::nanf("");
+  for(std::size_t i = 0; i < location_history_.size(); i++)
+  {
+    const auto& lp = location_history_.at(i);
+    if(!isnan(lp.heading))
+      heading = lp.heading;
+    if(lp.location.isValid())
+      store->add(history_entity_, {lp.time, lp.location.latitude(), lp.location.longitude(), heading, std::nanf(""), std::nanf("")});
+  }
+}
+
+void NavSource::setDisplayTime(double time)
+{
+  prepareGeometryChange();
+  display_time_ = time;
+  if(!std::isnan(time))
+    updateReplayPaths(time);
+  else
+    replay_paths_ = {};
+}
+
+void NavSource::updateReplayPaths(double time)
+{
+  replay_location_ = LocationPositionHeadingTime();
+  auto bg = findParentBackgroundRaster();
+  HistoryStore::State state;
+  if(history_store_ && history_store_->stateAt(history_entity_, time, state))
+  {
+    replay_location_.location = QGeoCoordinate(state.latitude, state.longitude);
+    replay_location_.heading = state.heading;
+    replay_location_.time = time;
+    if(bg)
+      replay_location_.pos = geoToPixel(replay_location_.location, bg);
+  }
+
+  // Same split as live: the minute before time solid, the rest dimmed.
+  replay_paths_ = {};
+  std::size_t i = location_history_.lowerBound(time);
+  bool first_point = true;
+  if(replay_location_.location.isValid())
+  {
+    replay_paths_.first.moveTo(replay_location_.pos);
+    first_point = false;
+  }
+  QPointF last_point;
+  bool have_last_point = false;
+  while(i > 0)
+  {
+    const auto& lp = location_history_.at(i-1);
+    if(lp.time < time-60.0)
+      break;
+    if(lp.location.isValid())
+    {
+      if(first_point)
+        replay_paths_.first.moveTo(lp.pos);
+      else
+        replay_paths_.first.lineTo(lp.pos);
+      first_point = false;
+      last_point = lp.pos;
+      have_last_point = true;
+    }
+    i--;
+  }
+  first_point = true;
+  if(have_last_point)
+  {
+    replay_paths_.second.moveTo(last_point);
+    first_point = false;
+  }
+  while(i > 0)
+  {
+    const auto& lp = location_history_.at(i-1);
+    if(lp.location.isValid())
+    {
+      if(first_point)
+        replay_paths_.second.moveTo(lp.pos);
+      else
+        replay_paths_.second.lineTo(lp.pos);
+      first_point = false;
+    }
+    i--;
+  }
 }
 
 void NavSource::setColor(QColor color)
@@ -5,6 +5,10 @@
 #include "ros/ros.h"
 #include "project11_msgs/NavSource.h"
 #include "locationposition.h"
+#include "nav_history.h"
+#include "track_path_cache.h"
+#include "track_journal.h"
+#include "history_store.h"
 #include "sensor_msgs/NavSatFix.h"
 #include "sensor_msgs/Imu.h"
 #include "geometry_msgs/TwistWithCovarianceStamped.h"
@@ -25,11 +29,16 @@ public:
   void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget) override;
   QPainterPath shape() const override;
 
-  std::pair<QPainterPath, QPainterPath> shapes() const;
-
   LocationPositionHeadingTime location() const;
   LocationPositionHeadingTime heading() const;
 
+  /// Location and heading at the display time, the latest when live.
+  LocationPositionHeadingTime displayLocation() const;
+  LocationPositionHeadingTime displayHeading() const;
+
+  /// Records fixes in store under name, including those already received.
+  void setHistoryStore(HistoryStore* store, QString name);
+
   void setColor(QColor color);
 
 signals:
@@ -43,10 +52,20 @@ public slots:
 
   /// Set buffer duration in seconds 
   void setHistoryDuration(double duration);
+  /// Shows the track as it was at time, or live if time is NaN.
+  void setDisplayTime(double time);
   void updateSog(double sog);
   void trySubscribe();
 
 private:
+  // Segments joining each tier's track to the next newer one.
+  QPainterPath tierJoins() const;
+  void updateTrackCaches();
+  /// Reloads recent history from the journal and starts journaling.
+  void openJournal();
+  /// Track up to time, split into the last minute and the rest.
+  void updateReplayPaths(double time);
+
   void positionCallback(const sensor_msgs::NavSatFix::ConstPtr& message);
   void orientationCallback(const sensor_msgs::Imu::ConstPtr& message);
   void velocityCallback(const geometry_msgs::TwistWithCovarianceStamped::ConstPtr& message);
@@ -61,17 +80,24 @@ private:
   std::string pending_orientation_topic_;
   std::string pending_velocity_topic_;
 
-  std::map<double, LocationPositionHeadingTime> location_history_;
+  /// Full rate for the last minute, thinned out beyond that.
+  NavHistory location_history_;
+
+  /// Track lines through each tier of the history.
+  std::vector<TrackPathCache> track_caches_;
+
+  TrackJournalWriter journal_;
 
-  /// How long data should be kept in seconds. Forever if 0.
-  double buffer_duration_ = 0.0;
+  HistoryStore* history_store_ = nullptr;
+  QString history_name_;
+  /// -1 once the store removes the entity, until the next fix.
+  int history_entity_ = -1;
 
-  /// How long to keep full rate data in seconds.
-  double high_resolution_duration_ = 60.0;
+  /// NaN when live.
+  double display_time_ = std::nan("");
+  LocationPositionHeadingTime replay_location_;
+  std::pair<QPainterPath, QPainterPath> replay_paths_;
 
-  /// Low resolution period in seconds between samples
-  double low_resolution_period_ = 1.0;
-  
   QColor color_ = Qt::red;
   QColor dim_color_;
 
@@ -2,6 +2,7 @@
 #include "ui_platform.h"
 #include <QPainter>
 #include "nav_source.h"
+#include "history_store.h"
 #include "backgroundraster.h"
 
 #include <QDebug>
@@ -57,10 +58,10 @@ QPainterPath Platform::shape() const
         LocationPositionHeadingTime location, heading;
         for(const auto& ns: m_nav_sources)
         {
-          auto possible_location = ns.second->location();
+          auto possible_location = ns.second->displayLocation();
           if(possible_location.location.isValid() && possible_location.time > location.time)
             location = possible_location;
-          auto possible_heading = ns.second->heading();
+          auto possible_heading = ns.second->displayHeading();
           if(!isnan(possible_heading.heading) && possible_heading.time > heading.time)
             heading = possible_heading;
         }
@@ -78,6 +79,36 @@ QPainterPath Platform::shape() const
   return ret;
 }
 
+void Platform::addNavSource(const std::string& name, NavSource* nav_source)
+{
+  m_nav_sources[name] = nav_source;
+  nav_source->setHistoryDuration(7200);
+  connect(nav_source, &NavSource::beforeNavUpdate, this, &Platform::aboutToUpdateNav);
+  connect(nav_source, &NavSource::positionUpdate, this, &Platform::updatePosition);
+  if(m_nav_sources.size() == 1)
+    connect(nav_source, &NavSource::sog, this, &Platform::updateSog);
+  if(m_history_store)
+    nav_source->setHistoryStore(m_history_store, "nav/" + objectName() + "/" + name.c_str());
+}
+
+void Platform::setHistoryStore(HistoryStore* store)
+{
+  if(store == m_history_store)
+    return;
+  m_history_store = store;
+  for(auto ns: m_nav_sources)
+    ns.second->setHistoryStore(store, "nav/" + objectName() + "/" + ns.first.c_str());
+}
+
+void Platform::setDisplayTime(double time)
+{
+  prepareGeometryChange();
+  for(auto ns: m_nav_sources)
+    ns.second->setDisplayTime(time);
+  updateLabel();
+  QGraphicsItem::update();
+}
+
 void Platform::update(project11_msgs::Platform& platform)
 {
   if(objectName().toStdString() != platform.name)
@@ -109,12 +140,7 @@ void Platform::update(project11_msgs::Platform& platform)
   for(auto ns: platform.nav_sources)
     if(m_nav_sources.find(ns.name) == m_nav_sources.end())
     {
-      m_nav_sources[ns.name] = new NavSource(ns, this, this);
-      m_nav_sources[ns.name]->setHistoryDuration(7200);
-      connect(m_nav_sources[ns.name], &NavSource::beforeNavUpdate, this, &Platform::aboutToUpdateNav);
-      connect(m_nav_sources[ns.name], &NavSource::positionUpdate, this, &Platform::updatePosition);
-      if(m_nav_sources.size() == 1)
-        connect(m_nav_sources[ns.name], &NavSource::sog, this, &Platform::updateSog);
+      addNavSource(ns.name, new NavSource(ns, this, this));
       m_nav_sources[ns.name]->setColor(m_color);
     }
 
@@ -144,12 +170,7 @@ void Platform::update(std::pair<const std::string, XmlRpc::XmlRpcValue> &platfor
   if(platform.second.hasMember("nav_sources"))
     for(auto nav: platform.second["nav_sources"])
     {
-      m_nav_sources[nav.first] = new NavSource(nav, this, this);
-      m_nav_sources[nav.first]->setHistoryDuration(7200);
-      connect(m_nav_sources[nav.first], &NavSource::beforeNavUpdate, this, &Platform::aboutToUpdateNav);
-      connect(m_nav_sources[nav.first], &NavSource::positionUpdate, this, &Platform::updatePosition);
-      if(m_nav_sources.size() == 1)
-        connect(m_nav_sources[nav.first], &NavSource::sog, this, &Platform::updateSog);
+      addNavSource(nav.first, new NavSource(nav, this, this));
     }
   if(platform.second.hasMember("color"))
   {
@@ -195,7 +216,7 @@ void Platform::updateLabel()
   setLabel(objectName());
   if(!m_nav_sources.empty())
   {
-    setLabelPosition(m_nav_sources.begin()->second->location().pos);
+    setLabelPosition(m_nav_sources.begin()->second->displayLocation().pos);
   }
 }
 
@@ -219,6 +240,27 @@ void Platform::updateSog(double sog)
   m_ui->sogLineEdit->setText(sogLabel);
 }
 
+bool Platform::navigationState(QGeoCoordinate &position, double &heading, double &sog) const
+{
+  LocationPositionHeadingTime location, heading_location;
+  for(const auto& ns: m_nav_sources)
+  {
+    auto possible_location = ns.second->location();
+    if(possible_location.location.isValid() && possible_location.time > location.time)
+      location = possible_location;
+    auto possible_heading = ns.second->heading();
+    if(!isnan(possible_heading.heading) && possible_heading.time > heading_location.time)
+      heading_location = possible_heading;
+  }
+  if(!location.location.isValid())
+    return false;
+  position = location.location;
+  heading = heading_location.heading;
+  // m_sog is in knots
+  sog = m_sog/1.9438;
+  return true;
+}
+
 MissionManager* Platform::missionManager() const
 {
   return m_ui->missionManager;
@@ -12,6 +12,7 @@ namespace Ui
 }
 
 class NavSource;
+class HistoryStore;
 class MissionManager;
 class HelmManager;
 
@@ -31,6 +32,13 @@ public:
   void update(project11_msgs::Platform &platform);
   void update(std::pair<const std::string, XmlRpc::XmlRpcValue> &platform);
 
+  // Latest position, heading in degrees and speed over ground in m/s.
+  // Returns false until a position is known.
+  bool navigationState(QGeoCoordinate &position, double &heading, double &sog) const;
+
+  // Records the nav sources' fixes in store.
+  void setHistoryStore(HistoryStore* store);
+
   MissionManager* missionManager() const;
   HelmManager* helmManager() const;
 
@@ -43,6 +51,8 @@ public slots:
   void aboutToUpdateNav();
   void updateSog(double sog);
   void updatePosition(QGeoCoordinate position);
+  // Shows the platform as it was at time, or live if time is NaN.
+  void setDisplayTime(double time);
 
 protected:
   void hoverEnterEvent(QGraphicsSceneHoverEvent * event) override;
@@ -51,6 +61,8 @@ protected:
 private:
   void updateLabel();
   void setColor(QColor color);
+  // Sets up a newly created nav source.
+  void addNavSource(const std::string& name, NavSource* nav_source);
 
   Ui::Platform* m_ui;
 
@@ -59,8 +71,8 @@ private:
 
   ros::Subscriber m_sog_subscriber;
   QList<qreal> m_sog_history;
-  qreal m_sog;
-  qreal m_sog_avg;
+  qreal m_sog = 0.0;
+  qreal m_sog_avg = 0.0;
 
   float m_width = 0.0;
   float m_length = 0.0;
@@ -69,6 +81,8 @@ private:
 
   QColor m_color = QColor(0,0,255,255);
 
+  HistoryStore* m_history_store = nullptr;
+
 };
 
 #endif // PLATFORM_H
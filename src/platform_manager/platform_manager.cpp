@@ -2,6 +2,8 @@
 #include "ui_platform_manager.h"
 #include "platform.h"
 #include "backgroundraster.h"
+#include "geofence.h"
+#include <cmath>
 
 PlatformManager::PlatformManager(QWidget* parent):
   QWidget(parent),
@@ -27,6 +29,7 @@ void PlatformManager::loadFromParameters()
         m_platforms[platform.first] = new Platform(this, m_background);
         m_ui->tabWidget->addTab(m_platforms[platform.first], platform.first.c_str());
         m_platforms[platform.first]->update(platform);
+        m_platforms[platform.first]->setHistoryStore(m_history_store);
         connect(m_platforms[platform.first], &Platform::platformPosition, this, &PlatformManager::platformPosition);
       }
     }
@@ -41,6 +44,32 @@ PlatformManager::~PlatformManager()
   delete m_ui;
 }
 
+std::vector<Platform*> PlatformManager::platforms() const
+{
+  std::vector<Platform*> ret;
+  for(auto p: m_platforms)
+    ret.push_back(p.second);
+  return ret;
+}
+
+void PlatformManager::setHistoryStore(HistoryStore* store)
+{
+  m_history_store = store;
+  for(auto p: m_platforms)
+    p.second->setHistoryStore(store);
+}
+
+void PlatformManager::setGeofenceMonitor(GeofenceMonitor* monitor)
+{
+  m_geofence_monitor = monitor;
+}
+
+void PlatformManager::setDisplayTime(double time)
+{
+  for(auto p: m_platforms)
+    p.second->setDisplayTime(time);
+}
+
 void PlatformManager::platformListCallback(const project11_msgs::PlatformList::ConstPtr &message)
 {
   for(auto platform: message->platforms)
@@ -55,8 +84,10 @@ void PlatformManager::updatePlatform(project11_msgs::Platform platform)
   {
     m_platforms[platform.name] = new Platform(this, m_background);
     m_ui->tabWidget->addTab(m_platforms[platform.name], platform.name.c_str());
+    connect(m_platforms[platform.name], &Platform::platformPosition, this, &PlatformManager::platformPosition);
   }
   m_platforms[platform.name]->update(platform);
+  m_platforms[platform.name]->setHistoryStore(m_history_store);
 }
 
 void PlatformManager::updateBackground(BackgroundRaster * bg)
@@ -81,5 +112,14 @@ void PlatformManager::platformPosition(Platform * platform, QGeoCoordinate posit
 {
   if(m_ui->tabWidget->currentWidget() == platform)
     emit currentPlatformPosition(position);
+
+  if(m_geofence_monitor)
+  {
+    QGeoCoordinate latest;
+    double heading, sog;
+    if(platform->navigationState(latest, heading, sog))
+      // Without a heading, assume the platform is holding position.
+      m_geofence_monitor->update("platform/"+platform->objectName(), platform->objectName(), position, heading, std::isnan(heading) ? 0.0 : sog);
+  }
 }
   
\ No newline at end of file
@@ -15,6 +15,8 @@ namespace Ui
 
 class Platform;
 class BackgroundRaster;
+class HistoryStore;
+class GeofenceMonitor;
 
 class PlatformManager: public QWidget
 {
@@ -23,6 +25,14 @@ public:
   explicit PlatformManager(QWidget *parent=0);
   ~PlatformManager();
 
+  std::vector<Platform*> platforms() const;
+
+  // Records every platform's fixes in store.
+  void setHistoryStore(HistoryStore* store);
+
+  // Checks every platform position update against the avoid areas.
+  void setGeofenceMonitor(GeofenceMonitor* monitor);
+
 signals:
   void currentPlatform(Platform* platform);
   void currentPlatformPosition(QGeoCoordinate position);
@@ -31,6 +41,8 @@ public slots:
   void updateBackground(BackgroundRaster * bg);
   void loadFromParameters();
   void platformPosition(Platform * platform, QGeoCoordinate position);
+  // Shows the platforms as they were at time, or live if time is NaN.
+  void setDisplayTime(double time);
   
 private slots:
   void updatePlatform(project11_msgs::Platform platform);
@@ -46,6 +58,8 @@ private:
   std::map<std::string, Platform*> m_platforms;
 
   BackgroundRaster* m_background = nullptr;
+  HistoryStore* m_history_store = nullptr;
+  GeofenceMonitor* m_geofence_monitor = nullptr;
 };
 
 #endif
@@ -37,12 +37,17 @@ ProjectView::ProjectView(QWidget *parent) : QGraphicsView(parent),
 void ProjectView::wheelEvent(QWheelEvent *event)
 {
     if(event->angleDelta().y()<0)
-        scale(.8,.8);
+        zoom(.8);
     if(event->angleDelta().y()>0)
-        scale(1.25,1.25);
+        zoom(1.25);
+    event->accept();
+}
+
+void ProjectView::zoom(qreal factor)
+{
+    scale(factor,factor);
     emit scaleChanged(matrix().m11());
     sendViewport();
-    event->accept();
 }
 
 void ProjectView::mousePressEvent(QMouseEvent *event)
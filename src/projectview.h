@@ -31,6 +31,9 @@ public:
     void setPanMode();
     void setProject(AutonomousVehicleProject *project);
 
+    /// Scales the view by factor, as the mouse wheel does.
+    void zoom(qreal factor);
+
     bool isMouseModeAddAvoidArea() const;
 
 signals:
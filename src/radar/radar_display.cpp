@@ -1,24 +1,96 @@
 #include "radar_display.h"
 
 #include <cmath>
+#include <cstring>
 #include "autonomousvehicleproject.h"
 #include <QOffscreenSurface>
 #include <QOpenGLShader>
 #include <QPainter>
 #include <QOpenGLFramebufferObject>
 #include <QThread>
+#include <QTimer>
+#include <QElapsedTimer>
+#include "software_radar_renderer.h"
+#include "radar_targets_item.h"
 #include <tf2/utils.h>
 #include "gz4d_geo.h"
 #include <tf2_ros/transform_listener.h>
 #include <yaml-cpp/yaml.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+
+// Enough for a few frames worth of sectors at full rate.
+const std::size_t max_pooled_sectors = 64;
+
+// Seconds targets stay outlined, as long as returns persist.
+const double target_max_age = 3.0;
+
+// Converts echo intensities from 0.0-1.0 to 0-255, truncating and
+// saturating like the scalar cast it replaces.
+void convertEchoes(const float* in, uchar* out, std::size_t count)
+{
+  std::size_t i = 0;
+#ifdef __SSE2__
+  const __m128 scale = _mm_set1_ps(255.0f);
+  for(; i + 16 <= count; i += 16)
+  {
+    __m128i a = _mm_cvttps_epi32(_mm_mul_ps(_mm_loadu_ps(in+i), scale));
+    __m128i b = _mm_cvttps_epi32(_mm_mul_ps(_mm_loadu_ps(in+i+4), scale));
+    __m128i c = _mm_cvttps_epi32(_mm_mul_ps(_mm_loadu_ps(in+i+8), scale));
+    __m128i d = _mm_cvttps_epi32(_mm_mul_ps(_mm_loadu_ps(in+i+12), scale));
+    __m128i packed = _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out+i), packed);
+  }
+#endif
+  for(; i < count; i++)
+    out[i] = std::max(0.0f, std::min(255.0f, in[i]*255.0f));
+}
+
+} // namespace
 
 
 RadarDisplay::RadarDisplay(QObject* parent, QGraphicsItem *parentItem): QObject(parent), GeoGraphicsItem(parentItem)
 {
+  m_latency_clock.start();
+
+  m_targets_item = new RadarTargetsItem(this);
+  m_detector.reset(new RadarTargetDetector([this](QImage* image){releaseSectorImage(image);}));
+  m_detector->setThreshold(ros::param::param<int>("~radar_target_threshold", 100));
+  m_detector->setMinimumPixels(ros::param::param<int>("~radar_target_min_pixels", 4));
+  m_detector->setTargetsCallback([this](const std::vector<RadarTarget>& targets)
+  {
+    QMetaObject::invokeMethod(this, [this, targets]()
+    {
+      m_targets_item->addTargets(targets);
+    }, Qt::QueuedConnection);
+  });
+  // Sectors are stamped with ROS time, playback restamps them.
+  m_targets_timer = new QTimer(this);
+  connect(m_targets_timer, &QTimer::timeout, this, [this]()
+  {
+    m_targets_item->expireTargets(ros::Time::now(), target_max_age);
+  });
+  m_targets_timer->start(500);
+
   m_radarImageThread = QThread::create(std::bind(&RadarDisplay::updateRadarImage, this));
   m_radarImageThread->start();
 }
 
+RadarDisplay::~RadarDisplay()
+{
+  m_radarImageThread->requestInterruption();
+  m_radarImageThread->wait();
+  delete m_radarImageThread;
+  // The detector returns its queued images to the pool.
+  m_detector.reset();
+  for(auto image: m_image_pool)
+    delete image;
+}
+
 void RadarDisplay::setTF2Buffer(tf2_ros::Buffer* buffer)
 {
     m_tf_buffer = buffer;
@@ -32,6 +104,7 @@ void RadarDisplay::setMapFrame(std::string mapFrame)
 void RadarDisplay::setPixelSize(double s)
 {
     m_pixel_size = s;
+    m_targets_item->setPixelSize(s);
     //ROS_INFO_STREAM("Pixel size: " << s);
 }
 
@@ -46,7 +119,7 @@ void RadarDisplay::subscribe(QString topic)
     m_subscriber = ros::NodeHandle().subscribe(ops);
 }
 
-void RadarDisplay::initializeGL()
+bool RadarDisplay::initializeGL()
 {
     QSurfaceFormat surfaceFormat;
     surfaceFormat.setMajorVersion(4);
@@ -62,7 +135,8 @@ void RadarDisplay::initializeGL()
     if(!m_context->isValid())
     {
       ROS_ERROR_STREAM("OpenGL context not valid");
-      return;
+      releaseGL();
+      return false;
     }
 
     m_surface = new QOffscreenSurface();
@@ -71,7 +145,8 @@ void RadarDisplay::initializeGL()
     if(!m_surface->isValid())
     {
       ROS_ERROR_STREAM("OpenGL surface not valid");
-      return;
+      releaseGL();
+      return false;
     } 
 
     m_context->makeCurrent(m_surface);
@@ -81,7 +156,8 @@ void RadarDisplay::initializeGL()
     if (!m_fbo->isValid())
     {
       ROS_ERROR_STREAM("OpenGL fbo not valid");
-      return;
+      releaseGL();
+      return false;
     } 
     
 
@@ -127,12 +203,11 @@ void RadarDisplay::initializeGL()
         "    float r = length(texc.xy);\n"
         "    if(r>1.0) discard;\n"
         "    float theta = atan(texc.y, texc.x);\n"
-        "    if(minAngle > 0.0 && theta < 0.0) theta += 2.0*M_PI;\n"
-        "    if(theta < minAngle) discard;\n"
+        "    if(theta < minAngle) theta += 2.0*M_PI;\n"
         "    if(theta > maxAngle) discard;\n"
         "    vec4 radarData = texture2D(texture, vec2(r, (theta-minAngle)/(maxAngle-minAngle)));\n"
-        "    if(radarData.r < 0.01) discard;\n"
-        "    gl_FragColor = color*fade*radarData.r;\n"
+        "    // weak echoes clear what the previous sweep left at this bearing\n"
+        "    gl_FragColor = color*fade*radarData.r*step(0.01, radarData.r);\n"
         "    //gl_FragColor.a = radarData.r*fade;\n"
         "}\n";
     fshader->compileSourceCode(fsrc);
@@ -143,10 +218,45 @@ void RadarDisplay::initializeGL()
     m_program->bindAttributeLocation("vertex", PROGRAM_VERTEX_ATTRIBUTE);
     m_program->link();
 
+    // Multiplies the persistence buffer by the decay factor
+    // when drawn with glBlendFunc(GL_ZERO, GL_SRC_COLOR), or
+    // subtracts it with GL_FUNC_REVERSE_SUBTRACT.
+    QOpenGLShader *decay_fshader = new QOpenGLShader(QOpenGLShader::Fragment, m_context);
+    const char *decay_fsrc =
+        "uniform float decay;\n"
+        "void main(void)\n"
+        "{\n"
+        "    gl_FragColor = vec4(decay);\n"
+        "}\n";
+    decay_fshader->compileSourceCode(decay_fsrc);
+
+    m_decay_program = new QOpenGLShaderProgram;
+    m_decay_program->addShader(vshader);
+    m_decay_program->addShader(decay_fshader);
+    m_decay_program->bindAttributeLocation("vertex", PROGRAM_VERTEX_ATTRIBUTE);
+    m_decay_program->link();
+
     m_program->bind();
     m_program->setUniformValue("texture", 0);
 
-    m_opengl_initialized = true;
+    // The buffer is only cleared once, sectors accumulate and decay.
+    m_fbo->bind();
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    return true;
+}
+
+void RadarDisplay::releaseGL()
+{
+    // The framebuffer goes while its context is still current.
+    delete m_fbo;
+    m_fbo = nullptr;
+    if(m_context)
+      m_context->doneCurrent();
+    delete m_surface;
+    m_surface = nullptr;
+    delete m_context;
+    m_context = nullptr;
 }
 
 QRectF RadarDisplay::boundingRect() const
@@ -161,13 +271,13 @@ QRectF RadarDisplay::boundingRect() const
 
 void RadarDisplay::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget)
 {
-    if(m_show_radar && !m_sectors.empty())
+    double r;
+    {
+      QMutexLocker lock(&m_range_mutex);
+      r = m_range;
+    }
+    if(m_show_radar && r > 0.0)
     {
-        double r;
-        {
-          QMutexLocker lock(&m_range_mutex);
-          r = m_range;
-        }
         r /= m_pixel_size;
         QPen p;
         p.setColor(Qt::green);
@@ -194,18 +304,28 @@ void RadarDisplay::sectorAdded()
 void RadarDisplay::radarCallback(const marine_sensor_msgs::RadarSector::ConstPtr &message)
 {
   ROS_DEBUG_STREAM("now: " << ros::Time::now() << " Radar timestamp: " << message->header.stamp);
-  if (m_show_radar && !message->intensities.empty())
+  m_recorder.write(*message);
+  addSector(*message);
+}
+
+void RadarDisplay::addSector(const marine_sensor_msgs::RadarSector &message, bool north_up)
+{
+  if (m_show_radar && !message.intensities.empty())
   {
-    double angle1 = message->angle_start;
-    double angle2 = angle1 + message->angle_increment*(message->intensities.size()-1);
-    double range = message->range_max;
-    int w = message->intensities.front().echoes.size();
-    int h = message->intensities.size();
-    QImage * sector = new QImage(w,h,QImage::Format_Grayscale8);
-    sector->fill(Qt::darkGray);
+    double angle1 = message.angle_start;
+    double angle2 = angle1 + message.angle_increment*(message.intensities.size()-1);
+    double range = message.range_max;
+    int w = message.intensities.front().echoes.size();
+    int h = message.intensities.size();
+    QImage * sector = acquireSectorImage(w,h);
     for(int i = 0; i < h; i++)
-      for(int j = 0; j < w; j++)
-        sector->bits()[(h-1-i)*w+j] = message->intensities[i].echoes[j]*255; // convert from float to 8 bits
+    {
+      const auto& echoes = message.intensities[i].echoes;
+      uchar* line = sector->scanLine(h-1-i);
+      convertEchoes(echoes.data(), line, std::min<std::size_t>(w, echoes.size()));
+      if(echoes.size() < std::size_t(w))
+        memset(line+echoes.size(), 0, w-echoes.size());
+    }
 
     Sector s;
     if(angle1 < angle2)
@@ -216,8 +336,11 @@ void RadarDisplay::radarCallback(const marine_sensor_msgs::RadarSector::ConstPtr
     s.half_scanline_angle = (s.angle1 - s.angle2)/(2.0*sector->height());
     s.range = range;
     s.sectorImage = sector;
-    s.timestamp = message->header.stamp;
-    s.frame_id = message->header.frame_id.c_str();
+    s.timestamp = message.header.stamp;
+    s.frame_id = message.header.frame_id.c_str();
+    s.received = m_latency_clock.nsecsElapsed();
+    if(north_up)
+      applyYaw(s, 0.0);
     //ROS_INFO_STREAM("angles: " << s.angle1 << " - " << s.angle2 << " range: " << range << " half angle: " << s.half_scanline_angle);
     QMutexLocker lock(&m_new_sectors_mutex);
     m_new_sectors.push_back(s);
@@ -226,144 +349,337 @@ void RadarDisplay::radarCallback(const marine_sensor_msgs::RadarSector::ConstPtr
 }
 
 
+bool RadarDisplay::waitForPendingSectors(std::size_t max_pending, unsigned long timeout_ms)
+{
+  QMutexLocker lock(&m_new_sectors_mutex);
+  if(m_new_sectors.size() < max_pending)
+    return true;
+  m_new_sectors_taken.wait(&m_new_sectors_mutex, timeout_ms);
+  return m_new_sectors.size() < max_pending;
+}
+
+void RadarDisplay::resolveYaw(Sector &s)
+{
+  // std::cerr << "tf buffer? " << m_tf_buffer << std::endl;
+  // std::cerr << "map frame: " << m_mapFrame << " timestamp: " << s.timestamp << " frame_id: " << s.frame_id.toStdString();
+  // if(m_tf_buffer && !m_mapFrame.empty())
+  //    std::cerr << " can transform? " << m_tf_buffer->canTransform(m_mapFrame, s.frame_id.toStdString(), s.timestamp, ros::Duration(1.0)) << std::endl;
+  // std::cerr << std::endl;
+  if(m_mapFrame.empty())
+  {
+    if(m_tf_buffer)
+    {
+      std::map<std::string, std::string> parents;
+      auto frames = YAML::Load(m_tf_buffer->allFramesAsYAML());
+      for(auto f: frames)
+        parents[f.first.as<std::string>()] = f.second["parent"].as<std::string>();
+      for(auto p:parents)
+        ROS_INFO_STREAM(p.first << " child of " << p.second);
+      auto cursor = parents.find(s.frame_id.toStdString());
+      while(cursor != parents.end())
+      {
+        QString parent = cursor->second.c_str();
+        if(parent.endsWith("/map"))
+        {
+          m_mapFrame = cursor->second;
+          break;
+        }
+        cursor = parents.find(cursor->second);
+      }
+    }
+  }
+  ros::Time now = ros::Time::now();
+  if(m_tf_buffer && !m_mapFrame.empty())
+      try
+      {
+          geometry_msgs::TransformStamped t = m_tf_buffer->lookupTransform(m_mapFrame, s.frame_id.toStdString(), s.timestamp, ros::Duration(1.0));
+          applyYaw(s, tf2::getYaw(t.transform.rotation));
+          //std::cerr << "radar sector yaw: " << s.yaw << " map frame: " << m_mapFrame << std::endl;
+
+      }
+      catch (tf2::TransformException &ex)
+      {
+        ROS_WARN_STREAM_THROTTLE(2.0,"Unable to find transform to generate display: " << ex.what() << " lookup call time: " << now << " now: " << ros::Time::now());
+      }
+}
+
 void RadarDisplay::updateRadarImage()
 {
+  if(qgetenv("CAMP_RADAR_RENDERER") != "software")
+    m_opengl_initialized = initializeGL();
+  if(!m_opengl_initialized)
+  {
+    ROS_INFO_STREAM("Using software radar renderer");
+    m_software_renderer.reset(new SoftwareRadarRenderer());
+  }
+
   while(true)
   {
     if ( QThread::currentThread()->isInterruptionRequested() )
       return;
 
-    if(!m_opengl_initialized)
-      initializeGL();
-
-    m_context->makeCurrent(m_surface);
-    m_fbo->bind();
-    glClear(GL_COLOR_BUFFER_BIT);
-
-    QMatrix4x4 matrix;
-    matrix.ortho(-1, 1, -1, 1, 4.0f, 15.0f);
-    matrix.translate(0.0f, 0.0f, -10.0f);
-    
-    glViewport(0,0,2048,2048);
-    
-    m_program->setUniformValue("matrix", matrix);
-    m_program->enableAttributeArray(PROGRAM_VERTEX_ATTRIBUTE);
-    m_program->setAttributeBuffer(PROGRAM_VERTEX_ATTRIBUTE, GL_FLOAT, 0, 3, 3 * sizeof(GLfloat));
+    QElapsedTimer frame_timer;
+    frame_timer.start();
 
     ros::Time now = ros::Time::now();
     float persistance = 3.0;
+
+    // The persistence buffer fades by the same factor every frame so
+    // intensity drops to 2% after persistance seconds.
+    double frame_interval = m_last_frame_time.isZero() ? 0.0 : (now-m_last_frame_time).toSec();
+    m_last_frame_time = now;
+    float decay = std::pow(0.02, std::max(0.0, frame_interval)/persistance);
+
+    if(m_software_renderer)
+      m_software_renderer->decay(decay);
+    else
     {
-      QMutexLocker lock(&m_new_sectors_mutex);
-      while(!m_new_sectors.empty())
+      m_context->makeCurrent(m_surface);
+      m_fbo->bind();
+
+      QMatrix4x4 matrix;
+      matrix.ortho(-1, 1, -1, 1, 4.0f, 15.0f);
+      matrix.translate(0.0f, 0.0f, -10.0f);
+      
+      glViewport(0,0,2048,2048);
+
+      m_decay_program->bind();
+      m_decay_program->setUniformValue("matrix", matrix);
+      m_decay_program->setUniformValue("decay", GLfloat(decay));
+      m_decay_program->enableAttributeArray(PROGRAM_VERTEX_ATTRIBUTE);
+      m_decay_program->setAttributeBuffer(PROGRAM_VERTEX_ATTRIBUTE, GL_FLOAT, 0, 3, 3 * sizeof(GLfloat));
+      glEnable(GL_BLEND);
+      glBlendFunc(GL_ZERO, GL_SRC_COLOR);
+      glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
+      // The buffer is 8 bit and the multiply rounds to nearest, so
+      // the faintest returns would never reach 0. Taking off at least
+      // one step each frame clears them.
+      if(decay < 1.0f)
       {
-        m_sectors.push_back(m_new_sectors.front());
-        m_new_sectors.pop_front();
+        m_decay_program->setUniformValue("decay", GLfloat(1.0/255.0));
+        glBlendEquation(GL_FUNC_REVERSE_SUBTRACT);
+        glBlendFunc(GL_ONE, GL_ONE);
+        glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
+        glBlendEquation(GL_FUNC_ADD);
       }
+      glDisable(GL_BLEND);
+
+      m_program->bind();
+      m_program->setUniformValue("matrix", matrix);
+      m_program->enableAttributeArray(PROGRAM_VERTEX_ATTRIBUTE);
+      m_program->setAttributeBuffer(PROGRAM_VERTEX_ATTRIBUTE, GL_FLOAT, 0, 3, 3 * sizeof(GLfloat));
     }
-    while(!m_sectors.empty() && m_sectors.front().timestamp + ros::Duration(persistance) < now)
+
+    QColor color;
     {
-      if(m_sectors.front().sectorImage)
-        delete m_sectors.front().sectorImage;
-      if(m_sectors.front().sectorTexture)
-        delete m_sectors.front().sectorTexture;
-      m_sectors.pop_front();
+      QMutexLocker lock(&m_color_mutex);
+      color = m_color;
     }
+
     {
-      QMutexLocker range_lock(&m_range_mutex);
-      if(m_sectors.empty())
-        m_range = 0.0;
-      else
-        m_range = m_sectors.back().range;
+      QMutexLocker lock(&m_new_sectors_mutex);
+      while(!m_new_sectors.empty())
+      {
+        m_sectors.push_back(m_new_sectors.front());
+        m_new_sectors.pop_front();
+      }
+      m_new_sectors_taken.wakeAll();
     }
+
+    // Only sectors that arrived since the last frame are drawn, each
+    // overwriting its bearings in the buffer. Sectors still waiting
+    // for a heading stay queued until they are too old to show.
+    std::deque<Sector> waiting_for_yaw;
     for(Sector &s: m_sectors)
     {
-      if(s.sectorImage && !s.rendered)
+      if(!s.have_yaw && s.timestamp + ros::Duration(persistance) >= now)
+        resolveYaw(s);
+      if(s.have_yaw && s.sectorImage)
       {
-        float fade = 1.0-((now-s.timestamp).toSec()/persistance);
-        if(!s.sectorTexture)
+        float fade = std::pow(0.02, std::max(0.0, (now-s.timestamp).toSec())/persistance);
+        double min_angle = s.angle2-s.half_scanline_angle*1.1;
+        double max_angle = s.angle1+s.half_scanline_angle*1.1;
+        if(max_angle < min_angle)
+          max_angle += 2.0*M_PI;
+        if(m_software_renderer)
+          m_software_renderer->drawSector(s.sectorImage->constBits(), s.sectorImage->width(), s.sectorImage->height(), s.sectorImage->bytesPerLine(), min_angle, max_angle, fade, color);
+        else
         {
-          s.sectorTexture = new QOpenGLTexture(*s.sectorImage);
-        }
-        if(!s.have_yaw)
-        {
-          // std::cerr << "tf buffer? " << m_tf_buffer << std::endl;
-          // std::cerr << "map frame: " << m_mapFrame << " timestamp: " << s.timestamp << " frame_id: " << s.frame_id.toStdString();
-          // if(m_tf_buffer && !m_mapFrame.empty())
-          //    std::cerr << " can transform? " << m_tf_buffer->canTransform(m_mapFrame, s.frame_id.toStdString(), s.timestamp, ros::Duration(1.0)) << std::endl;
-          // std::cerr << std::endl;
-          if(m_mapFrame.empty())
-          {
-            if(m_tf_buffer)
-            {
-              std::map<std::string, std::string> parents;
-              auto frames = YAML::Load(m_tf_buffer->allFramesAsYAML());
-              for(auto f: frames)
-                parents[f.first.as<std::string>()] = f.second["parent"].as<std::string>();
-              for(auto p:parents)
-                ROS_INFO_STREAM(p.first << " child of " << p.second);
-              auto cursor = parents.find(s.frame_id.toStdString());
-              while(cursor != parents.end())
-              {
-                QString parent = cursor->second.c_str();
-                if(parent.endsWith("/map"))
-                {
-                  m_mapFrame = cursor->second;
-                  break;
-                }
-                cursor = parents.find(cursor->second);
-              }
-            }
-          }
-          ros::Time now = ros::Time::now();
-          if(m_tf_buffer && !m_mapFrame.empty())
-              try
-              {
-                  geometry_msgs::TransformStamped t = m_tf_buffer->lookupTransform(m_mapFrame, s.frame_id.toStdString(), s.timestamp, ros::Duration(1.0));
-                  double yaw = tf2::getYaw(t.transform.rotation);
-                  while (yaw < 0.0)
-                      yaw += (2.0*M_PI);
-                  s.yaw = yaw;
-                  s.angle1 = std::fmod(s.angle1+yaw,M_PI*2);
-                  if(s.angle1 < 0)
-                    s.angle1 += M_PI*2;
-                  s.angle2 = std::fmod(s.angle2+yaw,M_PI*2);
-                  if(s.angle2 < 0)
-                    s.angle2 += M_PI*2;
-
-                  s.have_yaw = true;
-                  //std::cerr << "radar sector yaw: " << s.yaw << " map frame: " << m_mapFrame << std::endl;
-
-              }
-              catch (tf2::TransformException &ex)
-              {
-                ROS_WARN_STREAM_THROTTLE(2.0,"Unable to find transform to generate display: " << ex.what() << " lookup call time: " << now << " now: " << ros::Time::now());
-              }
-        }
-        if(s.have_yaw)
-        {
-          m_program->setUniformValue("minAngle", GLfloat(s.angle2-s.half_scanline_angle*1.1));
-          m_program->setUniformValue("maxAngle", GLfloat(s.angle1+s.half_scanline_angle*1.1));
+          s.sectorTexture = acquireSectorTexture(*s.sectorImage);
+          m_program->setUniformValue("minAngle", GLfloat(min_angle));
+          m_program->setUniformValue("maxAngle", GLfloat(max_angle));
           m_program->setUniformValue("fade", GLfloat(fade));
-          m_program->setUniformValue("color", m_color);
+          m_program->setUniformValue("color", color);
           
           s.sectorTexture->bind();
-          glDisable(GL_BLEND);
           glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
-          //s.rendered = true;
         }
+        {
+          QMutexLocker range_lock(&m_range_mutex);
+          m_range = s.range;
+        }
+        double latency = (m_latency_clock.nsecsElapsed()-s.received)/1.0e6;
+        QMutexLocker lock(&m_radar_image_mutex);
+        if(m_latency == 0.0)
+          m_latency = latency;
+        else
+          m_latency = 0.9*m_latency + 0.1*latency;
+      }
+      if(!s.have_yaw && s.timestamp + ros::Duration(persistance) >= now)
+        waiting_for_yaw.push_back(s);
+      else if(s.have_yaw && s.sectorImage)
+      {
+        // The detector hands the image back to the pool when done.
+        releaseSectorTexture(s.sectorTexture);
+        m_detector->addSector(s.sectorImage, s.angle2, s.angle1, s.range, s.timestamp);
+      }
+      else
+      {
+        releaseSectorImage(s.sectorImage);
+        releaseSectorTexture(s.sectorTexture);
       }
     }
+    m_sectors.swap(waiting_for_yaw);
 
     {
       QMutexLocker lock(&m_radar_image_mutex);
-      m_radar_image = m_fbo->toImage();
+      if(m_software_renderer)
+        m_radar_image = m_software_renderer->image();
+      else
+        m_radar_image = m_fbo->toImage();
+
+      // Smoothed so it can be compared between renderers.
+      double elapsed = frame_timer.nsecsElapsed()/1.0e6;
+      if(m_frame_time == 0.0)
+        m_frame_time = elapsed;
+      else
+        m_frame_time = 0.9*m_frame_time + 0.1*elapsed;
     }
+    ROS_DEBUG_STREAM_THROTTLE(10.0, "Radar " << rendererName().toStdString() << " frame time: " << m_frame_time << " ms, " << m_sectors.size() << " sectors");
     update();
     QThread::currentThread()->msleep(100);
   }
 
 } 
 
+void RadarDisplay::applyYaw(Sector &s, double yaw)
+{
+  while (yaw < 0.0)
+      yaw += (2.0*M_PI);
+  s.yaw = yaw;
+  s.angle1 = std::fmod(s.angle1+yaw,M_PI*2);
+  if(s.angle1 < 0)
+    s.angle1 += M_PI*2;
+  s.angle2 = std::fmod(s.angle2+yaw,M_PI*2);
+  if(s.angle2 < 0)
+    s.angle2 += M_PI*2;
+
+  s.have_yaw = true;
+}
+
+QImage* RadarDisplay::acquireSectorImage(int width, int height)
+{
+  {
+    QMutexLocker lock(&m_image_pool_mutex);
+    for(auto i = m_image_pool.begin(); i != m_image_pool.end(); i++)
+      if((*i)->width() == width && (*i)->height() == height)
+      {
+        QImage* image = *i;
+        *i = m_image_pool.back();
+        m_image_pool.pop_back();
+        return image;
+      }
+  }
+  return new QImage(width, height, QImage::Format_Grayscale8);
+}
+
+void RadarDisplay::releaseSectorImage(QImage* image)
+{
+  if(!image)
+    return;
+  QMutexLocker lock(&m_image_pool_mutex);
+  if(m_image_pool.size() < max_pooled_sectors)
+    m_image_pool.push_back(image);
+  else
+    delete image;
+}
+
+QOpenGLTexture* RadarDisplay::acquireSectorTexture(const QImage& image)
+{
+  QOpenGLTexture* texture = nullptr;
+  for(auto i = m_texture_pool.begin(); i != m_texture_pool.end(); i++)
+    if((*i)->width() == image.width() && (*i)->height() == image.height())
+    {
+      texture = *i;
+      *i = m_texture_pool.back();
+      m_texture_pool.pop_back();
+      break;
+    }
+  if(!texture)
+  {
+    texture = new QOpenGLTexture(QOpenGLTexture::Target2D);
+    texture->setFormat(QOpenGLTexture::R8_UNorm);
+    texture->setSize(image.width(), image.height());
+    texture->setMipLevels(1);
+    texture->setMinificationFilter(QOpenGLTexture::Linear);
+    texture->setMagnificationFilter(QOpenGLTexture::Linear);
+    texture->setWrapMode(QOpenGLTexture::ClampToEdge);
+    texture->allocateStorage(QOpenGLTexture::Red, QOpenGLTexture::UInt8);
+  }
+  // Grayscale8 scanlines are padded to 4 bytes, the default unpack alignment.
+  texture->setData(QOpenGLTexture::Red, QOpenGLTexture::UInt8, image.constBits());
+  return texture;
+}
+
+void RadarDisplay::releaseSectorTexture(QOpenGLTexture* texture)
+{
+  if(!texture)
+    return;
+  if(m_texture_pool.size() < max_pooled_sectors)
+    m_texture_pool.push_back(texture);
+  else
+    delete texture;
+}
+
+QString RadarDisplay::rendererName() const
+{
+    if(m_software_renderer)
+        return "software";
+    return "OpenGL";
+}
+
+double RadarDisplay::latency() const
+{
+  QMutexLocker lock(&m_radar_image_mutex);
+  return m_latency;
+}
+
+bool RadarDisplay::startRecording(QString path)
+{
+  return m_recorder.open(path);
+}
+
+void RadarDisplay::stopRecording()
+{
+  m_recorder.close();
+}
+
+RadarTargetDetector& RadarDisplay::detector()
+{
+  return *m_detector;
+}
+
+RadarRecorder& RadarDisplay::recorder()
+{
+  return m_recorder;
+}
+
+double RadarDisplay::frameTime() const
+{
+    QMutexLocker lock(&m_radar_image_mutex);
+    return m_frame_time;
+}
+
 void RadarDisplay::showRadar(bool show)
 {
     m_show_radar = show;
@@ -8,18 +8,27 @@
 #include <QOpenGLBuffer>
 #include <QOpenGLDebugLogger>
 #include <QMutex>
+#include <QWaitCondition>
+#include <QElapsedTimer>
 #include <deque>
+#include <vector>
+#include <memory>
 #include <ros/ros.h>
 #include <ros/callback_queue.h>
 #include "marine_sensor_msgs/RadarSector.h"
+#include "radar_recording.h"
 
 Q_DECLARE_METATYPE(QImage*)
 Q_DECLARE_METATYPE(ros::Time)
 
+class QTimer;
 class QOffscreenSurface;
 class QOpenGLContext;
 class QOpenGLFramebufferObject;
 class QOpenGLShaderProgram;
+class SoftwareRadarRenderer;
+class RadarTargetDetector;
+class RadarTargetsItem;
 
 namespace tf2_ros
 {
@@ -32,6 +41,7 @@ class RadarDisplay : public QObject, public GeoGraphicsItem,  protected QOpenGLF
     Q_INTERFACES(QGraphicsItem)
 public:
     RadarDisplay(QObject* parent = nullptr, QGraphicsItem *parentItem = nullptr);
+    ~RadarDisplay();
 
     QRectF boundingRect() const;
     void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget);
@@ -40,6 +50,36 @@ public:
     void setMapFrame(std::string mapFrame);
     const QColor& getColor() const;
     void setPixelSize(double s);
+
+    // Name of the rendering backend in use, "OpenGL" or "software".
+    QString rendererName() const;
+
+    // Average time in milliseconds taken to render a frame and
+    // make it available for painting.
+    double frameTime() const;
+
+    // Average time in milliseconds between a sector arriving and it
+    // being drawn into the radar image.
+    double latency() const;
+
+    // Queues a sector for display. Used for subscribed topics and by
+    // RadarPlayback. north_up sectors are drawn without looking up
+    // the radar's heading.
+    void addSector(const marine_sensor_msgs::RadarSector &sector, bool north_up = false);
+
+    // Waits up to timeout_ms for fewer than max_pending sectors to be
+    // queued for drawing. Returns false if there are still as many.
+    // Lets RadarPlayback feed sectors only as fast as they are drawn.
+    bool waitForPendingSectors(std::size_t max_pending, unsigned long timeout_ms);
+
+    // Appends sectors received from the subscribed topic to a file
+    // that RadarPlayback can replay.
+    bool startRecording(QString path);
+    void stopRecording();
+    RadarRecorder& recorder();
+
+    // Finds targets in the sectors once they are drawn.
+    RadarTargetDetector& detector();
     
 public slots:
     void showRadar(bool show);
@@ -49,7 +89,10 @@ public slots:
     void updatePosition();
 
 private:
-    void initializeGL();
+    // Returns false if OpenGL rendering is not available.
+    bool initializeGL();
+    // Frees what a failed initializeGL created.
+    void releaseGL();
     void radarCallback(const marine_sensor_msgs::RadarSector::ConstPtr &message);
     void updateRadarImage();
 
@@ -67,28 +110,68 @@ private:
         double rendered = false;
         QImage *sectorImage;
         QOpenGLTexture *sectorTexture;
+        // m_latency_clock time when the sector was queued
+        qint64 received = 0;
     };
     
+    // Finds the sector's heading in the map frame and rotates its angles.
+    void resolveYaw(Sector &s);
+    void applyYaw(Sector &s, double yaw);
+
+    // Sector images are recycled once drawn so steady state reception
+    // does not allocate. Called from the ROS and render threads.
+    QImage* acquireSectorImage(int width, int height);
+    void releaseSectorImage(QImage* image);
+
+    // Textures are only used by the render thread and are reused for
+    // each sector of the same size.
+    QOpenGLTexture* acquireSectorTexture(const QImage& image);
+    void releaseSectorTexture(QOpenGLTexture* texture);
+
     double m_pixel_size = 1.0;
 
+    // Sectors received but not yet drawn into the persistence buffer,
+    // either new since the last frame or still waiting for a heading.
     std::deque<Sector> m_sectors;
 
     std::deque<Sector> m_new_sectors;
     QMutex m_new_sectors_mutex;
+    // Woken when the render thread takes the new sectors.
+    QWaitCondition m_new_sectors_taken;
+
+    std::vector<QImage*> m_image_pool;
+    QMutex m_image_pool_mutex;
+    std::vector<QOpenGLTexture*> m_texture_pool;
 
     double m_range = 0.0;
     QMutex m_range_mutex;
 
     QOpenGLShaderProgram *m_program;
+    QOpenGLShaderProgram *m_decay_program = nullptr;
     QOffscreenSurface* m_surface = nullptr;
     QOpenGLContext* m_context = nullptr;
     QOpenGLFramebufferObject* m_fbo = nullptr;
     QOpenGLBuffer m_vbo;
 
     QImage m_radar_image;
-    QMutex m_radar_image_mutex;
+    mutable QMutex m_radar_image_mutex;
 
     bool m_opengl_initialized = false;
+
+    // Used instead of OpenGL when it can't be initialized or when the
+    // CAMP_RADAR_RENDERER environment variable is set to "software".
+    std::unique_ptr<SoftwareRadarRenderer> m_software_renderer;
+
+    double m_frame_time = 0.0;
+    double m_latency = 0.0;
+    QElapsedTimer m_latency_clock;
+
+    RadarRecorder m_recorder;
+
+    std::unique_ptr<RadarTargetDetector> m_detector;
+    RadarTargetsItem* m_targets_item = nullptr;
+    QTimer* m_targets_timer = nullptr;
+    ros::Time m_last_frame_time;
     
     bool m_show_radar = true;
 
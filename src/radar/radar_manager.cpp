@@ -1,8 +1,13 @@
 #include "radar_manager.h"
 #include "backgroundraster.h"
 #include "radar_display.h"
+#include "radar_recording.h"
+#include "radar_target_detector.h"
 #include <QTimer>
 #include <QColorDialog>
+#include <QFileDialog>
+#include <QInputDialog>
+#include <QMenu>
 
 RadarManager::RadarManager(QWidget* parent):
   QWidget(parent)
@@ -13,6 +18,8 @@ RadarManager::RadarManager(QWidget* parent):
   connect(scan_timer_, &QTimer::timeout, this, &RadarManager::scanForSources);
   scan_timer_->start(1000);
 
+  ui_.sourcesListWidget->setContextMenuPolicy(Qt::CustomContextMenu);
+  connect(ui_.sourcesListWidget, &QWidget::customContextMenuRequested, this, &RadarManager::showContextMenu);
 }
 
 RadarManager::~RadarManager()
@@ -30,19 +37,92 @@ void RadarManager::scanForSources()
   for(const auto t: topic_info)
     if (t.datatype == "marine_sensor_msgs/RadarSector")
       if (radar_displays_.find(t.name) == radar_displays_.end())
-      {
-        radar_displays_[t.name] = new RadarDisplay(this, background_);
-        radar_displays_[t.name]->setTF2Buffer(tf_buffer_);
-        radar_displays_[t.name]->subscribe(t.name.c_str());
-        radar_displays_[t.name]->showRadar(show_radar_);
-        if(background_)
-          radar_displays_[t.name]->setPixelSize(background_->pixelSize());
-
-        ui_.sourcesListWidget->addItem(t.name.c_str());
-      }
+        addDisplay(t.name)->subscribe(t.name.c_str());
 
   for(auto rd: radar_displays_)
     rd.second->updatePosition();
+
+  // Show which renderer each display uses and how long its frames take.
+  for(int i = 0; i < ui_.sourcesListWidget->count(); i++)
+  {
+    auto item = ui_.sourcesListWidget->item(i);
+    auto topic = item->data(Qt::UserRole).toString();
+    auto rd = radar_displays_.find(topic.toStdString());
+    if(rd != radar_displays_.end())
+    {
+      QString details = rd->second->rendererName()+", "+QString::number(rd->second->frameTime(), 'f', 1)+" ms/frame, "+QString::number(rd->second->latency(), 'f', 1)+" ms latency, "+QString::number(rd->second->detector().processingTime(), 'f', 2)+" ms/sector detection";
+      if(rd->second->recorder().isOpen())
+        details += ", recorded "+QString::number(rd->second->recorder().recordCount())+" sectors";
+      auto playback = playbacks_.find(rd->first);
+      if(playback != playbacks_.end() && playback->second->isPlaying())
+        details += ", playing "+QString::number(playback->second->achievedRate(), 'f', 1)+" sectors/s";
+      item->setText(topic+" ("+details+")");
+    }
+  }
+}
+
+RadarDisplay* RadarManager::addDisplay(std::string name)
+{
+  auto display = new RadarDisplay(this, background_);
+  radar_displays_[name] = display;
+  display->setTF2Buffer(tf_buffer_);
+  display->showRadar(show_radar_);
+  if(background_)
+    display->setPixelSize(background_->pixelSize());
+
+  auto item = new QListWidgetItem(name.c_str(), ui_.sourcesListWidget);
+  item->setData(Qt::UserRole, QString(name.c_str()));
+  return display;
+}
+
+void RadarManager::showContextMenu(const QPoint& pos)
+{
+  QMenu menu;
+
+  auto item = ui_.sourcesListWidget->itemAt(pos);
+  if(item)
+  {
+    std::string name = item->data(Qt::UserRole).toString().toStdString();
+    auto rd = radar_displays_.find(name);
+    if(rd != radar_displays_.end() && playbacks_.find(name) == playbacks_.end())
+    {
+      RadarDisplay* display = rd->second;
+      if(display->recorder().isOpen())
+        connect(menu.addAction("Stop recording"), &QAction::triggered, [display](){display->stopRecording();});
+      else
+        connect(menu.addAction("Record..."), &QAction::triggered, [this, display]()
+        {
+          QString path = QFileDialog::getSaveFileName(this, "Record radar", "", "Radar recordings (*.radar)");
+          if(!path.isEmpty())
+            display->startRecording(path);
+        });
+    }
+  }
+
+  connect(menu.addAction("Play recording..."), &QAction::triggered, this, &RadarManager::playRecording);
+
+  menu.exec(ui_.sourcesListWidget->mapToGlobal(pos));
+}
+
+void RadarManager::playRecording()
+{
+  QString path = QFileDialog::getOpenFileName(this, "Play radar recording", "", "Radar recordings (*.radar)");
+  if(path.isEmpty())
+    return;
+  bool ok;
+  double speed = QInputDialog::getDouble(this, "Play radar recording", "Speed (0 for as fast as possible)", 1.0, 0.0, 100.0, 1, &ok);
+  if(!ok)
+    return;
+
+  std::string name = path.toStdString();
+  auto playback = playbacks_.find(name);
+  if(playback == playbacks_.end())
+  {
+    auto display = addDisplay(name);
+    playback = playbacks_.insert(std::make_pair(name, std::make_shared<RadarPlayback>(display))).first;
+  }
+  if(playback->second->open(path))
+    playback->second->start(speed);
 }
 
 void RadarManager::showRadar(bool show)
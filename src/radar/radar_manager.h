@@ -4,9 +4,11 @@
 #include <QWidget>
 #include "ui_radar_manager.h"
 #include <tf2_ros/transform_listener.h>
+#include <memory>
 
 class BackgroundRaster;
 class RadarDisplay;
+class RadarPlayback;
 
 class RadarManager: public QWidget
 {
@@ -24,6 +26,10 @@ public slots:
 
 private slots:
   void scanForSources();
+  void showContextMenu(const QPoint& pos);
+
+  // Replays a recorded radar file as an additional source.
+  void playRecording();
 
 
 private:
@@ -32,7 +38,10 @@ private:
   QTimer* scan_timer_;
   BackgroundRaster* background_ = nullptr;
 
+  RadarDisplay* addDisplay(std::string name);
+
   std::map<std::string, RadarDisplay*> radar_displays_;
+  std::map<std::string, std::shared_ptr<RadarPlayback> > playbacks_;
 
   tf2_ros::Buffer* tf_buffer_ = nullptr;
 
@@ -0,0 +1,399 @@
+#include "radar_recording.h"
+#include "radar_display.h"
+#include "radar_target_detector.h"
+#include <QElapsedTimer>
+#include <QThread>
+#include <algorithm>
+#include <cstring>
+
+using namespace radar_recording;
+
+namespace
+{
+
+// Sectors allowed to wait for the display's render thread, which
+// takes them every frame. Half the display's image pool, so playback
+// doesn't allocate images beyond it.
+const std::size_t max_pending_sectors = 32;
+
+// How often RadarRecorder flushes, a crash loses at most this much.
+const qint64 checkpoint_interval_ms = 1000;
+
+// Records start on 8 byte boundaries so mapped headers are aligned.
+uint32_t paddedSize(std::size_t size)
+{
+  return (size + 7) & ~std::size_t(7);
+}
+
+bool validFileHeader(const uchar* data, qint64 size)
+{
+  if(!data || size < qint64(sizeof(FileHeader)))
+    return false;
+  FileHeader header;
+  memcpy(&header, data, sizeof(header));
+  return memcmp(header.magic, magic, sizeof(magic)) == 0 && header.version == version;
+}
+
+// Returns true if a complete record starts at offset.
+bool validRecord(const uchar* data, qint64 size, qint64 offset)
+{
+  if(offset < qint64(sizeof(FileHeader)) || offset + qint64(sizeof(RecordHeader)) > size)
+    return false;
+  RecordHeader header;
+  memcpy(&header, data+offset, sizeof(header));
+  uint64_t content = sizeof(RecordHeader) + uint64_t(header.frame_id_length) + uint64_t(header.echo_count)*header.scanline_count;
+  return header.record_size >= content && offset + qint64(header.record_size) <= size;
+}
+
+} // namespace
+
+RadarRecorder::~RadarRecorder()
+{
+  close();
+}
+
+bool RadarRecorder::open(QString path)
+{
+  QMutexLocker lock(&m_mutex);
+  checkpoint();
+  m_data.close();
+  m_index.close();
+  m_record_count = 0;
+  m_pending_index.clear();
+
+  m_data.setFileName(path);
+  if(!m_data.open(QIODevice::ReadWrite))
+  {
+    ROS_WARN_STREAM("Unable to open radar recording " << path.toStdString() << ": " << m_data.errorString().toStdString());
+    return false;
+  }
+
+  qint64 end = sizeof(FileHeader);
+  if(m_data.size() == 0)
+  {
+    FileHeader header;
+    memcpy(header.magic, magic, sizeof(magic));
+    header.version = version;
+    m_data.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  }
+  else
+  {
+    // Drop a partial record left by an interrupted recording so
+    // new records follow the last complete one.
+    const uchar* map = m_data.map(0, m_data.size());
+    if(!validFileHeader(map, m_data.size()))
+    {
+      ROS_WARN_STREAM(path.toStdString() << " is not a radar recording");
+      m_data.close();
+      return false;
+    }
+    while(validRecord(map, m_data.size(), end))
+    {
+      RecordHeader record;
+      memcpy(&record, map+end, sizeof(record));
+      end += record.record_size;
+      m_record_count++;
+    }
+    m_data.unmap(const_cast<uchar*>(map));
+    m_data.resize(end);
+  }
+  m_data.seek(end);
+
+  m_index.setFileName(path+".index");
+  if(!m_index.open(QIODevice::ReadWrite))
+  {
+    ROS_WARN_STREAM("Unable to open radar recording index " << m_index.fileName().toStdString());
+    m_data.close();
+    return false;
+  }
+  // Playback rebuilds whatever the index is missing.
+  m_index.resize(std::min<qint64>(m_index.size(), qint64(m_record_count)*sizeof(IndexEntry)));
+  m_index.seek(m_index.size());
+  m_last_checkpoint.start();
+  return true;
+}
+
+void RadarRecorder::close()
+{
+  QMutexLocker lock(&m_mutex);
+  checkpoint();
+  m_data.close();
+  m_index.close();
+}
+
+bool RadarRecorder::isOpen() const
+{
+  QMutexLocker lock(&m_mutex);
+  return m_data.isOpen();
+}
+
+QString RadarRecorder::path() const
+{
+  QMutexLocker lock(&m_mutex);
+  return m_data.fileName();
+}
+
+int RadarRecorder::recordCount() const
+{
+  QMutexLocker lock(&m_mutex);
+  return m_record_count;
+}
+
+void RadarRecorder::write(const marine_sensor_msgs::RadarSector& sector)
+{
+  QMutexLocker lock(&m_mutex);
+  if(!m_data.isOpen())
+    return;
+
+  RecordHeader header = {};
+  header.stamp_ns = sector.header.stamp.toNSec();
+  header.angle_start = sector.angle_start;
+  header.angle_increment = sector.angle_increment;
+  header.range_max = sector.range_max;
+  header.scanline_count = sector.intensities.size();
+  header.echo_count = sector.intensities.empty() ? 0 : sector.intensities.front().echoes.size();
+  header.frame_id_length = sector.header.frame_id.size();
+  header.record_size = paddedSize(sizeof(header) + header.frame_id_length + std::size_t(header.echo_count)*header.scanline_count);
+
+  // The buffer keeps its capacity between records.
+  m_buffer.assign(header.record_size, 0);
+  memcpy(m_buffer.data(), &header, sizeof(header));
+  memcpy(m_buffer.data()+sizeof(header), sector.header.frame_id.data(), header.frame_id_length);
+  uint8_t* echoes = m_buffer.data() + sizeof(header) + header.frame_id_length;
+  for(const auto& scanline: sector.intensities)
+  {
+    std::size_t count = std::min<std::size_t>(header.echo_count, scanline.echoes.size());
+    for(std::size_t i = 0; i < count; i++)
+      echoes[i] = std::max(0.0f, std::min(255.0f, scanline.echoes[i]*255.0f));
+    echoes += header.echo_count;
+  }
+
+  IndexEntry entry;
+  entry.stamp_ns = header.stamp_ns;
+  entry.offset = m_data.pos();
+
+  m_data.write(reinterpret_cast<const char*>(m_buffer.data()), m_buffer.size());
+  m_pending_index.push_back(entry);
+  m_record_count++;
+
+  if(m_last_checkpoint.elapsed() >= checkpoint_interval_ms)
+    checkpoint();
+}
+
+void RadarRecorder::checkpoint()
+{
+  if(!m_data.isOpen())
+    return;
+  // The data goes first so the index never points past it.
+  m_data.flush();
+  if(!m_pending_index.empty())
+  {
+    m_index.write(reinterpret_cast<const char*>(m_pending_index.data()), m_pending_index.size()*sizeof(radar_recording::IndexEntry));
+    m_index.flush();
+    m_pending_index.clear();
+  }
+  m_last_checkpoint.start();
+}
+
+RadarPlayback::RadarPlayback(RadarDisplay* display): m_display(display)
+{
+}
+
+RadarPlayback::~RadarPlayback()
+{
+  stop();
+}
+
+bool RadarPlayback::open(QString path)
+{
+  stop();
+  m_data.close();
+  m_map = nullptr;
+  m_size = 0;
+  m_entries.clear();
+
+  m_data.setFileName(path);
+  if(!m_data.open(QIODevice::ReadOnly))
+  {
+    ROS_WARN_STREAM("Unable to open radar recording " << path.toStdString() << ": " << m_data.errorString().toStdString());
+    return false;
+  }
+  m_size = m_data.size();
+  m_map = m_data.map(0, m_size);
+  if(!validFileHeader(m_map, m_size))
+  {
+    ROS_WARN_STREAM(path.toStdString() << " is not a radar recording");
+    m_data.close();
+    m_map = nullptr;
+    return false;
+  }
+
+  readIndex(path+".index");
+  rebuildIndex();
+  return !m_entries.empty();
+}
+
+bool RadarPlayback::readIndex(QString path)
+{
+  QFile index(path);
+  if(!index.open(QIODevice::ReadOnly))
+    return false;
+  m_entries.resize(index.size()/sizeof(IndexEntry));
+  index.read(reinterpret_cast<char*>(m_entries.data()), m_entries.size()*sizeof(IndexEntry));
+  // Keep entries up to the first one that doesn't match the data.
+  qint64 expected = sizeof(FileHeader);
+  for(std::size_t i = 0; i < m_entries.size(); i++)
+  {
+    if(m_entries[i].offset != expected || !validRecord(m_map, m_size, expected))
+    {
+      m_entries.resize(i);
+      break;
+    }
+    RecordHeader record;
+    memcpy(&record, m_map+expected, sizeof(record));
+    expected += record.record_size;
+  }
+  return true;
+}
+
+void RadarPlayback::rebuildIndex()
+{
+  qint64 offset = sizeof(FileHeader);
+  if(!m_entries.empty())
+  {
+    RecordHeader record;
+    memcpy(&record, m_map+m_entries.back().offset, sizeof(record));
+    offset = m_entries.back().offset + record.record_size;
+  }
+  while(validRecord(m_map, m_size, offset))
+  {
+    RecordHeader record;
+    memcpy(&record, m_map+offset, sizeof(record));
+    IndexEntry entry;
+    entry.stamp_ns = record.stamp_ns;
+    entry.offset = offset;
+    m_entries.push_back(entry);
+    offset += record.record_size;
+  }
+}
+
+bool RadarPlayback::decode(int index, marine_sensor_msgs::RadarSector& sector) const
+{
+  if(index < 0 || index >= int(m_entries.size()))
+    return false;
+  const uchar* data = m_map + m_entries[index].offset;
+  RecordHeader header;
+  memcpy(&header, data, sizeof(header));
+  data += sizeof(header);
+
+  sector.header.stamp.fromNSec(header.stamp_ns);
+  sector.header.frame_id.assign(reinterpret_cast<const char*>(data), header.frame_id_length);
+  data += header.frame_id_length;
+  sector.angle_start = header.angle_start;
+  sector.angle_increment = header.angle_increment;
+  sector.range_max = header.range_max;
+  // Reuses the previous sector's storage when the sizes match.
+  sector.intensities.resize(header.scanline_count);
+  for(auto& scanline: sector.intensities)
+  {
+    scanline.echoes.resize(header.echo_count);
+    // Centered on each step so converting back to 8 bits is exact.
+    for(uint32_t i = 0; i < header.echo_count; i++)
+      scanline.echoes[i] = (data[i]+0.5f)/255.0f;
+    data += header.echo_count;
+  }
+  return true;
+}
+
+void RadarPlayback::start(double speed, bool loop)
+{
+  stop();
+  if(m_entries.empty() || !m_display)
+    return;
+  // So the summary only covers the played sectors.
+  m_display->detector().resetStatistics();
+  m_thread = QThread::create(std::bind(&RadarPlayback::run, this, speed, loop));
+  m_thread->start();
+}
+
+void RadarPlayback::stop()
+{
+  if(m_thread)
+  {
+    m_thread->requestInterruption();
+    m_thread->wait();
+    delete m_thread;
+    m_thread = nullptr;
+  }
+}
+
+bool RadarPlayback::isPlaying() const
+{
+  return m_thread && m_thread->isRunning();
+}
+
+int RadarPlayback::recordCount() const
+{
+  return m_entries.size();
+}
+
+double RadarPlayback::duration() const
+{
+  if(m_entries.empty())
+    return 0.0;
+  return (m_entries.back().stamp_ns - m_entries.front().stamp_ns)/1.0e9;
+}
+
+int RadarPlayback::playedCount() const
+{
+  return m_played;
+}
+
+double RadarPlayback::achievedRate() const
+{
+  return m_rate;
+}
+
+void RadarPlayback::run(double speed, bool loop)
+{
+  m_played = 0;
+  m_rate = 0.0;
+  marine_sensor_msgs::RadarSector sector;
+  QElapsedTimer timer;
+  timer.start();
+
+  do
+  {
+    qint64 pass_start = timer.nsecsElapsed();
+    int64_t first_stamp = m_entries.front().stamp_ns;
+    for(int i = 0; i < int(m_entries.size()); i++)
+    {
+      if(QThread::currentThread()->isInterruptionRequested())
+        return;
+
+      // A speed of 0 or less isn't paced by the recording's stamps.
+      if(speed > 0.0)
+      {
+        qint64 due = pass_start + (m_entries[i].stamp_ns - first_stamp)/speed;
+        qint64 wait = due - timer.nsecsElapsed();
+        if(wait > 0)
+          QThread::usleep(wait/1000);
+      }
+
+      // At any speed, playback waits for the display to draw what it
+      // was given before queuing more, so it's never further ahead
+      // than max_pending_sectors.
+      while(!m_display->waitForPendingSectors(max_pending_sectors, 100))
+        if(QThread::currentThread()->isInterruptionRequested())
+          return;
+
+      decode(i, sector);
+      sector.header.stamp = ros::Time::now();
+      m_display->addSector(sector, true);
+      m_played++;
+      m_rate = m_played/(timer.nsecsElapsed()/1.0e9);
+    }
+  } while(loop);
+
+  ROS_INFO_STREAM("Radar playback: " << m_played << " sectors in " << timer.elapsed()/1000.0 << " s, " << m_rate << " sectors/s, display frame time " << m_display->frameTime() << " ms, latency " << m_display->latency() << " ms, detection " << m_display->detector().processingTime() << " ms/sector over " << m_display->detector().sectorCount() << " sectors, max detection queue " << m_display->detector().maxQueueDepth());
+}
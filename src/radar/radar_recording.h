@@ -0,0 +1,137 @@
+#ifndef CAMP_RADAR_RECORDING_H
+#define CAMP_RADAR_RECORDING_H
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMutex>
+#include <QString>
+#include <atomic>
+#include <vector>
+#include "marine_sensor_msgs/RadarSector.h"
+
+class QThread;
+class RadarDisplay;
+
+// Binary layout shared by RadarRecorder and RadarPlayback.
+//
+// The data file starts with a FileHeader followed by records, each a
+// RecordHeader, the frame id and scanline_count rows of echo_count
+// 8 bit intensities. Records are only ever appended so a recording
+// cut short is still readable up to its last complete record.
+//
+// A sidecar file with the same name plus ".index" holds an IndexEntry
+// per record so playback can map the data file and seek without
+// parsing it. If the index is missing or short, it is rebuilt by
+// walking the records.
+namespace radar_recording
+{
+
+const char magic[4] = {'C','R','A','D'};
+const uint32_t version = 1;
+
+struct FileHeader
+{
+  char magic[4];
+  uint32_t version;
+};
+
+struct RecordHeader
+{
+  int64_t stamp_ns;
+  float angle_start;
+  float angle_increment;
+  float range_max;
+  uint32_t echo_count;
+  uint32_t scanline_count;
+  uint32_t frame_id_length;
+  // Size of the whole record, including this header.
+  uint32_t record_size;
+  uint32_t reserved;
+};
+
+struct IndexEntry
+{
+  int64_t stamp_ns;
+  int64_t offset;
+};
+
+} // namespace radar_recording
+
+// Appends incoming radar sectors to a recording.
+// Thread safe so it can be fed from the ROS callback thread.
+class RadarRecorder
+{
+public:
+  ~RadarRecorder();
+
+  // Opens or creates the recording, appending to an existing one.
+  bool open(QString path);
+  void close();
+  bool isOpen() const;
+
+  void write(const marine_sensor_msgs::RadarSector& sector);
+
+  QString path() const;
+  int recordCount() const;
+
+private:
+  // Flushes the data file, then appends the index entries of the
+  // records flushed. Called with m_mutex held.
+  void checkpoint();
+
+  mutable QMutex m_mutex;
+  QFile m_data;
+  QFile m_index;
+  std::vector<uint8_t> m_buffer;
+  int m_record_count = 0;
+
+  // Records are only flushed every so often so recording doesn't slow
+  // down the callback thread it's measuring.
+  std::vector<radar_recording::IndexEntry> m_pending_index;
+  QElapsedTimer m_last_checkpoint;
+};
+
+// Feeds a recording to a RadarDisplay in real time or faster, without
+// needing a ROS master or tf. Sectors are restamped with the current
+// time as they are played so persistence behaves as it does live.
+class RadarPlayback
+{
+public:
+  RadarPlayback(RadarDisplay* display);
+  ~RadarPlayback();
+
+  bool open(QString path);
+
+  // speed is a multiple of real time, 0 or less plays as fast as the
+  // display draws. Playback runs on its own thread and stops at the
+  // end of the recording unless loop is true.
+  void start(double speed = 1.0, bool loop = false);
+  void stop();
+  bool isPlaying() const;
+
+  int recordCount() const;
+  double duration() const;
+
+  // Sectors fed and the rate achieved since start, for benchmarking.
+  int playedCount() const;
+  double achievedRate() const;
+
+private:
+  void run(double speed, bool loop);
+  bool readIndex(QString path);
+  void rebuildIndex();
+  bool decode(int index, marine_sensor_msgs::RadarSector& sector) const;
+
+  RadarDisplay* m_display;
+
+  QFile m_data;
+  const uchar* m_map = nullptr;
+  qint64 m_size = 0;
+  std::vector<radar_recording::IndexEntry> m_entries;
+
+  QThread* m_thread = nullptr;
+  std::atomic<int> m_played {0};
+  std::atomic<double> m_rate {0.0};
+};
+
+#endif
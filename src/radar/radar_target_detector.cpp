@@ -0,0 +1,351 @@
+#include "radar_target_detector.h"
+#include <QElapsedTimer>
+#include <QThread>
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+
+// Spokes further apart than this don't connect, so a gap in the
+// data ends every open target.
+const double max_spoke_gap = 5.0*M_PI/180.0;
+
+} // namespace
+
+RadarTargetDetector::RadarTargetDetector(std::function<void(QImage*)> release): m_release(release)
+{
+  m_thread = QThread::create(std::bind(&RadarTargetDetector::run, this));
+  m_thread->start();
+}
+
+RadarTargetDetector::~RadarTargetDetector()
+{
+  m_thread->requestInterruption();
+  {
+    QMutexLocker lock(&m_queue_mutex);
+    m_queue_condition.wakeAll();
+  }
+  m_thread->wait();
+  delete m_thread;
+  for(auto& s: m_queue)
+    m_release(s.image);
+}
+
+void RadarTargetDetector::setTargetsCallback(std::function<void(const std::vector<RadarTarget>&)> callback)
+{
+  QMutexLocker lock(&m_queue_mutex);
+  m_targets_callback = callback;
+}
+
+void RadarTargetDetector::setThreshold(int threshold)
+{
+  QMutexLocker lock(&m_queue_mutex);
+  m_threshold = threshold;
+}
+
+void RadarTargetDetector::setMinimumPixels(int count)
+{
+  QMutexLocker lock(&m_queue_mutex);
+  m_minimum_pixels = count;
+}
+
+void RadarTargetDetector::addSector(QImage* image, double min_angle, double max_angle, double range, ros::Time timestamp)
+{
+  Sector s;
+  s.image = image;
+  s.min_angle = min_angle;
+  s.max_angle = max_angle;
+  s.range = range;
+  s.timestamp = timestamp;
+  QMutexLocker lock(&m_queue_mutex);
+  m_queue.push_back(s);
+  m_max_queue_depth = std::max(m_max_queue_depth, m_queue.size());
+  m_queue_condition.wakeOne();
+}
+
+double RadarTargetDetector::processingTime() const
+{
+  QMutexLocker lock(&m_stats_mutex);
+  return m_processing_time;
+}
+
+std::size_t RadarTargetDetector::sectorCount() const
+{
+  QMutexLocker lock(&m_stats_mutex);
+  return m_sector_count;
+}
+
+std::size_t RadarTargetDetector::maxQueueDepth() const
+{
+  QMutexLocker lock(&m_queue_mutex);
+  return m_max_queue_depth;
+}
+
+void RadarTargetDetector::resetStatistics()
+{
+  {
+    QMutexLocker lock(&m_stats_mutex);
+    m_sector_count = 0;
+  }
+  QMutexLocker lock(&m_queue_mutex);
+  m_max_queue_depth = m_queue.size();
+}
+
+void RadarTargetDetector::run()
+{
+  while(true)
+  {
+    Sector s;
+    {
+      QMutexLocker lock(&m_queue_mutex);
+      while(m_queue.empty() && !QThread::currentThread()->isInterruptionRequested())
+        m_queue_condition.wait(&m_queue_mutex);
+      if(QThread::currentThread()->isInterruptionRequested())
+        return;
+      s = m_queue.front();
+      m_queue.pop_front();
+      m_sector_threshold = m_threshold;
+      m_sector_minimum_pixels = m_minimum_pixels;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    processSector(s);
+    m_release(s.image);
+
+    if(!m_targets.empty())
+    {
+      std::function<void(const std::vector<RadarTarget>&)> callback;
+      {
+        QMutexLocker lock(&m_queue_mutex);
+        callback = m_targets_callback;
+      }
+      if(callback)
+        callback(m_targets);
+      m_targets.clear();
+    }
+
+    double elapsed = timer.nsecsElapsed()/1.0e6;
+    QMutexLocker lock(&m_stats_mutex);
+    m_sector_count++;
+    if(m_processing_time == 0.0)
+      m_processing_time = elapsed;
+    else
+      m_processing_time = 0.9*m_processing_time + 0.1*elapsed;
+  }
+}
+
+void RadarTargetDetector::processSector(const Sector& sector)
+{
+  const QImage& image = *sector.image;
+  int rows = image.height();
+  if(rows == 0 || image.width() == 0)
+    return;
+  if(image.width() != m_spoke_length)
+  {
+    flush();
+    m_spoke_length = image.width();
+  }
+  if(sector.timestamp < m_last_timestamp || (sector.timestamp-m_last_timestamp).toSec() > 1.0)
+    flush();
+  m_last_timestamp = sector.timestamp;
+
+  double span = sector.max_angle - sector.min_angle;
+  if(span < 0.0)
+    span += 2.0*M_PI;
+
+  // Rows are stored last spoke first, so walk them backwards to
+  // follow the antenna.
+  for(int row = rows-1; row >= 0; row--)
+  {
+    double bearing = sector.min_angle;
+    if(rows > 1)
+      bearing += span*row/(rows-1);
+    processSpoke(image.constScanLine(row), image.width(), bearing, sector.range, sector.timestamp);
+  }
+}
+
+void RadarTargetDetector::processSpoke(const uchar* samples, int count, double bearing, double range, ros::Time timestamp)
+{
+  double delta = std::remainder(bearing - m_last_bearing, 2.0*M_PI);
+  m_last_bearing = bearing;
+  if(std::abs(delta) > max_spoke_gap)
+  {
+    flush();
+    m_unwrapped_bearing = std::fmod(bearing, 2.0*M_PI);
+    if(m_unwrapped_bearing < 0.0)
+      m_unwrapped_bearing += 2.0*M_PI;
+  }
+  else
+    m_unwrapped_bearing += delta;
+  m_spoke++;
+
+  double cos_bearing = cos(bearing);
+  double sin_bearing = sin(bearing);
+  double bin_size = range/count;
+
+  m_current_runs.clear();
+  std::size_t previous = 0;
+  int i = 0;
+  while(i < count)
+  {
+    if(samples[i] < m_sector_threshold)
+    {
+      i++;
+      continue;
+    }
+    Run run;
+    run.start = i;
+    run.component = -1;
+    double sum_intensity = 0.0;
+    double sum_range = 0.0;
+    for(; i < count && samples[i] >= m_sector_threshold; i++)
+    {
+      sum_intensity += samples[i];
+      sum_range += samples[i]*(i+0.5)*bin_size;
+    }
+    run.end = i;
+
+    // Previous runs are sorted by range, so skip those that end before
+    // this one and connect to all that overlap, diagonals included.
+    while(previous < m_previous_runs.size() && m_previous_runs[previous].end < run.start)
+      previous++;
+    for(std::size_t p = previous; p < m_previous_runs.size() && m_previous_runs[p].start <= run.end; p++)
+    {
+      int root = find(m_previous_runs[p].component);
+      if(run.component < 0)
+        run.component = root;
+      else if(root != run.component)
+      {
+        merge(run.component, root);
+        run.component = find(run.component);
+      }
+    }
+    if(run.component < 0)
+    {
+      run.component = newComponent();
+      Component& component = m_components[run.component];
+      component.min_bearing = component.max_bearing = m_unwrapped_bearing;
+      component.min_range = run.start*bin_size;
+      component.max_range = run.end*bin_size;
+    }
+
+    Component& component = m_components[run.component];
+    component.last_spoke = m_spoke;
+    component.count += run.end - run.start;
+    component.sum_intensity += sum_intensity;
+    component.sum_x += sum_range*cos_bearing;
+    component.sum_y += sum_range*sin_bearing;
+    component.min_range = std::min(component.min_range, run.start*bin_size);
+    component.max_range = std::max(component.max_range, run.end*bin_size);
+    component.min_bearing = std::min(component.min_bearing, m_unwrapped_bearing);
+    component.max_bearing = std::max(component.max_bearing, m_unwrapped_bearing);
+    component.timestamp = timestamp;
+    m_current_runs.push_back(run);
+  }
+
+  // Components the previous spoke had that this one didn't extend
+  // are complete.
+  for(const auto& run: m_previous_runs)
+  {
+    int root = find(run.component);
+    if(m_components[root].last_spoke != m_spoke && m_components[root].parent == root && m_components[root].count > 0)
+      finish(root);
+  }
+  m_previous_runs.swap(m_current_runs);
+}
+
+int RadarTargetDetector::newComponent()
+{
+  int index;
+  if(m_free_components.empty())
+  {
+    index = m_components.size();
+    m_components.push_back(Component());
+  }
+  else
+  {
+    index = m_free_components.back();
+    m_free_components.pop_back();
+  }
+  Component& c = m_components[index];
+  c = Component();
+  c.parent = index;
+  c.next = -1;
+  c.tail = index;
+  c.last_spoke = m_spoke;
+  c.count = 0;
+  c.sum_intensity = 0.0;
+  c.sum_x = 0.0;
+  c.sum_y = 0.0;
+  return index;
+}
+
+int RadarTargetDetector::find(int component)
+{
+  while(m_components[component].parent != component)
+  {
+    // path halving
+    m_components[component].parent = m_components[m_components[component].parent].parent;
+    component = m_components[component].parent;
+  }
+  return component;
+}
+
+void RadarTargetDetector::merge(int a, int b)
+{
+  a = find(a);
+  b = find(b);
+  if(a == b)
+    return;
+  Component& root = m_components[a];
+  Component& other = m_components[b];
+  other.parent = a;
+  m_components[root.tail].next = b;
+  root.tail = other.tail;
+  root.last_spoke = std::max(root.last_spoke, other.last_spoke);
+  root.count += other.count;
+  root.sum_intensity += other.sum_intensity;
+  root.sum_x += other.sum_x;
+  root.sum_y += other.sum_y;
+  root.min_range = std::min(root.min_range, other.min_range);
+  root.max_range = std::max(root.max_range, other.max_range);
+  root.min_bearing = std::min(root.min_bearing, other.min_bearing);
+  root.max_bearing = std::max(root.max_bearing, other.max_bearing);
+  root.timestamp = std::max(root.timestamp, other.timestamp);
+  other.count = 0;
+}
+
+void RadarTargetDetector::finish(int root)
+{
+  Component& c = m_components[root];
+  if(c.count >= m_sector_minimum_pixels && c.sum_intensity > 0.0)
+  {
+    RadarTarget target;
+    target.timestamp = c.timestamp;
+    target.x = c.sum_x/c.sum_intensity;
+    target.y = c.sum_y/c.sum_intensity;
+    target.min_range = c.min_range;
+    target.max_range = c.max_range;
+    target.min_bearing = c.min_bearing;
+    target.max_bearing = c.max_bearing;
+    target.pixel_count = c.count;
+    target.mean_intensity = c.sum_intensity/c.count;
+    m_targets.push_back(target);
+  }
+  c.count = 0;
+  for(int member = root; member >= 0; member = m_components[member].next)
+    m_free_components.push_back(member);
+}
+
+void RadarTargetDetector::flush()
+{
+  for(const auto& run: m_previous_runs)
+  {
+    int root = find(run.component);
+    if(m_components[root].count > 0)
+      finish(root);
+  }
+  m_previous_runs.clear();
+}
@@ -0,0 +1,150 @@
+#ifndef CAMP_RADAR_TARGET_DETECTOR_H
+#define CAMP_RADAR_TARGET_DETECTOR_H
+
+#include <QImage>
+#include <QMutex>
+#include <QWaitCondition>
+#include <deque>
+#include <functional>
+#include <vector>
+#include <ros/time.h>
+
+class QThread;
+
+// A group of connected echoes above the detection threshold.
+// Positions are in meters from the radar, x east and y north.
+struct RadarTarget
+{
+  ros::Time timestamp;
+  double x = 0.0;
+  double y = 0.0;
+  double min_range = 0.0;
+  double max_range = 0.0;
+  // Counterclockwise from east, max_bearing may exceed 2*pi when
+  // the target spans east.
+  double min_bearing = 0.0;
+  double max_bearing = 0.0;
+  int pixel_count = 0;
+  float mean_intensity = 0.0;
+};
+
+// Extracts targets from the radar sector stream on its own thread.
+//
+// Each spoke is reduced to runs of samples above the threshold. Runs
+// overlapping a run of the previous spoke join its component, merging
+// components through union-find when a run bridges several. A
+// component is reported once a spoke passes without extending it, so
+// targets come out as soon as the antenna has swept past them and
+// only the runs of one spoke are kept between spokes.
+class RadarTargetDetector
+{
+public:
+  // release is called with each sector image once it's processed.
+  RadarTargetDetector(std::function<void(QImage*)> release);
+  ~RadarTargetDetector();
+
+  // Called with each batch of targets completed by a sector,
+  // from the detector's thread.
+  void setTargetsCallback(std::function<void(const std::vector<RadarTarget>&)> callback);
+
+  // Minimum 8 bit intensity of a target echo and the minimum
+  // number of samples for a component to be reported. Take effect
+  // from the next sector.
+  void setThreshold(int threshold);
+  void setMinimumPixels(int count);
+
+  // Takes ownership of a sector image with the layout used by
+  // RadarDisplay, row 0 at min_angle and samples going out from the
+  // radar. Angles are in radians, counterclockwise from east.
+  void addSector(QImage* image, double min_angle, double max_angle, double range, ros::Time timestamp);
+
+  // Average milliseconds spent on a sector, for benchmarking
+  // against the radar's sector rate.
+  double processingTime() const;
+  // Sectors processed and the most sectors that have waited in the
+  // queue at once. A growing queue means detection can't keep up.
+  std::size_t sectorCount() const;
+  std::size_t maxQueueDepth() const;
+  // Restarts the count and queue depth, at the start of a benchmark.
+  void resetStatistics();
+
+private:
+  struct Sector
+  {
+    QImage* image;
+    double min_angle;
+    double max_angle;
+    double range;
+    ros::Time timestamp;
+  };
+
+  struct Run
+  {
+    int start;
+    int end;
+    int component;
+  };
+
+  struct Component
+  {
+    int parent;
+    // Members form a list so all of them can be freed with the root.
+    int next;
+    int tail;
+    int last_spoke;
+    int count;
+    double sum_intensity;
+    double sum_x;
+    double sum_y;
+    double min_range;
+    double max_range;
+    double min_bearing;
+    double max_bearing;
+    ros::Time timestamp;
+  };
+
+  void run();
+  void processSector(const Sector& sector);
+  void processSpoke(const uchar* samples, int count, double bearing, double range, ros::Time timestamp);
+  int newComponent();
+  int find(int component);
+  void merge(int a, int b);
+  void finish(int root);
+  // Reports every open component, used when the spoke sequence breaks.
+  void flush();
+
+  std::function<void(QImage*)> m_release;
+  std::function<void(const std::vector<RadarTarget>&)> m_targets_callback;
+
+  mutable QMutex m_queue_mutex;
+  QWaitCondition m_queue_condition;
+  std::deque<Sector> m_queue;
+  QThread* m_thread;
+
+  // Guarded by m_queue_mutex.
+  int m_threshold = 100;
+  int m_minimum_pixels = 4;
+
+  // Only used from the detector's thread.
+  // Settings copied when a sector is taken from the queue.
+  int m_sector_threshold = 100;
+  int m_sector_minimum_pixels = 4;
+  std::vector<Component> m_components;
+  std::vector<int> m_free_components;
+  std::vector<Run> m_previous_runs;
+  std::vector<Run> m_current_runs;
+  std::vector<RadarTarget> m_targets;
+  int m_spoke = 0;
+  int m_spoke_length = 0;
+  double m_last_bearing = 0.0;
+  double m_unwrapped_bearing = 0.0;
+  ros::Time m_last_timestamp;
+
+  mutable QMutex m_stats_mutex;
+  double m_processing_time = 0.0;
+  std::size_t m_sector_count = 0;
+  // Guarded by m_queue_mutex.
+  std::size_t m_max_queue_depth = 0;
+};
+
+#endif
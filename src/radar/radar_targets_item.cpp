@@ -0,0 +1,63 @@
+#include "radar_targets_item.h"
+#include <QPainter>
+#include <algorithm>
+
+RadarTargetsItem::RadarTargetsItem(QGraphicsItem* parent): QGraphicsItem(parent)
+{
+}
+
+QRectF RadarTargetsItem::boundingRect() const
+{
+  return m_bounds;
+}
+
+void RadarTargetsItem::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget)
+{
+  QPen p(Qt::yellow);
+  p.setCosmetic(true);
+  p.setWidth(2);
+  painter->setPen(p);
+  painter->setBrush(Qt::NoBrush);
+  for(const auto& t: m_targets)
+  {
+    // Radar y is north, scene y is down.
+    double size = std::max(t.max_range-t.min_range, 5.0)/m_pixel_size;
+    QPointF center(t.x/m_pixel_size, -t.y/m_pixel_size);
+    painter->drawRect(QRectF(center.x()-size/2.0, center.y()-size/2.0, size, size));
+  }
+}
+
+void RadarTargetsItem::addTargets(const std::vector<RadarTarget>& targets)
+{
+  m_targets.insert(m_targets.end(), targets.begin(), targets.end());
+  updateBounds();
+}
+
+void RadarTargetsItem::expireTargets(ros::Time now, double max_age)
+{
+  ros::Time cutoff = now - ros::Duration(std::min(max_age, now.toSec()));
+  auto expired = std::remove_if(m_targets.begin(), m_targets.end(), [cutoff](const RadarTarget& t){return t.timestamp < cutoff;});
+  if(expired == m_targets.end())
+    return;
+  m_targets.erase(expired, m_targets.end());
+  updateBounds();
+}
+
+void RadarTargetsItem::updateBounds()
+{
+  QRectF bounds;
+  for(const auto& t: m_targets)
+  {
+    double size = std::max(t.max_range-t.min_range, 5.0)/m_pixel_size;
+    bounds |= QRectF(t.x/m_pixel_size-size, -t.y/m_pixel_size-size, size*2.0, size*2.0);
+  }
+  prepareGeometryChange();
+  m_bounds = bounds;
+  update();
+}
+
+void RadarTargetsItem::setPixelSize(double pixel_size)
+{
+  m_pixel_size = pixel_size;
+  updateBounds();
+}
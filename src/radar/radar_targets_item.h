@@ -0,0 +1,35 @@
+#ifndef CAMP_RADAR_TARGETS_ITEM_H
+#define CAMP_RADAR_TARGETS_ITEM_H
+
+#include <QGraphicsItem>
+#include <vector>
+#include "radar_target_detector.h"
+
+// Outlines the targets found by RadarTargetDetector. A child of
+// RadarDisplay so it follows the radar's position.
+class RadarTargetsItem: public QGraphicsItem
+{
+public:
+  RadarTargetsItem(QGraphicsItem* parent);
+
+  QRectF boundingRect() const override;
+  void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget) override;
+
+  // Adds newly detected targets. Must be called from the GUI thread.
+  void addTargets(const std::vector<RadarTarget>& targets);
+
+  // Drops targets older than max_age seconds before now. Called
+  // periodically, so targets also go when the radar stops.
+  void expireTargets(ros::Time now, double max_age);
+
+  void setPixelSize(double pixel_size);
+
+private:
+  void updateBounds();
+
+  std::vector<RadarTarget> m_targets;
+  QRectF m_bounds;
+  double m_pixel_size = 1.0;
+};
+
+#endif
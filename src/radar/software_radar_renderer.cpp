@@ -0,0 +1,130 @@
+#include "software_radar_renderer.h"
+#include <cmath>
+#include <algorithm>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+SoftwareRadarRenderer::SoftwareRadarRenderer(int image_size, int bearing_bins):
+  m_image(image_size, image_size, QImage::Format_ARGB32_Premultiplied), m_bearing_bins(bearing_bins)
+{
+  clear();
+
+  // First pass counts pixels per bin so the second can place
+  // them directly, keeping each bin's pixels in memory order.
+  std::vector<uint32_t> pixel_bins;
+  std::vector<uint16_t> pixel_ranges;
+  std::vector<uint32_t> pixel_indices;
+  m_bin_start.assign(bearing_bins+1, 0);
+
+  for(int row = 0; row < image_size; row++)
+    for(int col = 0; col < image_size; col++)
+    {
+      // image y goes down while radar y goes up
+      double x = (col+0.5)*2.0/image_size - 1.0;
+      double y = 1.0 - (row+0.5)*2.0/image_size;
+      double r = sqrt(x*x+y*y);
+      if(r > 1.0)
+        continue;
+      double theta = atan2(y, x);
+      if(theta < 0.0)
+        theta += 2.0*M_PI;
+      uint32_t bin = std::min<uint32_t>(bearing_bins-1, theta*bearing_bins/(2.0*M_PI));
+      pixel_bins.push_back(bin);
+      pixel_ranges.push_back(std::min(65535.0, r*65536.0));
+      pixel_indices.push_back(row*image_size+col);
+      m_bin_start[bin+1]++;
+    }
+
+  for(int i = 0; i < bearing_bins; i++)
+    m_bin_start[i+1] += m_bin_start[i];
+
+  m_pixel_index.resize(pixel_indices.size());
+  m_pixel_range.resize(pixel_indices.size());
+  std::vector<uint32_t> fill = m_bin_start;
+  for(std::size_t i = 0; i < pixel_indices.size(); i++)
+  {
+    auto position = fill[pixel_bins[i]]++;
+    m_pixel_index[position] = pixel_indices[i];
+    m_pixel_range[position] = pixel_ranges[i];
+  }
+}
+
+void SoftwareRadarRenderer::clear()
+{
+  m_image.fill(Qt::transparent);
+}
+
+void SoftwareRadarRenderer::drawSector(const uchar* data, int width, int height, int bytes_per_line, double min_angle, double max_angle, float fade, const QColor& color)
+{
+  if(!data || width <= 0 || height <= 0)
+    return;
+
+  double span = max_angle - min_angle;
+  if(span <= 0.0)
+    span += 2.0*M_PI;
+  if(span <= 0.0 || span > 2.0*M_PI)
+    return;
+  min_angle = std::fmod(min_angle, 2.0*M_PI);
+  if(min_angle < 0.0)
+    min_angle += 2.0*M_PI;
+
+  // Color for each intensity value at this fade level, matching
+  // the shader's color*fade*intensity. Values below 0.01 clear the
+  // pixel so the sector replaces what was drawn at its bearings.
+  const int threshold = 3;
+  QRgb palette[256];
+  for(int i = 0; i < 256; i++)
+  {
+    float k = i < threshold ? 0.0f : fade*i/255.0f;
+    palette[i] = qRgba(color.red()*k, color.green()*k, color.blue()*k, color.alpha()*k);
+  }
+
+  auto pixels = reinterpret_cast<QRgb*>(m_image.bits());
+  double bin_size = 2.0*M_PI/m_bearing_bins;
+  int first_bin = floor(min_angle/bin_size);
+  int last_bin = floor((min_angle+span)/bin_size);
+
+  for(int b = first_bin; b <= last_bin; b++)
+  {
+    double v = ((b+0.5)*bin_size - min_angle)/span;
+    if(v < 0.0 || v > 1.0)
+      continue;
+    const uchar* row = data + std::min(height-1, int(v*height))*bytes_per_line;
+    int bin = b % m_bearing_bins;
+    for(uint32_t i = m_bin_start[bin]; i < m_bin_start[bin+1]; i++)
+    {
+      uchar sample = row[std::min(width-1, int((uint32_t(m_pixel_range[i])*width) >> 16))];
+      pixels[m_pixel_index[i]] = palette[sample];
+    }
+  }
+}
+
+void SoftwareRadarRenderer::decay(float factor)
+{
+  if(factor >= 1.0f)
+    return;
+  uint32_t scale = std::max(0.0f, factor)*256.0f;
+  uchar* bytes = m_image.bits();
+  std::size_t count = std::size_t(m_image.bytesPerLine())*m_image.height();
+  std::size_t i = 0;
+#ifdef __SSE2__
+  // 16 channels at a time, widened to 16 bits for the multiply.
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i multiplier = _mm_set1_epi16(scale);
+  for(; i + 16 <= count; i += 16)
+  {
+    __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes+i));
+    __m128i lo = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(p, zero), multiplier), 8);
+    __m128i hi = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(p, zero), multiplier), 8);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(bytes+i), _mm_packus_epi16(lo, hi));
+  }
+#endif
+  for(; i < count; i++)
+    bytes[i] = (bytes[i]*scale) >> 8;
+}
+
+const QImage& SoftwareRadarRenderer::image() const
+{
+  return m_image;
+}
@@ -0,0 +1,50 @@
+#ifndef CAMP_SOFTWARE_RADAR_RENDERER_H
+#define CAMP_SOFTWARE_RADAR_RENDERER_H
+
+#include <QImage>
+#include <QColor>
+#include <vector>
+
+// Renders radar sectors into an image on the CPU. Used by RadarDisplay
+// when no OpenGL context is available.
+//
+// A lookup table built once sorts the pixels inside the radar circle by
+// bearing bin and stores their normalized range, so drawing a sector only
+// visits the pixels it covers and needs no trigonometry per pixel.
+class SoftwareRadarRenderer
+{
+public:
+  SoftwareRadarRenderer(int image_size = 1024, int bearing_bins = 4096);
+
+  // Sets all pixels to transparent.
+  void clear();
+
+  // Scales every pixel by factor, fading the persistence of older
+  // sweeps. Premultiplied alpha keeps the colors consistent.
+  void decay(float factor);
+
+  // Draws a sector with the same conventions as the OpenGL shader,
+  // replacing whatever was previously drawn at its bearings.
+  // data has height rows of width samples, row 0 being at min_angle and
+  // samples going from the center out. Angles are in radians,
+  // counterclockwise from the image's x axis.
+  void drawSector(const uchar* data, int width, int height, int bytes_per_line, double min_angle, double max_angle, float fade, const QColor& color);
+
+  // Premultiplied ARGB image of the radar, centered on the radar.
+  const QImage& image() const;
+
+private:
+  QImage m_image;
+
+  int m_bearing_bins;
+
+  // Pixels sorted by bearing bin. m_bin_start[b] is the first entry
+  // of bin b and m_bin_start[b+1] is one past its last.
+  std::vector<uint32_t> m_bin_start;
+  std::vector<uint32_t> m_pixel_index;
+
+  // Range of each pixel as a fraction of the radius, scaled to 16 bits.
+  std::vector<uint16_t> m_pixel_range;
+};
+
+#endif
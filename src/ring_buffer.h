@@ -0,0 +1,154 @@
+#ifndef CAMP_RING_BUFFER_H
+#define CAMP_RING_BUFFER_H
+
+#include <cstddef>
+#include <vector>
+
+// Fixed capacity buffer that overwrites its oldest element when full.
+// Index 0 is the oldest element. Storage is allocated once, when the
+// capacity is set.
+template <typename T> class RingBuffer
+{
+public:
+  explicit RingBuffer(std::size_t capacity = 0)
+  {
+    setCapacity(capacity);
+  }
+
+  // Keeps the newest elements that fit.
+  void setCapacity(std::size_t capacity)
+  {
+    std::vector<T> data;
+    data.reserve(capacity);
+    std::size_t skip = m_size > capacity ? m_size - capacity : 0;
+    for(std::size_t i = skip; i < m_size; i++)
+      data.push_back(at(i));
+    m_size = data.size();
+    data.resize(capacity);
+    m_data.swap(data);
+    m_start = 0;
+  }
+
+  std::size_t capacity() const
+  {
+    return m_data.size();
+  }
+
+  std::size_t size() const
+  {
+    return m_size;
+  }
+
+  bool empty() const
+  {
+    return m_size == 0;
+  }
+
+  bool full() const
+  {
+    return m_size == m_data.size();
+  }
+
+  // Appends value, dropping the oldest element if full. Does nothing
+  // if the capacity is 0.
+  void push_back(const T& value)
+  {
+    if(m_data.empty())
+      return;
+    if(full())
+    {
+      m_data[m_start] = value;
+      m_start = (m_start+1) % m_data.size();
+    }
+    else
+    {
+      m_data[(m_start+m_size) % m_data.size()] = value;
+      m_size++;
+    }
+  }
+
+  // Inserts value before index i, dropping the oldest element if
+  // full. Nothing is inserted if value would be the one dropped.
+  void insert(std::size_t i, const T& value)
+  {
+    if(m_data.empty() || (full() && i == 0))
+      return;
+    if(full())
+    {
+      pop_front();
+      i--;
+    }
+    push_back(value);
+    for(std::size_t j = m_size-1; j > i; j--)
+      at(j) = at(j-1);
+    at(i) = value;
+  }
+
+  void pop_front()
+  {
+    if(m_size == 0)
+      return;
+    m_start = (m_start+1) % m_data.size();
+    m_size--;
+  }
+
+  void pop_back()
+  {
+    if(m_size == 0)
+      return;
+    m_size--;
+  }
+
+  void clear()
+  {
+    m_start = 0;
+    m_size = 0;
+  }
+
+  T& at(std::size_t i)
+  {
+    return m_data[(m_start+i) % m_data.size()];
+  }
+
+  const T& at(std::size_t i) const
+  {
+    return m_data[(m_start+i) % m_data.size()];
+  }
+
+  T& operator[](std::size_t i)
+  {
+    return at(i);
+  }
+
+  const T& operator[](std::size_t i) const
+  {
+    return at(i);
+  }
+
+  T& front()
+  {
+    return at(0);
+  }
+
+  const T& front() const
+  {
+    return at(0);
+  }
+
+  T& back()
+  {
+    return at(m_size-1);
+  }
+
+  const T& back() const
+  {
+    return at(m_size-1);
+  }
+
+private:
+  std::vector<T> m_data;
+  std::size_t m_start = 0;
+  std::size_t m_size = 0;
+};
+
+#endif
@@ -1,4 +1,5 @@
 #include "ship_track.h"
+#include <algorithm>
 #include <cmath>
 #include <QDebug>
 
@@ -8,68 +9,91 @@ ShipTrack::ShipTrack(QGraphicsItem *parentItem):GeoGraphicsItem(parentItem)
 
 }
 
-void ShipTrack::drawTriangle(QPainterPath& path, BackgroundRaster* bg, const QGeoCoordinate& location, double heading_degrees, double scale) const
+QTransform ShipTrack::localFrame(BackgroundRaster* bg, const QGeoCoordinate& location, const QPointF& anchor) const
+{
+  if(bg != m_frame_background || !m_frame_location.isValid() || fabs(location.latitude()-m_frame_location.latitude()) > 0.01 || fabs(location.longitude()-m_frame_location.longitude()) > 0.01)
+  {
+    QPointF north = geoToPixel(location.atDistanceAndAzimuth(100.0, 0.0), bg) - geoToPixel(location, bg);
+    m_frame_scale = sqrt(north.x()*north.x()+north.y()*north.y())/100.0;
+    m_frame_rotation = atan2(north.x(), -north.y())*180.0/M_PI;
+    m_frame_background = bg;
+    m_frame_location = location;
+  }
+
+  // Pixels have y down, so north is flipped after scaling.
+  QTransform ret;
+  ret.translate(anchor.x(), anchor.y());
+  ret.rotate(m_frame_rotation);
+  ret.scale(m_frame_scale, -m_frame_scale);
+  return ret;
+}
+
+QTransform ShipTrack::localFrame(BackgroundRaster* bg, const QGeoCoordinate& location) const
+{
+  return localFrame(bg, location, geoToPixel(location, bg));
+}
+
+void ShipTrack::drawTriangle(QPainterPath& path, const QTransform& frame, double heading_degrees, double scale) const
 {
   if(std::isnan(heading_degrees))
   {
-    QPointF center = geoToPixel(location, bg);
-    QGeoCoordinate radius_away = location.atDistanceAndAzimuth(15, 0);
-    QPointF radius_away_local = geoToPixel(radius_away, bg);
-    QPointF radius_local = center-radius_away_local;
-    float radius_pixel = sqrt(radius_local.rx()*radius_local.rx()+radius_local.ry()*radius_local.ry());
-    path.addEllipse(center, radius_pixel, radius_pixel);
+    qreal radius_pixel = 15*sqrt(fabs(frame.determinant()));
+    path.addEllipse(frame.map(QPointF()), radius_pixel, radius_pixel);
     //path.addEllipse(center, 15*scale, 15*scale);
     return;
   }
-  QGeoCoordinate tip = location.atDistanceAndAzimuth(15*scale,heading_degrees);
-  QGeoCoordinate llcorner = location.atDistanceAndAzimuth(15*scale,heading_degrees-150);
-  QGeoCoordinate lrcorner = location.atDistanceAndAzimuth(15*scale,heading_degrees+150);
 
-  QPointF ltip = geoToPixel(tip, bg);
-  QPointF lllocal = geoToPixel(llcorner, bg);
-  QPointF lrlocal = geoToPixel(lrcorner, bg);
+  // Tip ahead and corners 150 degrees either side, 15 meters out.
+  QTransform t = frame;
+  t.rotate(-heading_degrees);
+  t.scale(15*scale, 15*scale);
 
+  QPointF ltip = t.map(QPointF(0.0, 1.0));
   path.moveTo(ltip);
-  path.lineTo(lllocal);
-  path.lineTo(lrlocal);
+  path.lineTo(t.map(QPointF(-0.5, -0.866025)));
+  path.lineTo(t.map(QPointF(0.5, -0.866025)));
   path.lineTo(ltip);
 }
 
-void ShipTrack::drawShipOutline(QPainterPath& path, BackgroundRaster* bg, const QGeoCoordinate& location, double heading_degrees, float dimension_to_bow, float dimension_to_port, float dimension_to_stbd, float dimension_to_stern) const
+void ShipTrack::drawShipOutline(QPainterPath& path, const QTransform& frame, double heading_degrees, float dimension_to_bow, float dimension_to_port, float dimension_to_stbd, float dimension_to_stern) const
 {
   if(std::isnan(heading_degrees))
   {
-    QPointF center = geoToPixel(location, bg);
     float radius = std::max(dimension_to_bow, dimension_to_stern);
     radius = std::max(radius, dimension_to_port);
     radius = std::max(radius, dimension_to_stbd);
-    QGeoCoordinate radius_away = location.atDistanceAndAzimuth(radius,0);
-    QPointF radius_away_local = geoToPixel(radius_away, bg);
-    QPointF radius_local = center-radius_away_local;
-    float radius_pixel = sqrt(radius_local.rx()*radius_local.rx()+radius_local.ry()*radius_local.ry());
-    path.addEllipse(center, radius_pixel, radius_pixel);
+    qreal radius_pixel = radius*sqrt(fabs(frame.determinant()));
+    path.addEllipse(frame.map(QPointF()), radius_pixel, radius_pixel);
     return;
   }
 
-  float length = dimension_to_bow+dimension_to_stern;
-  float width = dimension_to_port+dimension_to_stbd;
-  QGeoCoordinate llcorner = location.atDistanceAndAzimuth(dimension_to_port,270+heading_degrees).atDistanceAndAzimuth(dimension_to_stern,180+heading_degrees);
-  QGeoCoordinate lrcorner = llcorner.atDistanceAndAzimuth(width,90+heading_degrees);
-  QGeoCoordinate urcorner = lrcorner.atDistanceAndAzimuth(length,heading_degrees);
-  QGeoCoordinate ulcorner = urcorner.atDistanceAndAzimuth(width,270+heading_degrees);
-  QGeoCoordinate rkink = lrcorner.atDistanceAndAzimuth(length*.8,heading_degrees);
-  QGeoCoordinate lkink = llcorner.atDistanceAndAzimuth(length*.8,heading_degrees);
-  QGeoCoordinate bow = ulcorner.atDistanceAndAzimuth(width/2.0,90+heading_degrees);
-  QPointF lllocal = geoToPixel(llcorner, bg);
-  QPointF lrlocal = geoToPixel(lrcorner, bg);
-  QPointF lkinkl = geoToPixel(lkink, bg);
-  QPointF rkinkl = geoToPixel(rkink, bg);
-  QPointF bowl = geoToPixel(bow, bg);
-  
-  path.moveTo(lllocal);
-  path.lineTo(lrlocal);
-  path.lineTo(rkinkl);
-  path.lineTo(bowl);
-  path.lineTo(lkinkl);
-  path.lineTo(lllocal);
+  float dimensions[4] = {dimension_to_bow, dimension_to_port, dimension_to_stbd, dimension_to_stern};
+  if(m_outline.isEmpty() || !std::equal(dimensions, dimensions+4, m_outline_dimensions))
+  {
+    // Starboard is +x and the bow +y, from the reference point.
+    float length = dimension_to_bow+dimension_to_stern;
+    float kink = length*.8 - dimension_to_stern;
+    m_outline.clear();
+    m_outline << QPointF(-dimension_to_port, -dimension_to_stern)
+              << QPointF(dimension_to_stbd, -dimension_to_stern)
+              << QPointF(dimension_to_stbd, kink)
+              << QPointF((dimension_to_stbd-dimension_to_port)/2.0, dimension_to_bow)
+              << QPointF(-dimension_to_port, kink)
+              << QPointF(-dimension_to_port, -dimension_to_stern);
+    std::copy(dimensions, dimensions+4, m_outline_dimensions);
+  }
+
+  QTransform t = frame;
+  t.rotate(-heading_degrees);
+  path.addPolygon(t.map(m_outline));
+}
+
+void ShipTrack::drawTriangle(QPainterPath& path, BackgroundRaster* bg, const QGeoCoordinate& location, double heading_degrees, double scale) const
+{
+  drawTriangle(path, localFrame(bg, location), heading_degrees, scale);
+}
+
+void ShipTrack::drawShipOutline(QPainterPath& path, BackgroundRaster* bg, const QGeoCoordinate& location, double heading_degrees, float dimension_to_bow, float dimension_to_port, float dimension_to_stbd, float dimension_to_stern) const
+{
+  drawShipOutline(path, localFrame(bg, location), heading_degrees, dimension_to_bow, dimension_to_port, dimension_to_stbd, dimension_to_stern);
 }
@@ -2,6 +2,8 @@
 #define CAMP_SHIP_TRACK_H
 
 #include "geographicsitem.h"
+#include <QPolygonF>
+#include <QTransform>
 
 class ShipTrack: public GeoGraphicsItem
 {
@@ -9,9 +11,33 @@ public:
   ShipTrack(QGraphicsItem *parentItem = nullptr);
 
 protected:
+  // Returns a transform from meters east and north of location to the
+  // parent's pixels, placing location at anchor. The scale and grid
+  // convergence are cached and only recomputed when location moves
+  // about a kilometer from where they were last measured, so the
+  // glyphs below cost one projection at most.
+  QTransform localFrame(BackgroundRaster* bg, QGeoCoordinate const &location, QPointF const &anchor) const;
+  QTransform localFrame(BackgroundRaster* bg, QGeoCoordinate const &location) const;
+
+  // Glyphs are drawn in meters around the frame's origin and rotated
+  // to heading.
+  void drawTriangle(QPainterPath &path, QTransform const &frame, double heading_degrees, double scale=1.0) const;
+  void drawShipOutline(QPainterPath &path, QTransform const &frame, double heading_degrees, float dimension_to_bow, float dimension_to_port, float dimension_to_stbd, float dimension_to_stern) const;
+
   void drawTriangle(QPainterPath &path, BackgroundRaster* bg, QGeoCoordinate const &location, double heading_degrees, double scale=1.0) const;
   void drawShipOutline(QPainterPath &path, BackgroundRaster* bg, QGeoCoordinate const &location, double heading_degrees, float dimension_to_bow, float dimension_to_port, float dimension_to_stbd, float dimension_to_stern) const;
 
+private:
+  // Where the frame's scale and rotation were measured.
+  mutable BackgroundRaster* m_frame_background = nullptr;
+  mutable QGeoCoordinate m_frame_location;
+  // Pixels per meter and degrees clockwise from up to north.
+  mutable qreal m_frame_scale = 0.0;
+  mutable qreal m_frame_rotation = 0.0;
+
+  // Outline in meters, bow up, for the last dimensions drawn.
+  mutable QPolygonF m_outline;
+  mutable float m_outline_dimensions[4] = {0, 0, 0, 0};
 };
 
-#endif
\ No newline at end of file
+#endif
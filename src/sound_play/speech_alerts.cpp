@@ -1,5 +1,6 @@
 #include "speech_alerts.h"
 #include "sound_play_widget.h"
+#include <cmath>
 
 SpeechAlerts::SpeechAlerts(QObject* parent):
   QObject(parent)
@@ -19,4 +20,26 @@ void SpeechAlerts::updatePilotingMode(QString piloting_mode)
   m_piloting_mode = piloting_mode;
 }
 
+void SpeechAlerts::collisionRisk(uint32_t mmsi, QString name, double cpa, double tcpa)
+{
+  QDateTime now = QDateTime::currentDateTime();
+  auto last = m_last_collision_alerts.find(mmsi);
+  if(last != m_last_collision_alerts.end() && last.value().secsTo(now) < 60)
+    return;
+  m_last_collision_alerts[mmsi] = now;
+  emit tell("Collision risk, "+name+", "+QString::number(int(cpa))+" meters in "+QString::number(int(std::ceil(tcpa/60.0)))+" minutes");
+}
 
+void SpeechAlerts::geofenceAlert(QString key, QString name, QString area, double seconds)
+{
+  QDateTime now = QDateTime::currentDateTime();
+  QString alert = key+"/"+area;
+  auto last = m_last_geofence_alerts.find(alert);
+  if(last != m_last_geofence_alerts.end() && last.value().secsTo(now) < 60)
+    return;
+  m_last_geofence_alerts[alert] = now;
+  if(seconds <= 0.0)
+    emit tell(name+" inside "+area);
+  else
+    emit tell(name+" entering "+area+" in "+QString::number(int(std::ceil(seconds/60.0)))+" minutes");
+}
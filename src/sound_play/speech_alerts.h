@@ -2,6 +2,9 @@
 #define CAMP_SPEECH_ALERTS_H
 
 #include <QObject>
+#include <QMap>
+#include <QDateTime>
+#include <cstdint>
 
 class SpeechAlerts: public QObject
 {
@@ -16,8 +19,18 @@ signals:
 public slots:
   void updatePilotingMode(QString piloting_mode);
 
+  // Announces a contact at risk, at most once a minute per MMSI.
+  void collisionRisk(uint32_t mmsi, QString name, double cpa, double tcpa);
+
+  // Announces an object in or heading into an avoid area, at most once
+  // a minute per object and area. key identifies the object, name is
+  // what's said.
+  void geofenceAlert(QString key, QString name, QString area, double seconds);
+
 private:
   QString m_piloting_mode;
+  QMap<uint32_t, QDateTime> m_last_collision_alerts;
+  QMap<QString, QDateTime> m_last_geofence_alerts;
 };
 
 #endif
@@ -0,0 +1,84 @@
+#include "time_slider.h"
+#include "history_store.h"
+#include <QCheckBox>
+#include <QDateTime>
+#include <QHBoxLayout>
+#include <QLabel>
+#include <QSlider>
+#include <cmath>
+
+namespace
+{
+
+// Slider steps, fine enough to scrub hours a few seconds at a time.
+const int slider_steps = 10000;
+
+} // namespace
+
+TimeSlider::TimeSlider(HistoryStore* store, QWidget* parent): QWidget(parent), m_store(store)
+{
+  auto layout = new QHBoxLayout(this);
+  layout->setContentsMargins(0, 0, 0, 0);
+  m_live = new QCheckBox(tr("Live"), this);
+  m_live->setChecked(true);
+  m_slider = new QSlider(Qt::Horizontal, this);
+  m_slider->setRange(0, slider_steps);
+  m_slider->setValue(slider_steps);
+  m_slider->setMinimumWidth(200);
+  m_label = new QLabel(this);
+  layout->addWidget(m_live);
+  layout->addWidget(m_slider);
+  layout->addWidget(m_label);
+
+  connect(m_live, &QCheckBox::toggled, this, &TimeSlider::liveToggled);
+  connect(m_slider, &QSlider::valueChanged, this, &TimeSlider::sliderMoved);
+  updateLabel(std::nan(""));
+}
+
+// The slider spans whatever the store holds when it's moved, so a
+// given position drifts forward as the store grows.
+double TimeSlider::sliderTime(int value) const
+{
+  double start = m_store->startTime();
+  double end = m_store->endTime();
+  if(std::isnan(start))
+    return std::nan("");
+  return start + (end-start)*value/double(slider_steps);
+}
+
+void TimeSlider::updateLabel(double time)
+{
+  if(std::isnan(time))
+    m_label->setText(tr("Live"));
+  else
+    m_label->setText(QDateTime::fromMSecsSinceEpoch(qint64(time*1000.0)).toString("yyyy-MM-dd hh:mm:ss"));
+}
+
+void TimeSlider::liveToggled(bool live)
+{
+  if(live)
+  {
+    m_slider->blockSignals(true);
+    m_slider->setValue(slider_steps);
+    m_slider->blockSignals(false);
+    updateLabel(std::nan(""));
+    emit displayTimeChanged(std::nan(""));
+  }
+  else
+    sliderMoved(m_slider->value());
+}
+
+void TimeSlider::sliderMoved(int value)
+{
+  if(m_live->isChecked())
+  {
+    // Dragging the slider leaves live mode.
+    m_live->blockSignals(true);
+    m_live->setChecked(false);
+    m_live->blockSignals(false);
+  }
+  double time = sliderTime(value);
+  updateLabel(time);
+  if(!std::isnan(time))
+    emit displayTimeChanged(time);
+}
@@ -0,0 +1,38 @@
+#ifndef CAMP_TIME_SLIDER_H
+#define CAMP_TIME_SLIDER_H
+
+#include <QWidget>
+
+class HistoryStore;
+class QCheckBox;
+class QLabel;
+class QSlider;
+
+// Picks the time the map displays, either live or any time covered by
+// a HistoryStore.
+class TimeSlider: public QWidget
+{
+  Q_OBJECT
+
+public:
+  explicit TimeSlider(HistoryStore* store, QWidget* parent = nullptr);
+
+signals:
+  // Seconds since the epoch, or NaN for live.
+  void displayTimeChanged(double time);
+
+private slots:
+  void liveToggled(bool live);
+  void sliderMoved(int value);
+
+private:
+  double sliderTime(int value) const;
+  void updateLabel(double time);
+
+  HistoryStore* m_store;
+  QCheckBox* m_live;
+  QSlider* m_slider;
+  QLabel* m_label;
+};
+
+#endif
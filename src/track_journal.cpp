@@ -0,0 +1,407 @@
+#include "track_journal.h"
+#include "ros/ros.h"
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QRegularExpression>
+#include <QStandardPaths>
+#include <QThread>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+
+using namespace track_journal;
+
+namespace
+{
+
+uint32_t checksum(const Record& record)
+{
+  // FNV-1a
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(&record);
+  uint32_t hash = 2166136261u;
+  for(std::size_t i = 0; i < offsetof(Record, checksum); i++)
+    hash = (hash ^ data[i]) * 16777619u;
+  return hash;
+}
+
+bool validFileHeader(const uchar* data, qint64 size)
+{
+  if(!data || size < qint64(sizeof(FileHeader)))
+    return false;
+  FileHeader header;
+  memcpy(&header, data, sizeof(header));
+  return memcmp(header.magic, magic, sizeof(magic)) == 0 && header.version == version && header.record_size == sizeof(Record);
+}
+
+// Number of records up to the last valid one. Only the end of the
+// file can be torn, so earlier records are checked as they're read.
+std::size_t recordCount(const uchar* data, qint64 size)
+{
+  std::size_t count = (size - sizeof(FileHeader))/sizeof(Record);
+  const Record* records = reinterpret_cast<const Record*>(data + sizeof(FileHeader));
+  while(count > 0 && !valid(records[count-1]))
+    count--;
+  return count;
+}
+
+// Reads the checkpoints that refer to the first record_count records.
+std::vector<IndexEntry> readIndex(QFile& file, std::size_t record_count)
+{
+  std::vector<IndexEntry> entries(file.size()/sizeof(IndexEntry));
+  file.seek(0);
+  file.read(reinterpret_cast<char*>(entries.data()), entries.size()*sizeof(IndexEntry));
+  std::size_t count = 0;
+  while(count < entries.size() && entries[count].record <= int64_t(record_count) && (count == 0 || entries[count].record > entries[count-1].record))
+    count++;
+  entries.resize(count);
+  return entries;
+}
+
+} // namespace
+
+namespace track_journal
+{
+
+Record& seal(Record& record)
+{
+  record.reserved = 0;
+  record.checksum = checksum(record);
+  return record;
+}
+
+bool valid(const Record& record)
+{
+  return record.checksum == checksum(record);
+}
+
+QString path(QString name)
+{
+  QString directory = ros::param::param<std::string>("~track_journal_directory", (QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)+"/journal").toStdString()).c_str();
+  if(directory.isEmpty())
+    return QString();
+  return directory + "/" + name.replace(QRegularExpression("[^A-Za-z0-9_.-]"), "_") + ".journal";
+}
+
+double reloadSeconds()
+{
+  return ros::param::param<double>("~track_journal_reload_hours", 2.0)*3600.0;
+}
+
+} // namespace track_journal
+
+TrackJournalWriter::TrackJournalWriter(std::size_t queue_capacity): m_queue(queue_capacity)
+{
+}
+
+TrackJournalWriter::~TrackJournalWriter()
+{
+  close();
+}
+
+bool TrackJournalWriter::open(QString path, double retention_seconds)
+{
+  close();
+  m_path = path;
+  m_retention = retention_seconds;
+  QDir().mkpath(QFileInfo(path).path());
+  if(!openFiles())
+    return false;
+  m_stop = false;
+  m_thread = QThread::create(std::bind(&TrackJournalWriter::run, this));
+  m_thread->start();
+  return true;
+}
+
+bool TrackJournalWriter::openFiles()
+{
+  m_record_count = 0;
+  m_latest_ns = 0;
+  m_oldest_ns = 0;
+
+  // Unbuffered so a failed write shows up in write()'s result rather
+  // than on some later flush.
+  m_data.setFileName(m_path);
+  if(!m_data.open(QIODevice::ReadWrite|QIODevice::Unbuffered))
+  {
+    ROS_WARN_STREAM("Unable to open track journal " << m_path.toStdString() << ": " << m_data.errorString().toStdString());
+    return false;
+  }
+
+  if(m_data.size() == 0)
+  {
+    FileHeader header = {};
+    memcpy(header.magic, magic, sizeof(magic));
+    header.version = version;
+    header.record_size = sizeof(Record);
+    m_data.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  }
+  else
+  {
+    const uchar* map = m_data.map(0, m_data.size());
+    if(!validFileHeader(map, m_data.size()))
+    {
+      ROS_WARN_STREAM(m_path.toStdString() << " is not a track journal");
+      m_data.close();
+      return false;
+    }
+    m_record_count = recordCount(map, m_data.size());
+    const Record* records = reinterpret_cast<const Record*>(map + sizeof(FileHeader));
+    if(m_record_count > 0)
+      m_oldest_ns = records[0].stamp_ns;
+    // Checkpoints carry the latest stamp, only the records since the
+    // last one need looking at.
+    for(int64_t i = std::max<int64_t>(0, m_record_count - checkpoint_interval); i < m_record_count; i++)
+      m_latest_ns = std::max(m_latest_ns, records[i].stamp_ns);
+    m_data.unmap(const_cast<uchar*>(map));
+    m_data.resize(sizeof(FileHeader) + m_record_count*sizeof(Record));
+  }
+  m_data.seek(m_data.size());
+
+  m_index.setFileName(m_path+".index");
+  if(!m_index.open(QIODevice::ReadWrite|QIODevice::Unbuffered))
+  {
+    ROS_WARN_STREAM("Unable to open track journal index " << m_index.fileName().toStdString());
+    m_data.close();
+    return false;
+  }
+  auto entries = readIndex(m_index, m_record_count);
+  if(!entries.empty())
+    m_latest_ns = std::max(m_latest_ns, entries.back().stamp_ns);
+  m_index.resize(entries.size()*sizeof(IndexEntry));
+  m_index.seek(m_index.size());
+  return true;
+}
+
+void TrackJournalWriter::close()
+{
+  if(m_thread)
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_wake_mutex);
+      m_stop = true;
+    }
+    m_wake.notify_one();
+    m_thread->wait();
+    delete m_thread;
+    m_thread = nullptr;
+  }
+  m_data.close();
+  m_index.close();
+}
+
+bool TrackJournalWriter::isOpen() const
+{
+  return m_thread != nullptr;
+}
+
+bool TrackJournalWriter::append(const Record& record)
+{
+  if(m_queue.push(record))
+    return true;
+  m_dropped++;
+  ROS_WARN_STREAM_THROTTLE(5.0, "Track journal " << m_path.toStdString() << " queue full, " << m_dropped << " fixes dropped");
+  return false;
+}
+
+void TrackJournalWriter::run()
+{
+  QElapsedTimer compact_timer;
+  bool check_compact = true;
+  while(true)
+  {
+    writeBatch();
+    // Compacting rewrites the kept records, so it waits until the old
+    // ones are as much as what's kept. Checked on start, then every
+    // ten minutes.
+    if(check_compact || compact_timer.elapsed() > 600000)
+    {
+      check_compact = false;
+      compact_timer.start();
+      if(m_retention > 0.0 && m_record_count > 0 && m_oldest_ns < m_latest_ns - int64_t(2.0*m_retention*1.0e9))
+        compact(m_latest_ns - int64_t(m_retention*1.0e9));
+    }
+    std::unique_lock<std::mutex> lock(m_wake_mutex);
+    if(m_wake.wait_for(lock, std::chrono::milliseconds(250), [this]{return m_stop;}))
+      break;
+  }
+  writeBatch();
+}
+
+bool TrackJournalWriter::writeBatch()
+{
+  m_batch.clear();
+  Record record;
+  while(m_batch.size() < m_queue.capacity() && m_queue.pop(record))
+    m_batch.push_back(seal(record));
+  if(m_batch.empty() || !m_data.isOpen())
+    return true;
+
+  qint64 size = m_batch.size()*sizeof(Record);
+  if(m_data.write(reinterpret_cast<const char*>(m_batch.data()), size) != size)
+  {
+    ROS_ERROR_STREAM_THROTTLE(10.0, "Unable to write track journal " << m_path.toStdString() << ", " << m_batch.size() << " fixes dropped: " << m_data.errorString().toStdString());
+    // Cut off whatever part of the batch made it so the next one
+    // starts on a record boundary.
+    m_data.resize(sizeof(FileHeader) + m_record_count*sizeof(Record));
+    m_data.seek(m_data.size());
+    return false;
+  }
+
+  // Only counted once written, checkpoints must not refer past the
+  // records in the file.
+  std::vector<IndexEntry> checkpoints;
+  for(const auto& r: m_batch)
+  {
+    if(m_record_count % checkpoint_interval == 0)
+      checkpoints.push_back({m_latest_ns, m_record_count});
+    if(m_record_count == 0)
+      m_oldest_ns = r.stamp_ns;
+    m_latest_ns = std::max(m_latest_ns, r.stamp_ns);
+    m_record_count++;
+  }
+
+  if(!checkpoints.empty())
+  {
+    qint64 index_size = m_index.size();
+    qint64 checkpoints_size = checkpoints.size()*sizeof(IndexEntry);
+    if(m_index.write(reinterpret_cast<const char*>(checkpoints.data()), checkpoints_size) != checkpoints_size)
+    {
+      // The records are there, readers just can't skip to them.
+      ROS_ERROR_STREAM_THROTTLE(10.0, "Unable to write track journal index " << m_index.fileName().toStdString() << ": " << m_index.errorString().toStdString());
+      m_index.resize(index_size);
+      m_index.seek(index_size);
+    }
+  }
+  return true;
+}
+
+void TrackJournalWriter::compact(int64_t since_ns)
+{
+  TrackJournalReader reader;
+  if(!reader.open(m_path))
+    return;
+  std::size_t start = reader.seek(since_ns);
+  if(start == 0)
+    return;
+
+  QFile data(m_path+".tmp");
+  QFile index(m_path+".index.tmp");
+  if(!data.open(QIODevice::WriteOnly|QIODevice::Truncate) || !index.open(QIODevice::WriteOnly|QIODevice::Truncate))
+  {
+    ROS_WARN_STREAM("Unable to compact track journal " << m_path.toStdString());
+    return;
+  }
+  FileHeader header = {};
+  memcpy(header.magic, magic, sizeof(magic));
+  header.version = version;
+  header.record_size = sizeof(Record);
+  qint64 records_size = (reader.size()-start)*sizeof(Record);
+  bool written = data.write(reinterpret_cast<const char*>(&header), sizeof(header)) == qint64(sizeof(header));
+  written = written && data.write(reinterpret_cast<const char*>(reader.records()+start), records_size) == records_size;
+
+  std::vector<IndexEntry> checkpoints;
+  int64_t latest = 0;
+  for(std::size_t i = start; i < reader.size(); i++)
+  {
+    if((i-start) % checkpoint_interval == 0)
+      checkpoints.push_back({latest, int64_t(i-start)});
+    latest = std::max(latest, reader.records()[i].stamp_ns);
+  }
+  qint64 index_size = checkpoints.size()*sizeof(IndexEntry);
+  written = written && index.write(reinterpret_cast<const char*>(checkpoints.data()), index_size) == index_size;
+  written = written && data.flush() && index.flush();
+  data.close();
+  index.close();
+  reader.close();
+  if(!written)
+  {
+    ROS_WARN_STREAM("Unable to write compacted track journal " << m_path.toStdString() << ", keeping the old one");
+    data.remove();
+    index.remove();
+    return;
+  }
+
+  m_data.close();
+  m_index.close();
+  // The old journal is kept unless the new one replaces it. A stale
+  // index would send readers to the wrong records so it's removed if
+  // it can't be replaced; the journal is still read in full.
+  if(std::rename(data.fileName().toLocal8Bit().constData(), m_path.toLocal8Bit().constData()) != 0)
+  {
+    ROS_WARN_STREAM("Unable to replace track journal " << m_path.toStdString() << ", keeping the old one: " << strerror(errno));
+    data.remove();
+    index.remove();
+  }
+  else if(std::rename(index.fileName().toLocal8Bit().constData(), m_index.fileName().toLocal8Bit().constData()) != 0)
+  {
+    ROS_WARN_STREAM("Unable to replace track journal index " << m_index.fileName().toStdString() << ": " << strerror(errno));
+    index.remove();
+    QFile::remove(m_index.fileName());
+  }
+  else
+    ROS_INFO_STREAM("Compacted track journal " << m_path.toStdString() << ", dropped " << start << " fixes");
+  openFiles();
+}
+
+TrackJournalReader::~TrackJournalReader()
+{
+  close();
+}
+
+bool TrackJournalReader::open(QString path)
+{
+  close();
+  m_data.setFileName(path);
+  if(!m_data.open(QIODevice::ReadOnly))
+    return false;
+  qint64 size = m_data.size();
+  m_map = m_data.map(0, size);
+  if(!validFileHeader(m_map, size))
+  {
+    ROS_WARN_STREAM(path.toStdString() << " is not a track journal");
+    close();
+    return false;
+  }
+  m_size = recordCount(m_map, size);
+
+  QFile index(path+".index");
+  if(index.open(QIODevice::ReadOnly))
+    m_index = readIndex(index, m_size);
+  return true;
+}
+
+void TrackJournalReader::close()
+{
+  if(m_map)
+    m_data.unmap(const_cast<uchar*>(m_map));
+  m_map = nullptr;
+  m_size = 0;
+  m_index.clear();
+  m_data.close();
+}
+
+const Record* TrackJournalReader::records() const
+{
+  if(!m_map)
+    return nullptr;
+  return reinterpret_cast<const Record*>(m_map + sizeof(FileHeader));
+}
+
+std::size_t TrackJournalReader::size() const
+{
+  return m_size;
+}
+
+std::size_t TrackJournalReader::seek(int64_t since_ns) const
+{
+  // Everything before a checkpoint older than since_ns is older too.
+  auto checkpoint = std::lower_bound(m_index.begin(), m_index.end(), since_ns, [](const IndexEntry& e, int64_t t){return e.stamp_ns < t;});
+  if(checkpoint == m_index.begin())
+    return 0;
+  return (checkpoint-1)->record;
+}
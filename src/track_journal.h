@@ -0,0 +1,150 @@
+#ifndef CAMP_TRACK_JOURNAL_H
+#define CAMP_TRACK_JOURNAL_H
+
+#include <QFile>
+#include <QString>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+#include "mpsc_ring_buffer.h"
+
+class QThread;
+
+// Binary layout shared by TrackJournalWriter and TrackJournalReader.
+//
+// The data file starts with a FileHeader followed by fixed size
+// Records, appended in the order fixes arrive, so the file can be
+// mapped and used as an array. Each record carries a checksum so one
+// torn by a crash is recognized and dropped.
+//
+// A sidecar file with the same name plus ".index" holds a checkpoint
+// every checkpoint_interval records with the latest time stamp up to
+// that record, so a reader can skip straight to the last few hours.
+namespace track_journal
+{
+
+const char magic[4] = {'C','T','R','K'};
+const uint32_t version = 1;
+const int64_t checkpoint_interval = 1024;
+
+struct FileHeader
+{
+  char magic[4];
+  uint32_t version;
+  uint32_t record_size;
+  uint32_t reserved;
+};
+
+// One fix. Values a source didn't provide are NaN.
+struct Record
+{
+  int64_t stamp_ns;
+  double latitude;
+  double longitude;
+  // Contact's MMSI, 0 for nav sources.
+  uint32_t id;
+  // Degrees and m/s.
+  float heading;
+  float cog;
+  float sog;
+  uint32_t reserved;
+  // Of the bytes before it.
+  uint32_t checksum;
+};
+
+struct IndexEntry
+{
+  // Latest stamp of the records before record.
+  int64_t stamp_ns;
+  int64_t record;
+};
+
+// Sets the checksum and returns record.
+Record& seal(Record& record);
+bool valid(const Record& record);
+
+// Journal file for a source name, in the directory given by the
+// ~track_journal_directory parameter. Empty if journaling is disabled.
+QString path(QString name);
+// How much history to reload on startup, from the
+// ~track_journal_reload_hours parameter.
+double reloadSeconds();
+
+} // namespace track_journal
+
+// Appends fixes to a journal. append() only queues the record, so it
+// never blocks; a writer thread writes the queue out in batches a few
+// times a second and drops records older than the retention time once
+// they make up most of the file. A batch that can't be written in full
+// is dropped and cut back off the file, so the index never refers past
+// the records.
+class TrackJournalWriter
+{
+public:
+  explicit TrackJournalWriter(std::size_t queue_capacity = 16384);
+  ~TrackJournalWriter();
+
+  // Opens or creates the journal, dropping a torn last record.
+  bool open(QString path, double retention_seconds);
+  void close();
+  bool isOpen() const;
+
+  // Returns false if the queue is full and the record was dropped.
+  bool append(const track_journal::Record& record);
+
+private:
+  void run();
+  // Returns false if the batch couldn't be written.
+  bool writeBatch();
+  // Rewrites the journal without the records before since_ns.
+  void compact(int64_t since_ns);
+  bool openFiles();
+
+  QString m_path;
+  double m_retention = 0.0;
+  QFile m_data;
+  QFile m_index;
+  int64_t m_record_count = 0;
+  // Latest stamp written, for checkpoints.
+  int64_t m_latest_ns = 0;
+  int64_t m_oldest_ns = 0;
+
+  MPSCRingBuffer<track_journal::Record> m_queue;
+  std::vector<track_journal::Record> m_batch;
+  std::atomic<uint64_t> m_dropped {0};
+  QThread* m_thread = nullptr;
+
+  // Lets close() wake the writer thread instead of waiting out its
+  // sleep.
+  std::mutex m_wake_mutex;
+  std::condition_variable m_wake;
+  bool m_stop = false;
+};
+
+// Maps a journal for reading.
+class TrackJournalReader
+{
+public:
+  ~TrackJournalReader();
+
+  bool open(QString path);
+  void close();
+
+  // The valid records, in the order written.
+  const track_journal::Record* records() const;
+  std::size_t size() const;
+
+  // Index of the first record that could be at or after since_ns.
+  // Records may be a little out of order so later ones may still be
+  // older.
+  std::size_t seek(int64_t since_ns) const;
+
+private:
+  QFile m_data;
+  const uchar* m_map = nullptr;
+  std::size_t m_size = 0;
+  std::vector<track_journal::IndexEntry> m_index;
+};
+
+#endif
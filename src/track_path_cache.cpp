@@ -0,0 +1,216 @@
+#include "track_path_cache.h"
+#include <QPainter>
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+
+// Levels beyond this are tolerances of tens of kilometers of pixels.
+const int max_level = 16;
+
+} // namespace
+
+void TrackPathCache::update(const NavHistory& history, std::size_t tier, uint64_t changed_from)
+{
+  uint64_t first = history.tierFirstId(tier);
+  uint64_t end = first + history.tierSize(tier);
+
+  while(!m_chunks.empty() && m_chunks.back().end_id > changed_from)
+    m_chunks.pop_back();
+  while(!m_chunks.empty() && m_chunks.front().end_id <= first)
+    m_chunks.pop_front();
+
+  // The oldest chunk lost samples, or is still joined to a chunk that
+  // was dropped.
+  if(!m_chunks.empty() && (m_chunks.front().first_id < first || m_chunks.front().seeded))
+  {
+    Chunk chunk;
+    chunk.first_id = chunk.end_id = first;
+    extend(chunk, history, tier, m_chunks.front().end_id);
+    m_chunks.front() = chunk;
+  }
+
+  if(!m_chunks.empty() && m_chunks.back().end_id - m_chunks.back().first_id < chunk_size)
+    extend(m_chunks.back(), history, tier, std::min(end, m_chunks.back().first_id + chunk_size));
+
+  while(m_chunks.empty() || m_chunks.back().end_id < end)
+  {
+    Chunk chunk;
+    chunk.first_id = chunk.end_id = m_chunks.empty() ? first : m_chunks.back().end_id;
+    if(chunk.first_id >= end)
+      break;
+    if(!m_chunks.empty() && !m_chunks.back().empty)
+    {
+      addPoint(chunk, m_chunks.back().last_point);
+      chunk.seeded = true;
+    }
+    extend(chunk, history, tier, std::min(end, chunk.first_id + chunk_size));
+    m_chunks.push_back(chunk);
+  }
+}
+
+void TrackPathCache::clear()
+{
+  m_chunks.clear();
+}
+
+void TrackPathCache::addPoint(Chunk& chunk, QPointF point)
+{
+  chunk.points.push_back(point);
+  chunk.levels.clear();
+  if(chunk.empty)
+  {
+    chunk.path.moveTo(point);
+    chunk.bounds = QRectF(point, QSizeF());
+    chunk.first_point = point;
+    chunk.empty = false;
+  }
+  else
+  {
+    chunk.path.lineTo(point);
+    chunk.bounds.setLeft(std::min(chunk.bounds.left(), point.x()));
+    chunk.bounds.setRight(std::max(chunk.bounds.right(), point.x()));
+    chunk.bounds.setTop(std::min(chunk.bounds.top(), point.y()));
+    chunk.bounds.setBottom(std::max(chunk.bounds.bottom(), point.y()));
+  }
+  chunk.last_point = point;
+}
+
+void TrackPathCache::extend(Chunk& chunk, const NavHistory& history, std::size_t tier, uint64_t end_id)
+{
+  uint64_t first = history.tierFirstId(tier);
+  for(uint64_t id = chunk.end_id; id < end_id; id++)
+  {
+    const auto& sample = history.tierAt(tier, id - first);
+    if(sample.location.isValid())
+      addPoint(chunk, sample.pos);
+  }
+  chunk.end_id = end_id;
+}
+
+void TrackPathCache::paint(QPainter* painter, const QRectF& exposed) const
+{
+  // Item pixels per half a screen pixel, below which detail can't be
+  // seen.
+  qreal scale = std::sqrt(std::fabs(painter->worldTransform().determinant()));
+  qreal tolerance = scale > 0.0 ? 0.5/scale : 0.0;
+  int level = 0;
+  if(tolerance >= 1.0)
+    level = std::min(max_level, int(std::floor(std::log2(tolerance)))+1);
+
+  for(const auto& chunk: m_chunks)
+    if(!chunk.empty && chunk.bounds.adjusted(-1, -1, 1, 1).intersects(exposed))
+      painter->drawPath(simplified(chunk, level));
+}
+
+const QPainterPath& TrackPathCache::simplified(const Chunk& chunk, int level)
+{
+  if(level == 0 || chunk.points.size() < 3)
+    return chunk.path;
+  if(chunk.levels.size() < std::size_t(level))
+    chunk.levels.resize(level);
+  auto& path = chunk.levels[level-1];
+  if(path.isEmpty())
+    path = simplify(chunk.points, std::ldexp(1.0, level-1));
+  return path;
+}
+
+QPainterPath TrackPathCache::simplify(const std::vector<QPointF>& points, qreal tolerance)
+{
+  std::vector<bool> keep(points.size(), false);
+  keep.front() = keep.back() = true;
+  qreal tolerance_squared = tolerance*tolerance;
+
+  std::vector<std::pair<std::size_t, std::size_t> > segments;
+  segments.push_back(std::make_pair(0, points.size()-1));
+  while(!segments.empty())
+  {
+    auto segment = segments.back();
+    segments.pop_back();
+    QPointF start = points[segment.first];
+    QPointF d = points[segment.second] - start;
+    qreal length_squared = QPointF::dotProduct(d, d);
+
+    qreal max_distance_squared = 0.0;
+    std::size_t farthest = segment.first;
+    for(std::size_t i = segment.first+1; i < segment.second; i++)
+    {
+      QPointF v = points[i] - start;
+      qreal distance_squared;
+      if(length_squared > 0.0)
+      {
+        qreal cross = d.x()*v.y() - d.y()*v.x();
+        distance_squared = cross*cross/length_squared;
+      }
+      else
+        distance_squared = QPointF::dotProduct(v, v);
+      if(distance_squared > max_distance_squared)
+      {
+        max_distance_squared = distance_squared;
+        farthest = i;
+      }
+    }
+    if(max_distance_squared > tolerance_squared)
+    {
+      keep[farthest] = true;
+      segments.push_back(std::make_pair(segment.first, farthest));
+      segments.push_back(std::make_pair(farthest, segment.second));
+    }
+  }
+
+  QPainterPath ret;
+  ret.moveTo(points.front());
+  for(std::size_t i = 1; i < points.size(); i++)
+    if(keep[i])
+      ret.lineTo(points[i]);
+  return ret;
+}
+
+void TrackPathCache::addTo(QPainterPath& path) const
+{
+  for(const auto& chunk: m_chunks)
+    if(!chunk.empty)
+      path.addPath(chunk.path);
+}
+
+QRectF TrackPathCache::boundingRect() const
+{
+  // Bounds can have no width or height, which united() would ignore.
+  bool first = true;
+  qreal left = 0, top = 0, right = 0, bottom = 0;
+  for(const auto& chunk: m_chunks)
+    if(!chunk.empty)
+    {
+      left = first ? chunk.bounds.left() : std::min(left, chunk.bounds.left());
+      top = first ? chunk.bounds.top() : std::min(top, chunk.bounds.top());
+      right = first ? chunk.bounds.right() : std::max(right, chunk.bounds.right());
+      bottom = first ? chunk.bounds.bottom() : std::max(bottom, chunk.bounds.bottom());
+      first = false;
+    }
+  return QRectF(QPointF(left, top), QPointF(right, bottom));
+}
+
+bool TrackPathCache::empty() const
+{
+  for(const auto& chunk: m_chunks)
+    if(!chunk.empty)
+      return false;
+  return true;
+}
+
+QPointF TrackPathCache::firstPoint() const
+{
+  for(const auto& chunk: m_chunks)
+    if(!chunk.empty)
+      return chunk.first_point;
+  return QPointF();
+}
+
+QPointF TrackPathCache::lastPoint() const
+{
+  for(auto chunk = m_chunks.rbegin(); chunk != m_chunks.rend(); chunk++)
+    if(!chunk->empty)
+      return chunk->last_point;
+  return QPointF();
+}
@@ -0,0 +1,72 @@
+#ifndef CAMP_TRACK_PATH_CACHE_H
+#define CAMP_TRACK_PATH_CACHE_H
+
+#include "nav_history.h"
+#include <QPainterPath>
+#include <deque>
+#include <vector>
+
+class QPainter;
+
+// Track line through one tier of a NavHistory, cached in chunks of a
+// fixed number of samples. A chunk's path and bounds are built once.
+// Only the newest chunk is extended as samples arrive and only the
+// oldest is rebuilt as samples age out, so keeping the cache current
+// costs the same however long the track gets. Chunks outside the
+// exposed area are skipped when painting.
+//
+// When zoomed out, chunks are drawn simplified with Douglas-Peucker
+// at a tolerance picked from the painter's scale, in powers of two of
+// the item's pixels. Each level is computed the first time a chunk is
+// drawn at it and kept until the chunk changes.
+class TrackPathCache
+{
+public:
+  // Brings the chunks up to date with the tier. changed_from is from
+  // NavHistory::takeTierChanges.
+  void update(const NavHistory& history, std::size_t tier, uint64_t changed_from);
+  void clear();
+
+  void paint(QPainter* painter, QRectF const &exposed) const;
+  void addTo(QPainterPath& path) const;
+  QRectF boundingRect() const;
+
+  // Whether there are any points, and the oldest and newest ones.
+  bool empty() const;
+  QPointF firstPoint() const;
+  QPointF lastPoint() const;
+
+private:
+  struct Chunk
+  {
+    // Covers samples first_id up to end_id of the tier.
+    uint64_t first_id = 0;
+    uint64_t end_id = 0;
+    std::vector<QPointF> points;
+    QPainterPath path;
+    // Simplified paths by level, empty until needed.
+    mutable std::vector<QPainterPath> levels;
+    QRectF bounds;
+    QPointF first_point;
+    QPointF last_point;
+    bool empty = true;
+    // Starts from the previous chunk's last point.
+    bool seeded = false;
+  };
+
+  static void addPoint(Chunk& chunk, QPointF point);
+  // Returns the chunk's path simplified to level, where level n keeps
+  // points within 2^(n-1) pixels of the full track and 0 is the full
+  // track.
+  static const QPainterPath& simplified(const Chunk& chunk, int level);
+  // Douglas-Peucker simplification of points.
+  static QPainterPath simplify(const std::vector<QPointF>& points, qreal tolerance);
+  // Adds the tier's samples up to end_id to chunk.
+  static void extend(Chunk& chunk, const NavHistory& history, std::size_t tier, uint64_t end_id);
+
+  static const uint64_t chunk_size = 256;
+
+  std::deque<Chunk> m_chunks;
+};
+
+#endif